@@ -5,8 +5,28 @@
 #include <iomanip>
 #include <map>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <functional>
 #include <optional>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -39,12 +59,12 @@ public:
 class Student {
 public:
     string rollNo, name, className, category;
+    uint32_t id = 0; // Position in StudentManager's bitmap indexes
     Subject* subjectHead;
-    Student* next;
 
     Student(string r, string n, string c, string cat) {
         rollNo = r; name = n; className = c; category = cat;
-        subjectHead = nullptr; next = nullptr;
+        subjectHead = nullptr;
     }
 
     void addSubject(string name, string status) {
@@ -62,58 +82,874 @@ public:
     }
 };
 
+// FNV-1a, then a 64-bit finalizer so that every bit depends on every byte
+uint64_t hashRoll(const string& roll) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : roll) { h ^= c; h *= 1099511628211ULL; }
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Blocked Bloom filter over roll numbers. It answers "definitely not
+// present" or "maybe present" without touching the roster.
+// Each roll sets 8 bits inside one 32-byte block, one bit per 32-bit word,
+// so a lookup reads a single cache line.
+class RollFilter {
+public:
+    static const int BITS_PER_ROLL = 16; // About 0.1% false positives
+    static const int BLOCK_BITS = 256;
+
+    // Empties the filter and sizes it for `expected` rolls
+    void reset(size_t expected) {
+        blocks.assign(max<size_t>(1, (expected * BITS_PER_ROLL + BLOCK_BITS - 1) / BLOCK_BITS), Block{});
+        capacity = blocks.size() * BLOCK_BITS / BITS_PER_ROLL;
+        count = 0;
+    }
+
+    void add(const string& roll) {
+        uint64_t h = hashRoll(roll);
+        Block& block = blocks[blockIndex(h)];
+        for (int i = 0; i < 8; i++) block[i] |= bitFor(h, i);
+        count++;
+    }
+
+    bool mightContain(const string& roll) const {
+        uint64_t h = hashRoll(roll);
+        const Block& block = blocks[blockIndex(h)];
+        for (int i = 0; i < 8; i++) {
+            if (!(block[i] & bitFor(h, i))) return false;
+        }
+        return true;
+    }
+
+    // More rolls added than the filter was sized for
+    bool full() const { return count > capacity; }
+    size_t sizeInBytes() const { return blocks.size() * sizeof(Block); }
+
+private:
+    typedef array<uint32_t, 8> Block;
+
+    vector<Block> blocks = vector<Block>(1);
+    size_t capacity = BLOCK_BITS / BITS_PER_ROLL;
+    size_t count = 0;
+
+    // The high half of the hash picks the block, the low half the bits in it
+    size_t blockIndex(uint64_t h) const { return (size_t)(((h >> 32) * blocks.size()) >> 32); }
+
+    static uint32_t bitFor(uint64_t h, int word) {
+        static const uint32_t SALTS[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                          0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        return 1U << (((uint32_t)h * SALTS[word]) >> 27);
+    }
+};
+
+// Compressed bitmap (Roaring style) over student ids. Ids are split by their
+// high 16 bits into containers. A container holds the low 16 bits as a sorted
+// array while it has at most ARRAY_MAX of them, and as a 65536-bit bitset
+// beyond that, so both sparse and dense sets stay small. Bitsets are combined
+// a word at a time in plain loops the compiler vectorizes, and counts come
+// from popcount.
+class RoaringBitmap {
+public:
+    static const int ARRAY_MAX = 4096;
+    static const int BITSET_WORDS = 65536 / 64;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        vector<uint16_t> array;  // Sorted; used while bitset is empty
+        vector<uint64_t> bitset; // BITSET_WORDS words, or empty
+
+        bool isBitset() const { return !bitset.empty(); }
+        bool contains(uint16_t low) const {
+            if (isBitset()) return bitset[low >> 6] >> (low & 63) & 1;
+            return binary_search(array.begin(), array.end(), low);
+        }
+    };
+
+    void add(uint32_t id) {
+        Container& c = containerFor(id >> 16);
+        uint16_t low = id & 0xffff;
+        if (c.isBitset()) {
+            uint64_t& word = c.bitset[low >> 6];
+            uint64_t bit = 1ULL << (low & 63);
+            if (!(word & bit)) { word |= bit; c.cardinality++; }
+            return;
+        }
+        auto it = lower_bound(c.array.begin(), c.array.end(), low);
+        if (it != c.array.end() && *it == low) return;
+        c.array.insert(it, low);
+        c.cardinality++;
+        if (c.cardinality > ARRAY_MAX) c = fromBitset(c.key, toBitset(c));
+    }
+
+    void remove(uint32_t id) {
+        auto it = findContainer(id >> 16);
+        if (it == containers.end()) return;
+        uint16_t low = id & 0xffff;
+        if (!it->contains(low)) return;
+        if (it->isBitset()) {
+            it->bitset[low >> 6] &= ~(1ULL << (low & 63));
+            if (--it->cardinality <= ARRAY_MAX) *it = fromBitset(it->key, move(it->bitset));
+        } else {
+            it->array.erase(lower_bound(it->array.begin(), it->array.end(), low));
+            it->cardinality--;
+        }
+        if (it->cardinality == 0) containers.erase(it);
+    }
+
+    bool contains(uint32_t id) const {
+        auto it = lower_bound(containers.begin(), containers.end(), (uint16_t)(id >> 16), keyLess);
+        return it != containers.end() && it->key == (id >> 16) && it->contains(id & 0xffff);
+    }
+
+    size_t cardinality() const {
+        size_t n = 0;
+        for (const Container& c : containers) n += c.cardinality;
+        return n;
+    }
+
+    bool empty() const { return containers.empty(); }
+
+    // Calls f(id) for every id, in increasing order
+    template <class F>
+    void forEach(F f) const {
+        for (const Container& c : containers) {
+            uint32_t high = (uint32_t)c.key << 16;
+            if (!c.isBitset()) {
+                for (uint16_t low : c.array) f(high | low);
+                continue;
+            }
+            for (int w = 0; w < BITSET_WORDS; w++) {
+                for (uint64_t bits = c.bitset[w]; bits; bits &= bits - 1) {
+                    f(high | (uint32_t)(w * 64 + __builtin_ctzll(bits)));
+                }
+            }
+        }
+    }
+
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+        return combine(a, b, false, false, [](const Container& x, const Container& y) {
+            if (!x.isBitset() && !y.isBitset()) {
+                Container out;
+                set_intersection(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                                 back_inserter(out.array));
+                out.cardinality = out.array.size();
+                return out;
+            }
+            if (!x.isBitset() || !y.isBitset()) return filter(x.isBitset() ? y : x, x.isBitset() ? x : y, true);
+            vector<uint64_t> words(BITSET_WORDS);
+            for (int w = 0; w < BITSET_WORDS; w++) words[w] = x.bitset[w] & y.bitset[w];
+            return fromBitset(x.key, move(words));
+        });
+    }
+
+    static RoaringBitmap unite(const RoaringBitmap& a, const RoaringBitmap& b) {
+        return combine(a, b, true, true, [](const Container& x, const Container& y) {
+            if (!x.isBitset() && !y.isBitset() && x.cardinality + y.cardinality <= ARRAY_MAX) {
+                Container out;
+                set_union(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                          back_inserter(out.array));
+                out.cardinality = out.array.size();
+                return out;
+            }
+            vector<uint64_t> words = toBitset(x);
+            if (y.isBitset()) {
+                for (int w = 0; w < BITSET_WORDS; w++) words[w] |= y.bitset[w];
+            } else {
+                for (uint16_t low : y.array) words[low >> 6] |= 1ULL << (low & 63);
+            }
+            return fromBitset(x.key, move(words));
+        });
+    }
+
+    // The ids of a that are not in b
+    static RoaringBitmap subtract(const RoaringBitmap& a, const RoaringBitmap& b) {
+        return combine(a, b, true, false, [](const Container& x, const Container& y) {
+            if (!x.isBitset()) {
+                if (y.isBitset()) return filter(x, y, false);
+                Container out;
+                set_difference(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                               back_inserter(out.array));
+                out.cardinality = out.array.size();
+                return out;
+            }
+            vector<uint64_t> words = x.bitset;
+            if (y.isBitset()) {
+                for (int w = 0; w < BITSET_WORDS; w++) words[w] &= ~y.bitset[w];
+            } else {
+                for (uint16_t low : y.array) words[low >> 6] &= ~(1ULL << (low & 63));
+            }
+            return fromBitset(x.key, move(words));
+        });
+    }
+
+    // |a & b| without building the intersection
+    static size_t intersectCount(const RoaringBitmap& a, const RoaringBitmap& b) {
+        size_t n = 0;
+        auto i = a.containers.begin(), j = b.containers.begin();
+        while (i != a.containers.end() && j != b.containers.end()) {
+            if (i->key < j->key) { ++i; continue; }
+            if (j->key < i->key) { ++j; continue; }
+            if (i->isBitset() && j->isBitset()) {
+                for (int w = 0; w < BITSET_WORDS; w++) n += __builtin_popcountll(i->bitset[w] & j->bitset[w]);
+            } else {
+                const Container& small = i->isBitset() ? *j : *i;
+                const Container& other = i->isBitset() ? *i : *j;
+                for (uint16_t low : small.array) n += other.contains(low);
+            }
+            ++i; ++j;
+        }
+        return n;
+    }
+
+private:
+    vector<Container> containers; // Sorted by key
+
+    static bool keyLess(const Container& c, uint16_t key) { return c.key < key; }
+
+    vector<Container>::iterator findContainer(uint16_t key) {
+        auto it = lower_bound(containers.begin(), containers.end(), key, keyLess);
+        return it != containers.end() && it->key == key ? it : containers.end();
+    }
+
+    Container& containerFor(uint16_t key) {
+        auto it = lower_bound(containers.begin(), containers.end(), key, keyLess);
+        if (it == containers.end() || it->key != key) {
+            it = containers.insert(it, Container());
+            it->key = key;
+        }
+        return *it;
+    }
+
+    static vector<uint64_t> toBitset(const Container& c) {
+        if (c.isBitset()) return c.bitset;
+        vector<uint64_t> words(BITSET_WORDS);
+        for (uint16_t low : c.array) words[low >> 6] |= 1ULL << (low & 63);
+        return words;
+    }
+
+    // A container of the set bits, as an array if there are few enough
+    static Container fromBitset(uint16_t key, vector<uint64_t>&& words) {
+        Container out;
+        out.key = key;
+        for (uint64_t w : words) out.cardinality += __builtin_popcountll(w);
+        if (out.cardinality > ARRAY_MAX) {
+            out.bitset = move(words);
+            return out;
+        }
+        out.array.reserve(out.cardinality);
+        for (int w = 0; w < BITSET_WORDS; w++) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                out.array.push_back((uint16_t)(w * 64 + __builtin_ctzll(bits)));
+            }
+        }
+        return out;
+    }
+
+    // The values of array container x that are (or are not) in y
+    static Container filter(const Container& x, const Container& y, bool keep) {
+        Container out;
+        for (uint16_t low : x.array) {
+            if (y.contains(low) == keep) out.array.push_back(low);
+        }
+        out.cardinality = out.array.size();
+        return out;
+    }
+
+    // Merges the containers of a and b by key. Containers whose key is in both
+    // go through op; the others are copied if keepA / keepB says so.
+    template <class Op>
+    static RoaringBitmap combine(const RoaringBitmap& a, const RoaringBitmap& b, bool keepA, bool keepB, Op op) {
+        RoaringBitmap out;
+        auto i = a.containers.begin(), j = b.containers.begin();
+        while (i != a.containers.end() || j != b.containers.end()) {
+            if (j == b.containers.end() || (i != a.containers.end() && i->key < j->key)) {
+                if (keepA) out.containers.push_back(*i);
+                ++i;
+            } else if (i == a.containers.end() || j->key < i->key) {
+                if (keepB) out.containers.push_back(*j);
+                ++j;
+            } else {
+                Container c = op(*i, *j);
+                c.key = i->key;
+                if (c.cardinality > 0) out.containers.push_back(move(c));
+                ++i; ++j;
+            }
+        }
+        return out;
+    }
+};
+
+// Persistent hash array mapped trie (HAMT) from roll number to student.
+// Nodes never change once built: adding or removing a student copies only
+// the nodes on its path, at most 32 slots each, and shares the rest with the
+// version it came from. Every version stays valid, and copying a Roster is
+// O(1). Each level takes 5 bits of the roll's hash; rolls whose first 60
+// hash bits all match share a bucket at the bottom.
+class Roster {
+public:
+    size_t size() const { return count; }
+
+    const Student* find(const string& roll) const {
+        uint64_t h = hashRoll(roll);
+        const Node* node = root.get();
+        for (int shift = 0; node; shift += LEVEL_BITS) {
+            if (shift >= MAX_SHIFT) {
+                for (const Slot& slot : node->slots) {
+                    if (slot.student->rollNo == roll) return slot.student.get();
+                }
+                return nullptr;
+            }
+            uint32_t bit = bitFor(h, shift);
+            if (!(node->bitmap & bit)) return nullptr;
+            const Slot& slot = node->slots[slotIndex(*node, bit)];
+            if (!slot.child) return slot.student->rollNo == roll ? slot.student.get() : nullptr;
+            node = slot.child.get();
+        }
+        return nullptr;
+    }
+
+    // A new version with s added, or replacing the student with its roll
+    Roster with(const shared_ptr<const Student>& s) const {
+        Roster out = *this;
+        bool added = false;
+        out.root = insert(root.get(), 0, hashRoll(s->rollNo), s, added);
+        out.count += added;
+        return out;
+    }
+
+    // A new version without the student with this roll
+    Roster without(const string& roll) const {
+        if (!root) return *this;
+        Roster out = *this;
+        out.root = erase(root, 0, hashRoll(roll), roll);
+        if (out.root != root) out.count--;
+        return out;
+    }
+
+    // Calls f(student) for every student, in no particular order
+    template <class F>
+    void forEach(F f) const {
+        if (root) visit(*root, f);
+    }
+
+private:
+    static const int LEVEL_BITS = 5;
+    static const int MAX_SHIFT = 60;
+
+    struct Node;
+    typedef shared_ptr<const Node> NodePtr;
+
+    // A child node or a single student
+    struct Slot {
+        NodePtr child;
+        shared_ptr<const Student> student;
+    };
+
+    // Bit i of bitmap is set if slot i of the level is used; only the used
+    // slots are stored. Buckets below MAX_SHIFT use slots alone.
+    struct Node {
+        uint32_t bitmap = 0;
+        vector<Slot> slots;
+    };
+
+    NodePtr root;
+    size_t count = 0;
+
+    static uint32_t bitFor(uint64_t h, int shift) { return 1U << ((h >> shift) & 31); }
+    static size_t slotIndex(const Node& node, uint32_t bit) { return __builtin_popcount(node.bitmap & (bit - 1)); }
+
+    // A copy of node (which may be null) with s in it
+    static NodePtr insert(const Node* node, int shift, uint64_t h, const shared_ptr<const Student>& s, bool& added) {
+        auto out = node ? make_shared<Node>(*node) : make_shared<Node>();
+        if (shift >= MAX_SHIFT) {
+            for (Slot& slot : out->slots) {
+                if (slot.student->rollNo == s->rollNo) { slot.student = s; return out; }
+            }
+            out->slots.push_back({nullptr, s});
+            added = true;
+            return out;
+        }
+        uint32_t bit = bitFor(h, shift);
+        size_t i = slotIndex(*out, bit);
+        if (!(out->bitmap & bit)) {
+            out->bitmap |= bit;
+            out->slots.insert(out->slots.begin() + i, {nullptr, s});
+            added = true;
+            return out;
+        }
+        Slot& slot = out->slots[i];
+        if (slot.child) {
+            slot.child = insert(slot.child.get(), shift + LEVEL_BITS, h, s, added);
+        } else if (slot.student->rollNo == s->rollNo) {
+            slot.student = s;
+        } else {
+            // Two rolls share the slot, so both move one level down
+            NodePtr child = insert(nullptr, shift + LEVEL_BITS, hashRoll(slot.student->rollNo), slot.student, added);
+            slot.child = insert(child.get(), shift + LEVEL_BITS, h, s, added);
+            slot.student = nullptr;
+        }
+        return out;
+    }
+
+    // A copy of node without roll, node itself if roll isn't in it, or null
+    // if nothing is left
+    static NodePtr erase(const NodePtr& node, int shift, uint64_t h, const string& roll) {
+        if (shift >= MAX_SHIFT) {
+            for (size_t i = 0; i < node->slots.size(); i++) {
+                if (node->slots[i].student->rollNo != roll) continue;
+                auto out = make_shared<Node>(*node);
+                out->slots.erase(out->slots.begin() + i);
+                return out->slots.empty() ? nullptr : out;
+            }
+            return node;
+        }
+        uint32_t bit = bitFor(h, shift);
+        if (!(node->bitmap & bit)) return node;
+        size_t i = slotIndex(*node, bit);
+        const Slot& slot = node->slots[i];
+        Slot replacement; // Stays empty if the slot goes
+        if (slot.child) {
+            NodePtr child = erase(slot.child, shift + LEVEL_BITS, h, roll);
+            if (child == slot.child) return node;
+            // A student left alone below moves back up, keeping paths short
+            if (child && child->slots.size() == 1 && !child->slots[0].child) replacement.student = child->slots[0].student;
+            else replacement.child = child;
+        } else if (slot.student->rollNo != roll) {
+            return node;
+        }
+        auto out = make_shared<Node>(*node);
+        if (replacement.child || replacement.student) {
+            out->slots[i] = replacement;
+            return out;
+        }
+        out->bitmap &= ~bit;
+        out->slots.erase(out->slots.begin() + i);
+        return out->slots.empty() ? nullptr : out;
+    }
+
+    template <class F>
+    static void visit(const Node& node, F& f) {
+        for (const Slot& slot : node.slots) {
+            if (slot.child) visit(*slot.child, f);
+            else f(*slot.student);
+        }
+    }
+};
+
 class StudentManager {
 public:
-    Student* head;
-    StudentManager() : head(nullptr) {}
+    static const size_t UNDO_LIMIT = 100;
 
-    void addStudent(string r, string n, string c, string cat) {
-        if(findStudent(r)) return; 
+    // One add or delete, as kept for undo and redo
+    struct Change {
+        shared_ptr<const Student> student;
+        bool added = false;
+    };
+
+    // Returns false if the roll number is already taken
+    bool addStudent(string r, string n, string c, string cat) {
+        if(findStudent(r)) return false;
         Student* newS = new Student(r, n, c, cat);
         newS->addSubject("English", "0");
         newS->addSubject("Math", "0");
-        if (!head) head = newS;
-        else {
-            Student* temp = head;
-            while (temp->next) temp = temp->next;
-            temp->next = newS;
+
+        // Ids only grow, so the indexes list students in the order they were added
+        newS->id = (uint32_t)studentsById.size();
+        shared_ptr<const Student> s(newS);
+        studentsById.push_back(s);
+        commit({roster().with(s), {s, true}});
+        indexStudent(*s);
+        return true;
+    }
+
+    // New rolls are nearly always ruled out by the filter, without a lookup
+    const Student* findStudent(const string& roll) const {
+        if (!rollFilter.mightContain(roll)) return nullptr;
+        return roster().find(roll);
+    }
+
+    // Looks at every student, for comparison with findStudent
+    const Student* scanForStudent(const string& roll) const {
+        const Student* found = nullptr;
+        roster().forEach([&](const Student& s) { if (s.rollNo == roll) found = &s; });
+        return found;
+    }
+
+    bool deleteStudent(const string& roll) {
+        const Student* s = findStudent(roll);
+        if (!s) return false;
+        shared_ptr<const Student> deleted = studentsById[s->id];
+        commit({roster().without(roll), {deleted, false}});
+        unindexStudent(*deleted);
+        return true;
+    }
+
+    bool canUndo() const { return current > 0; }
+    bool canRedo() const { return current + 1 < history.size(); }
+
+    // Steps back to the previous version; returns the change it took back
+    optional<Change> undo() {
+        if (!canUndo()) return nullopt;
+        Change change = history[current--].change;
+        publish();
+        if (change.added) unindexStudent(*change.student);
+        else indexStudent(*change.student);
+        return change;
+    }
+
+    // Steps forward again after undo; returns the change it made again
+    optional<Change> redo() {
+        if (!canRedo()) return nullopt;
+        Change change = history[++current].change;
+        publish();
+        if (change.added) indexStudent(*change.student);
+        else unindexStudent(*change.student);
+        return change;
+    }
+
+    // The current version of the roster. Keep a copy as a read-only
+    // snapshot: it costs O(1) and later changes don't show in it.
+    const Roster& roster() const { return history[current].roster; }
+    Roster snapshot() const { return roster(); }
+
+    // The current roster for other threads, which may call this while the
+    // owning thread makes changes and read the result without a lock
+    shared_ptr<const Roster> publishedRoster() const { return atomic_load(&published); }
+
+    const RollFilter& filter() const { return rollFilter; }
+
+    // The students of a class or category; combine them with
+    // RoaringBitmap::intersect, unite and subtract
+    const RoaringBitmap& inClass(const string& className) const { return lookup(classIndex, className); }
+    const RoaringBitmap& inCategory(const string& category) const { return lookup(categoryIndex, category); }
+    const map<string, RoaringBitmap>& categories() const { return categoryIndex; }
+    const Student* studentById(uint32_t id) const { return studentsById[id].get(); }
+
+private:
+    // A version of the roster and the change that made it
+    struct Version {
+        Roster roster;
+        Change change;
+    };
+
+    deque<Version> history = deque<Version>(1); // Starts empty
+    size_t current = 0;                           // The version in use
+    shared_ptr<const Roster> published = make_shared<const Roster>();
+
+    RollFilter rollFilter;
+    size_t deletedSinceRebuild = 0; // Their rolls still read "maybe present"
+
+    map<string, RoaringBitmap> classIndex, categoryIndex;
+    // nullptr once a student is deleted and the delete can't be undone
+    vector<shared_ptr<const Student>> studentsById;
+
+    // Makes v current. The redo steps are dropped, and so is the oldest
+    // version past UNDO_LIMIT.
+    void commit(Version v) {
+        while (history.size() > current + 1) {
+            forget(history.back().change, true);
+            history.pop_back();
+        }
+        history.push_back(move(v));
+        if (history.size() > UNDO_LIMIT + 1) {
+            history.pop_front();
+            forget(history.front().change, false);
         }
+        current = history.size() - 1;
+        publish();
     }
 
-    Student* findStudent(string roll) {
-        Student* curr = head;
-        while (curr) {
-            if (curr->rollNo == roll) return curr;
-            curr = curr->next;
+    void publish() { atomic_store(&published, make_shared<const Roster>(roster())); }
+
+    // A change that can't be undone (or redone) any more; the student it took
+    // out of the roster is gone for good
+    void forget(Change& change, bool redo) {
+        if (change.student && change.added == redo) studentsById[change.student->id] = nullptr;
+        change.student = nullptr;
+    }
+
+    static const RoaringBitmap& lookup(const map<string, RoaringBitmap>& index, const string& key) {
+        static const RoaringBitmap none;
+        auto it = index.find(key);
+        return it != index.end() ? it->second : none;
+    }
+
+    static void unindex(map<string, RoaringBitmap>& index, const string& key, uint32_t id) {
+        auto it = index.find(key);
+        it->second.remove(id);
+        if (it->second.empty()) index.erase(it);
+    }
+
+    // Called once the current version has s
+    void indexStudent(const Student& s) {
+        classIndex[s.className].add(s.id);
+        categoryIndex[s.category].add(s.id);
+        if (rollFilter.full()) rebuildFilter();
+        else rollFilter.add(s.rollNo);
+    }
+
+    // Called once the current version no longer has s
+    void unindexStudent(const Student& s) {
+        unindex(classIndex, s.className, s.id);
+        unindex(categoryIndex, s.category, s.id);
+        // Once stale rolls outnumber live ones they cost more lookups than a rebuild
+        if (++deletedSinceRebuild > roster().size()) rebuildFilter();
+    }
+
+    // Sized for twice the current students, so growing costs amortized O(1)
+    void rebuildFilter() {
+        rollFilter.reset(2 * roster().size());
+        roster().forEach([&](const Student& s) { rollFilter.add(s.rollNo); });
+        deletedSinceRebuild = 0;
+    }
+};
+
+// ==========================================
+//          ROSTER SERVER (--serve)
+// ==========================================
+#ifdef __linux__
+const char DEFAULT_SOCKET_PATH[] = "student_manager.sock";
+
+// Answers other programs on this machine over a Unix domain socket, from its
+// own thread. The protocol is one line per request, fields split by tabs:
+//
+//   FIND <roll>                        OK <roll> <name> <class> <category>
+//   CLASS <class>                      OK <count>, then one line per student
+//   ADD <roll> <name> <class> <cat>    OK
+//   DEL <roll>                         OK
+//
+// Failures answer "ERR <reason>". Clients may pipeline requests; answers come
+// back in order. An epoll loop serves every connection, handles all the
+// requests a read brought in as one batch and sends the answers with one
+// write. FIND reads the roster the manager published, without a lock; the
+// rest take managerMutex, which the UI holds while it handles a frame.
+class RosterServer {
+public:
+    static const size_t MAX_LINE = 4096;
+    static const size_t MAX_PENDING_OUTPUT = 1 << 20; // Stop reading until it drains
+
+    RosterServer(StudentManager& m, mutex& lock) : manager(m), managerMutex(lock) {}
+    ~RosterServer() { stop(); }
+
+    bool start(const string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            cerr << "ERROR: socket path too long: " << path << endl;
+            return false;
         }
-        return nullptr;
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // A socket left behind by a server that didn't stop cleanly refuses
+        // connections. Anything else means another server still owns it.
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int probed = probe < 0 ? errno : connect(probe, (sockaddr*)&address, sizeof(address)) == 0 ? 0 : errno;
+            if (probe >= 0) close(probe);
+            if (probed == 0 || probed == EAGAIN) {
+                cerr << "ERROR: another server is already listening on " << path << endl;
+                return false;
+            }
+            if (probed != ECONNREFUSED) {
+                cerr << "ERROR: cannot check " << path << ": " << strerror(probed) << endl;
+                return false;
+            }
+            unlink(path.c_str());
+        }
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) < 0 ||
+            listen(listenFd, SOMAXCONN) < 0) {
+            cerr << "ERROR: cannot listen on " << path << ": " << strerror(errno) << endl;
+            closeAll();
+            return false;
+        }
+        socketPath = path;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0 || !watch(listenFd, EPOLLIN, EPOLL_CTL_ADD) || !watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD)) {
+            cerr << "ERROR: cannot set up epoll: " << strerror(errno) << endl;
+            closeAll();
+            return false;
+        }
+        worker = thread([this] { loop(); });
+        return true;
     }
 
-    bool deleteStudent(string roll) {
-        if (!head) return false;
+    void stop() {
+        if (!worker.joinable()) return;
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) cerr << "ERROR: cannot stop the server" << endl;
+        worker.join();
+        closeAll();
+    }
+
+private:
+    struct Connection {
+        string in, out;
+        uint32_t events = EPOLLIN;
+        bool peerClosed = false; // Still answers what was sent before
+    };
 
-        // Case 1: Head is the student to delete
-        if (head->rollNo == roll) {
-            Student* toDelete = head;
-            head = head->next;
-            delete toDelete;
-            return true;
+    StudentManager& manager;
+    mutex& managerMutex;
+    string socketPath;
+    int listenFd = -1, epollFd = -1, wakeFd = -1;
+    map<int, Connection> connections;
+    thread worker;
+
+    bool watch(int fd, uint32_t events, int op) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        return epoll_ctl(epollFd, op, fd, &event) == 0;
+    }
+
+    void closeAll() {
+        for (auto& [fd, c] : connections) close(fd);
+        connections.clear();
+        for (int* fd : {&listenFd, &epollFd, &wakeFd}) {
+            if (*fd >= 0) close(*fd);
+            *fd = -1;
         }
+        if (!socketPath.empty()) unlink(socketPath.c_str());
+        socketPath.clear();
+    }
 
-        // Case 2: Search in the list
-        Student* current = head;
-        while (current->next != nullptr) {
-            if (current->next->rollNo == roll) {
-                Student* toDelete = current->next;
-                current->next = current->next->next;
-                delete toDelete;
-                return true;
+    void loop() {
+        epoll_event events[64];
+        while (true) {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                cerr << "ERROR: epoll_wait: " << strerror(errno) << endl;
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd) return;
+                if (fd == listenFd) acceptAll();
+                else serve(fd, events[i].events);
             }
-            current = current->next;
         }
-        return false;
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN once the backlog is empty
+            if (!watch(fd, EPOLLIN, EPOLL_CTL_ADD)) { close(fd); continue; }
+            connections[fd] = Connection();
+        }
+    }
+
+    void serve(int fd, uint32_t events) {
+        Connection& c = connections[fd];
+        bool ok = true;
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ok = readFrom(fd, c);
+        if (ok) {
+            answerBatch(c);
+            ok = c.in.size() <= MAX_LINE && flush(fd, c);
+        }
+        if (!ok || (c.peerClosed && c.out.empty())) {
+            close(fd); // Also takes it out of the epoll set
+            connections.erase(fd);
+            return;
+        }
+        // Read while the answers keep up, write while some are waiting
+        uint32_t wanted = 0;
+        if (!c.peerClosed && c.out.size() < MAX_PENDING_OUTPUT) wanted |= EPOLLIN;
+        if (!c.out.empty()) wanted |= EPOLLOUT;
+        if (wanted != c.events && watch(fd, wanted, EPOLL_CTL_MOD)) c.events = wanted;
+    }
+
+    // At most 64 KiB per wakeup, so one busy client can't hold up the others
+    bool readFrom(int fd, Connection& c) {
+        char buffer[16 * 1024];
+        for (int i = 0; i < 4; i++) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0) { c.in.append(buffer, n); continue; }
+            if (n == 0) { c.peerClosed = true; return true; }
+            return errno == EAGAIN || errno == EINTR;
+        }
+        return true;
+    }
+
+    bool flush(int fd, Connection& c) {
+        size_t sent = 0;
+        while (sent < c.out.size()) {
+            ssize_t n = send(fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN) break;
+            if (n < 0) return false;
+            sent += n;
+        }
+        c.out.erase(0, sent);
+        return true;
+    }
+
+    static vector<string> splitFields(const string& line) {
+        vector<string> fields;
+        size_t start = 0;
+        while (true) {
+            size_t tab = line.find('\t', start);
+            fields.push_back(line.substr(start, tab - start));
+            if (tab == string::npos) return fields;
+            start = tab + 1;
+        }
+    }
+
+    static void appendStudent(string& out, const Student& s) {
+        out += s.rollNo + '\t' + s.name + '\t' + s.className + '\t' + s.category + '\n';
+    }
+
+    // Answers every complete line in c.in. The lock is taken at most once per
+    // batch and held to its end.
+    void answerBatch(Connection& c) {
+        unique_lock<mutex> lock(managerMutex, defer_lock);
+        shared_ptr<const Roster> roster;
+        size_t start = 0, end;
+        while ((end = c.in.find('\n', start)) != string::npos) {
+            string line = c.in.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            vector<string> f = splitFields(line);
+
+            if (f[0] == "FIND" && f.size() == 2) {
+                if (!roster) roster = manager.publishedRoster();
+                const Student* s = roster->find(f[1]);
+                if (s) { c.out += "OK\t"; appendStudent(c.out, *s); }
+                else c.out += "ERR\tnot found\n";
+                continue;
+            }
+            bool isClass = f[0] == "CLASS" && f.size() == 2;
+            bool isAdd = f[0] == "ADD" && f.size() == 5 && !f[1].empty();
+            bool isDel = f[0] == "DEL" && f.size() == 2;
+            if (!isClass && !isAdd && !isDel) {
+                c.out += "ERR\tbad request\n";
+                continue;
+            }
+            if (!lock.owns_lock()) lock.lock();
+            if (isClass) {
+                const RoaringBitmap& students = manager.inClass(f[1]);
+                c.out += "OK\t" + to_string(students.cardinality()) + '\n';
+                students.forEach([&](uint32_t id) { appendStudent(c.out, *manager.studentById(id)); });
+            } else if (isAdd) {
+                c.out += manager.addStudent(f[1], f[2], f[3], f[4]) ? "OK\n" : "ERR\texists\n";
+            } else {
+                c.out += manager.deleteStudent(f[1]) ? "OK\n" : "ERR\tnot found\n";
+            }
+            roster = nullptr; // Later FINDs in the batch see this change
+        }
+        c.in.erase(0, start);
     }
 };
+#endif
 
 // ==========================================
 //          UI FRAMEWORK (SFML 3.0)
@@ -235,12 +1071,17 @@ class App {
 private:
     sf::RenderWindow window;
     StudentManager manager;
+    mutex managerMutex; // Held while a frame is handled, as the server changes manager too
+#ifdef __linux__
+    unique_ptr<RosterServer> server; // Only with --serve
+#endif
     AppState currentState;
     
     // Containers
     vector<Button*> menuButtons;
     vector<Button*> navButtons;
     vector<Button*> classButtons; // For Class 1-12
+    vector<Button*> categoryButtons; // Category filters of the class table
     
     // Add Student Form
     InputBox* inRoll;
@@ -252,14 +1093,18 @@ private:
     // Search/Delete
     InputBox* inAction; // Reused for Search and Delete
     Button* btnAction;  // Reused button
+    Button* btnUndo;
+    Button* btnRedo;
     
     string notification = "";
     sf::Clock notificationTimer;
 
     string selectedClass = ""; // Stores which class we are viewing details for
+    string selectedCategory = ""; // Category filter of the class table, "" for all
 
 public:
-    App() {
+    // Serves the roster on socketPath too, unless it is empty
+    explicit App(const string& socketPath = "") {
         window.create(sf::VideoMode({WINDOW_WIDTH, WINDOW_HEIGHT}), "Student System Pro");
         window.setFramerateLimit(60);
         currentState = MENU;
@@ -275,6 +1120,13 @@ public:
         manager.addStudent("104", "Mike Ross", "12", "Pre-Eng");
 
         setupUI();
+
+#ifdef __linux__
+        if (!socketPath.empty()) {
+            server = make_unique<RosterServer>(manager, managerMutex);
+            if (server->start(socketPath)) cout << "Serving the roster on " << socketPath << endl;
+        }
+#endif
     }
 
     void setupUI() {
@@ -302,6 +1154,8 @@ public:
         // Search/Delete Input
         inAction = new InputBox("Enter Roll No:", {WINDOW_WIDTH/2.0f - 200, 200}, 300);
         btnAction = new Button("Action", {100, 35}, {WINDOW_WIDTH/2.0f + 120, 230}, 16);
+        btnUndo = new Button("Undo", {100, 35}, {WINDOW_WIDTH/2.0f - 200, 300}, 16);
+        btnRedo = new Button("Redo", {100, 35}, {WINDOW_WIDTH/2.0f - 90, 300}, 16);
 
         // Create Class Grid Buttons (Class 1 to 12)
         float gridStartX = 200;
@@ -318,6 +1172,32 @@ public:
         }
     }
 
+    // One button per category with students in the selected class, plus "All",
+    // each with its count
+    void buildCategoryButtons() {
+        for (auto b : categoryButtons) delete b;
+        categoryButtons.clear();
+        selectedCategory = "";
+
+        const RoaringBitmap& inClass = manager.inClass(selectedClass);
+        vector<pair<string, size_t>> filters = {{"", inClass.cardinality()}};
+        for (const auto& [category, students] : manager.categories()) {
+            size_t count = RoaringBitmap::intersectCount(inClass, students);
+            if (count > 0) filters.push_back({category, count});
+        }
+        float x = 100;
+        for (const auto& [category, count] : filters) {
+            if (x + 150 > WINDOW_WIDTH - 100) break;
+            string label = (category.empty() ? "All" : category) + " (" + to_string(count) + ")";
+            categoryButtons.push_back(new Button(label, {150, 35}, {x, 78}, 16, category));
+            x += 160;
+        }
+    }
+
+    static string describe(const StudentManager::Change& c) {
+        return string(c.added ? "Add " : "Delete ") + c.student->rollNo + " (" + c.student->name + ")";
+    }
+
     void showNotify(string msg, bool isError = false) {
         notification = msg;
         notificationTimer.restart();
@@ -325,8 +1205,12 @@ public:
 
     void run() {
         while (window.isOpen()) {
-            processEvents();
-            render();
+            {
+                lock_guard<mutex> lock(managerMutex);
+                processEvents();
+                render();
+            }
+            window.display(); // Waits out the frame limit, so not under the lock
         }
     }
 
@@ -386,9 +1270,8 @@ public:
                 
                 if (btnSubmitAdd->update(mousePos, click)) {
                     if (inRoll->value.empty()) showNotify("Error: Missing Data", true);
-                    else if (manager.findStudent(inRoll->value)) showNotify("Error: Exists!", true);
+                    else if (!manager.addStudent(inRoll->value, inName->value, inClass->value, inCat->value)) showNotify("Error: Exists!", true);
                     else {
-                        manager.addStudent(inRoll->value, inName->value, inClass->value, inCat->value);
                         showNotify("Success: Student Added!");
                         inRoll->clear(); inName->clear(); inClass->clear(); inCat->clear();
                     }
@@ -400,13 +1283,19 @@ public:
                     if(btn->update(mousePos, click)) {
                         selectedClass = btn->id; // Store "1", "2", "10" etc.
                         currentState = VIEW_CLASS_DETAILS;
+                        buildCategoryButtons();
                     }
                 }
             }
+            else if (currentState == VIEW_CLASS_DETAILS) {
+                for(auto btn : categoryButtons) {
+                    if(btn->update(mousePos, click)) selectedCategory = btn->id;
+                }
+            }
             else if (currentState == SEARCH) {
                 inAction->update(mousePos, click);
                 if (btnAction->update(mousePos, click)) {
-                    Student* s = manager.findStudent(inAction->value);
+                    const Student* s = manager.findStudent(inAction->value);
                     if(s) showNotify("Found: " + s->name + " (Class " + s->className + ")");
                     else showNotify("Student Not Found", true);
                 }
@@ -421,6 +1310,15 @@ public:
                         showNotify("Error: Student Not Found", true);
                     }
                 }
+                // Undo covers adds as well as deletes
+                if (btnUndo->update(mousePos, click)) {
+                    if (auto c = manager.undo()) showNotify("Undone: " + describe(*c));
+                    else showNotify("Error: Nothing to Undo", true);
+                }
+                if (btnRedo->update(mousePos, click)) {
+                    if (auto c = manager.redo()) showNotify("Redone: " + describe(*c));
+                    else showNotify("Error: Nothing to Redo", true);
+                }
             }
         }
     }
@@ -443,7 +1341,9 @@ public:
         
         if(currentState == ADD_STUDENT) btnSubmitAdd->update(mPos, false);
         if(currentState == VIEW_CLASSES) for(auto b : classButtons) b->update(mPos, false);
+        if(currentState == VIEW_CLASS_DETAILS) for(auto b : categoryButtons) b->update(mPos, false);
         if(currentState == SEARCH || currentState == DELETE_STUDENT) btnAction->update(mPos, false);
+        if(currentState == DELETE_STUDENT) { btnUndo->update(mPos, false); btnRedo->update(mPos, false); }
 
         // Rendering Logic
         if (currentState == MENU) {
@@ -467,6 +1367,10 @@ public:
         else if (currentState == VIEW_CLASS_DETAILS) {
             navButtons[0]->draw(window);
             drawHeader("Class " + selectedClass + " Students");
+            for(auto b : categoryButtons) {
+                b->shape.setOutlineThickness(b->id == selectedCategory ? 3 : 1);
+                b->draw(window);
+            }
 
             // --- TABLE RENDER ---
             float startY = 120;
@@ -485,29 +1389,31 @@ public:
             sf::Text h2(globalFont, "Student Name", 20); h2.setPosition({col2X, startY+7}); window.draw(h2);
             sf::Text h3(globalFont, "Category", 20); h3.setPosition({col3X, startY+7}); window.draw(h3);
 
-            // Draw Rows
+            // Draw Rows: the class's bitmap, intersected with the category's if one is picked
             float currentY = startY + 50;
-            Student* curr = manager.head;
-            bool foundAny = false;
-
-            while(curr) {
-                if(curr->className == selectedClass) {
-                    foundAny = true;
-                    // Draw Row Data
-                    sf::Text t1(globalFont, curr->rollNo, 18); t1.setPosition({col1X, currentY}); window.draw(t1);
-                    sf::Text t2(globalFont, curr->name, 18); t2.setPosition({col2X, currentY}); window.draw(t2);
-                    sf::Text t3(globalFont, curr->category, 18); t3.setPosition({col3X, currentY}); window.draw(t3);
-                    
-                    // Draw separator line
-                    sf::RectangleShape line({WINDOW_WIDTH - 200.f, 1.f});
-                    line.setPosition({100.f, currentY + 25});
-                    line.setFillColor(sf::Color(80, 80, 80));
-                    window.draw(line);
-
-                    currentY += 35;
-                }
-                curr = curr->next;
+            RoaringBitmap filtered;
+            const RoaringBitmap* rows = &manager.inClass(selectedClass);
+            if (!selectedCategory.empty()) {
+                filtered = RoaringBitmap::intersect(*rows, manager.inCategory(selectedCategory));
+                rows = &filtered;
             }
+            bool foundAny = !rows->empty();
+
+            rows->forEach([&](uint32_t id) {
+                const Student* curr = manager.studentById(id);
+                // Draw Row Data
+                sf::Text t1(globalFont, curr->rollNo, 18); t1.setPosition({col1X, currentY}); window.draw(t1);
+                sf::Text t2(globalFont, curr->name, 18); t2.setPosition({col2X, currentY}); window.draw(t2);
+                sf::Text t3(globalFont, curr->category, 18); t3.setPosition({col3X, currentY}); window.draw(t3);
+                
+                // Draw separator line
+                sf::RectangleShape line({WINDOW_WIDTH - 200.f, 1.f});
+                line.setPosition({100.f, currentY + 25});
+                line.setFillColor(sf::Color(80, 80, 80));
+                window.draw(line);
+
+                currentY += 35;
+            });
 
             if(!foundAny) {
                 sf::Text msg(globalFont, "No students found in Class " + selectedClass, 20);
@@ -528,6 +1434,10 @@ public:
             // Hacky: Update button text based on mode
             btnAction->text.setString(btnText); 
             btnAction->draw(window);
+            if (currentState == DELETE_STUDENT) {
+                btnUndo->draw(window);
+                btnRedo->draw(window);
+            }
         }
 
         // Notifications
@@ -539,13 +1449,357 @@ public:
             t.setPosition({WINDOW_WIDTH/2.0f - bounds.size.x/2.0f, WINDOW_HEIGHT - 50.0f});
             window.draw(t);
         }
+    }
+};
+
+// ==========================================
+//          BENCHMARK (--bench)
+// ==========================================
+const int BENCH_DEFAULT_SIZE = 100000;
+const int BENCH_SCAN_QUERIES = 200; // Each full scan is O(n), so fewer are timed
+const int BENCH_LOOKUP_QUERIES = 100000;
+const int BENCH_CLASS_QUERIES = 20;
+const string BENCH_CATEGORIES[] = {"CS", "Bio", "Pre-Eng"};
+
+// student_manager --bench [n]: adds n students, then measures the roll
+// filter's false-positive rate on n rolls that are not taken, how fast
+// a new roll is checked with the filter, with the roster's trie alone
+// and with a scan of every student, how fast "Class 10 CS students" is
+// answered from the bitmap indexes and by comparing strings, and what
+// snapshots, deletes, undo and redo cost
+int runBenchmark(int n) {
+    vector<string> taken(n), fresh(n);
+    for (int i = 0; i < n; i++) {
+        taken[i] = to_string(100000 + 2 * i);
+        fresh[i] = to_string(100000 + 2 * i + 1);
+    }
+    // Added in random order; the first of them are deleted and undone below
+    vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(42));
+
+    StudentManager manager;
+    auto since = [](chrono::steady_clock::time_point start) {
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    };
+    auto start = chrono::steady_clock::now();
+    for (int i : order) {
+        manager.addStudent(taken[i], "Student", to_string(1 + i % 12), BENCH_CATEGORIES[(i / 12) % 3]);
+    }
+    double addNs = since(start);
+
+    // The filter must never rule out a taken roll
+    bool ok = true;
+    int falsePositives = 0;
+    for (int i = 0; i < n; i++) {
+        ok &= manager.filter().mightContain(taken[i]);
+        falsePositives += manager.filter().mightContain(fresh[i]);
+    }
+
+    int found = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) found += manager.findStudent(fresh[i]) != nullptr;
+    double filteredNs = since(start) / n;
+
+    int lookupQueries = min(n, BENCH_LOOKUP_QUERIES);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < lookupQueries; i++) found += manager.roster().find(fresh[i]) != nullptr;
+    double trieNs = since(start) / lookupQueries;
+
+    int scanQueries = min(n, BENCH_SCAN_QUERIES);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < scanQueries; i++) found += manager.scanForStudent(fresh[i]) != nullptr;
+    double scanNs = since(start) / scanQueries;
+    ok &= found == 0;
+    for (int i = 0; i < scanQueries; i++) ok &= manager.findStudent(taken[order[i]]) != nullptr;
+
+    size_t intersected = 0, counted = 0, compared = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_CLASS_QUERIES; r++) {
+        intersected = RoaringBitmap::intersect(manager.inClass("10"), manager.inCategory("CS")).cardinality();
+    }
+    double intersectNs = since(start) / BENCH_CLASS_QUERIES;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_CLASS_QUERIES; r++) {
+        counted = RoaringBitmap::intersectCount(manager.inClass("10"), manager.inCategory("CS"));
+    }
+    double countNs = since(start) / BENCH_CLASS_QUERIES;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_CLASS_QUERIES; r++) {
+        compared = 0;
+        manager.roster().forEach([&](const Student& s) {
+            compared += s.className == "10" && s.category == "CS";
+        });
+    }
+    double compareNs = since(start) / BENCH_CLASS_QUERIES;
+    ok &= intersected == compared && counted == compared;
+
+    // A snapshot outlives as many deletes as undo keeps, which undo then
+    // takes back and redo makes again
+    int steps = min(n, (int)StudentManager::UNDO_LIMIT);
+    Roster before;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < lookupQueries; i++) before = manager.snapshot();
+    double snapshotNs = since(start) / lookupQueries;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) ok &= manager.deleteStudent(taken[order[i]]);
+    double deleteNs = since(start) / steps;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) ok &= manager.undo().has_value();
+    double undoNs = since(start) / steps;
+    ok &= !manager.canUndo() && manager.roster().size() == (size_t)n;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) ok &= manager.redo().has_value();
+    double redoNs = since(start) / steps;
+    ok &= before.size() == (size_t)n && manager.roster().size() == (size_t)(n - steps);
+    for (int i = 0; i < steps; i++) {
+        ok &= before.find(taken[order[i]]) != nullptr && manager.findStudent(taken[order[i]]) == nullptr;
+    }
+
+    printf("%d students, filter %zu KiB (%d bits per roll, 8 per lookup)\n", n,
+           manager.filter().sizeInBytes() / 1024, RollFilter::BITS_PER_ROLL);
+    printf("Adding students:        %10.1f ns each\n", addNs / n);
+    printf("False positives:        %10d of %d new rolls (%.3f%%)\n", falsePositives, n,
+           100.0 * falsePositives / n);
+    printf("New roll, filtered:     %10.1f ns\n", filteredNs);
+    printf("New roll, trie only:    %10.1f ns\n", trieNs);
+    printf("New roll, full scan:    %10.1f ns (%d rolls timed)\n", scanNs, scanQueries);
+    printf("Speedup:                %10.0fx\n", scanNs / filteredNs);
+    printf("Class 10 CS students:   %10zu\n", compared);
+    printf("  bitmap intersection:  %10.1f us\n", intersectNs / 1000);
+    printf("  bitmap count only:    %10.1f us\n", countNs / 1000);
+    printf("  string comparisons:   %10.1f us\n", compareNs / 1000);
+    printf("Snapshot:               %10.1f ns\n", snapshotNs);
+    printf("Delete / undo / redo:   %10.1f / %.1f / %.1f ns (%d of each)\n", deleteNs, undoNs, redoNs, steps);
+
+    if (!ok) cerr << "Lookups gave wrong answers!" << endl;
+    return ok ? 0 : 1;
+}
+
+// ==========================================
+//          LOAD GENERATOR (--loadgen)
+// ==========================================
+#ifdef __linux__
+const int LOADGEN_CONNECTIONS = 8;
+const int LOADGEN_REQUESTS = 100000; // Per connection
+const int LOADGEN_DEPTH = 16;        // Requests in flight per connection
+const int LOADGEN_STUDENTS = 10000;  // Added first, and FIND looks them up
+const int LOADGEN_CLASSES = 100;     // Their classes, "LG1" to "LG100"
+
+// One connection of the load generator, blocking, with up to `depth`
+// requests in flight. Each request's latency runs from the write that sent
+// it to the read that finished its answer.
+class LoadConnection {
+public:
+    vector<double> latenciesUs;
+    size_t errors = 0;
+
+    bool connectTo(const string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        return fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) == 0;
+    }
+
+    ~LoadConnection() { if (fd >= 0) close(fd); }
+
+    // Sends every request, keeping `depth` in flight; false if the server
+    // went away
+    bool run(const vector<string>& requests, size_t depth) {
+        size_t next = 0;
+        while (next < requests.size() || !inFlight.empty()) {
+            string batch;
+            auto now = chrono::steady_clock::now();
+            while (next < requests.size() && inFlight.size() < depth) {
+                batch += requests[next];
+                inFlight.push_back({now, requests[next].compare(0, 6, "CLASS\t") == 0});
+                next++;
+            }
+            if (!sendAll(batch) || !receive()) return false;
+        }
+        return true;
+    }
+
+private:
+    struct Pending {
+        chrono::steady_clock::time_point sentAt;
+        bool isClass;
+    };
+
+    int fd = -1;
+    deque<Pending> inFlight;
+    string in;
+    size_t rowsLeft = 0; // Of the CLASS answer being read
 
-        window.display();
+    bool sendAll(const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    // Reads once, and finishes the requests whose answers are complete
+    bool receive() {
+        char buffer[64 * 1024];
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) return true;
+        if (n <= 0) return false;
+        in.append(buffer, n);
+        auto now = chrono::steady_clock::now();
+        size_t start = 0, end;
+        while ((end = in.find('\n', start)) != string::npos) {
+            size_t line = start;
+            start = end + 1;
+            if (rowsLeft > 0) {
+                if (--rowsLeft == 0) finish(now, false);
+                continue;
+            }
+            bool isError = in.compare(line, 4, "ERR\t") == 0;
+            if (!isError && inFlight.front().isClass) {
+                rowsLeft = strtoul(in.c_str() + line + 3, nullptr, 10); // "OK\t<count>"
+                if (rowsLeft > 0) continue;
+            }
+            finish(now, isError);
+        }
+        in.erase(0, start);
+        return true;
+    }
+
+    void finish(chrono::steady_clock::time_point now, bool isError) {
+        errors += isError;
+        latenciesUs.push_back(chrono::duration<double, micro>(now - inFlight.front().sentAt).count());
+        inFlight.pop_front();
     }
 };
 
-int main() {
-    App app;
+// student_manager --loadgen [socket] [connections] [requests] [depth]: adds
+// LOADGEN_STUDENTS students through a server started with --serve, then
+// has each connection send `requests` of which 80% are FIND, 9% ADD, 9% DEL
+// of its own adds and 2% CLASS, and reports QPS and latency percentiles.
+// The students it added are deleted at the end.
+int runLoadGenerator(const string& path, int connections, int requests, int depth) {
+    auto student = [](int i) { return "lg" + to_string(i) + "\tLoad Student\tLG" + to_string(1 + i % LOADGEN_CLASSES) + "\tCS\n"; };
+    vector<string> setup, cleanup;
+    for (int i = 0; i < LOADGEN_STUDENTS; i++) {
+        setup.push_back("ADD\t" + student(i));
+        cleanup.push_back("DEL\tlg" + to_string(i) + "\n");
+    }
+
+    // Each connection's requests, made up front so that timing covers only I/O
+    vector<vector<string>> work(connections);
+    for (int c = 0; c < connections; c++) {
+        mt19937 rng(c + 1);
+        deque<int> added;
+        int nextRoll = LOADGEN_STUDENTS + c * requests;
+        for (int r = 0; r < requests; r++) {
+            int kind = rng() % 100;
+            if (kind >= 89 && kind < 98 && added.empty()) kind = 0; // Nothing of its own to delete yet
+            if (kind < 80) {
+                work[c].push_back("FIND\tlg" + to_string(rng() % LOADGEN_STUDENTS) + "\n");
+            } else if (kind < 89) {
+                added.push_back(nextRoll);
+                work[c].push_back("ADD\t" + student(nextRoll++));
+            } else if (kind < 98) {
+                work[c].push_back("DEL\tlg" + to_string(added.front()) + "\n");
+                added.pop_front();
+            } else {
+                work[c].push_back("CLASS\tLG" + to_string(1 + rng() % LOADGEN_CLASSES) + "\n");
+            }
+        }
+        for (int roll : added) cleanup.push_back("DEL\tlg" + to_string(roll) + "\n");
+    }
+
+    LoadConnection admin;
+    if (!admin.connectTo(path) || !admin.run(setup, 64)) {
+        cerr << "ERROR: cannot reach a server on " << path << " (start one with --serve)" << endl;
+        return 1;
+    }
+    if (admin.errors > 0) cerr << admin.errors << " students were there already" << endl;
+
+    vector<LoadConnection> clients(connections);
+    vector<thread> threads;
+    atomic<bool> failed(false);
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < connections; c++) {
+        threads.emplace_back([&, c] {
+            if (!clients[c].connectTo(path) || !clients[c].run(work[c], depth)) failed = true;
+        });
+    }
+    for (thread& t : threads) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool cleaned = admin.run(cleanup, 64);
+
+    vector<double> latencies;
+    size_t errors = 0;
+    for (LoadConnection& c : clients) {
+        latencies.insert(latencies.end(), c.latenciesUs.begin(), c.latenciesUs.end());
+        errors += c.errors;
+    }
+    if (failed || !cleaned || latencies.empty()) {
+        cerr << "ERROR: the server closed a connection" << endl;
+        return 1;
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+    printf("%d connections x %d requests, %d in flight each\n", connections, requests, depth);
+    printf("Throughput:   %10.0f requests/s\n", latencies.size() / seconds);
+    printf("Latency p50:  %10.1f us\n", percentile(0.50));
+    printf("Latency p99:  %10.1f us\n", percentile(0.99));
+    printf("Latency p99.9:%10.1f us\n", percentile(0.999));
+    printf("Latency max:  %10.1f us\n", latencies.back());
+    printf("Errors:       %10zu\n", errors);
+    return errors == 0 ? 0 : 1;
+}
+#endif
+
+int main(int argc, char** argv) {
+    // student_manager --bench [n] runs without a window
+    if (argc >= 2 && string(argv[1]) == "--bench") {
+        int n = argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_SIZE;
+        if (n <= 0) {
+            cerr << "Usage: student_manager --bench [count]" << endl;
+            return 1;
+        }
+        return runBenchmark(n);
+    }
+
+    // student_manager --loadgen [socket] [connections] [requests] [depth]
+    // runs without a window, against a student_manager --serve
+    if (argc >= 2 && string(argv[1]) == "--loadgen") {
+#ifdef __linux__
+        string path = argc >= 3 ? argv[2] : DEFAULT_SOCKET_PATH;
+        int connections = argc >= 4 ? atoi(argv[3]) : LOADGEN_CONNECTIONS;
+        int requests = argc >= 5 ? atoi(argv[4]) : LOADGEN_REQUESTS;
+        int depth = argc >= 6 ? atoi(argv[5]) : LOADGEN_DEPTH;
+        if (connections <= 0 || requests <= 0 || depth <= 0) {
+            cerr << "Usage: student_manager --loadgen [socket] [connections] [requests] [depth]" << endl;
+            return 1;
+        }
+        return runLoadGenerator(path, connections, requests, depth);
+#else
+        cerr << "--loadgen needs Linux (epoll)" << endl;
+        return 1;
+#endif
+    }
+
+    // student_manager --serve [socket] also answers queries on the socket
+    string socketPath;
+    if (argc >= 2 && string(argv[1]) == "--serve") {
+#ifdef __linux__
+        socketPath = argc >= 3 ? argv[2] : DEFAULT_SOCKET_PATH;
+#else
+        cerr << "--serve needs Linux (epoll)" << endl;
+        return 1;
+#endif
+    }
+
+    App app(socketPath);
     app.run();
     return 0;
 }
\ No newline at end of file
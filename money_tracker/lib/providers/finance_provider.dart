@@ -1,8 +1,10 @@
 import 'dart:convert';
+import 'dart:typed_data';
 import 'package:flutter/material.dart';
 import 'package:shared_preferences/shared_preferences.dart';
 import '../models/transaction_model.dart';
 import '../models/category_model.dart';
+import '../services/native_ledger.dart';
 
 class FinanceProvider with ChangeNotifier {
   List<TransactionModel> _transactions = [];
@@ -16,6 +18,16 @@ class FinanceProvider with ChangeNotifier {
   String _currentUser = 'Default User';
   int _startDayOfMonth = 1;
 
+  // On Linux the sums come from the native ledger and are cached here
+  Float64List? _nativeSummary; // balance, savings, spentThisMonth
+  Map<int, Map<int, Map<String, double>>> _dailyStatsCache = {};
+
+  // Users switched away from lately, least recent first, so switching back is
+  // a swap of references instead of a reload
+  static const int _maxCachedUsers = 4;
+  final Map<String, _UserData> _cachedUsers = {};
+  DateTime _loadedOn = DateTime.now();
+
   List<TransactionModel> get transactions => _transactions;
   List<CategoryModel> get categories => _categories;
   double get balance => _balance;
@@ -28,7 +40,10 @@ class FinanceProvider with ChangeNotifier {
   int get startDayOfMonth => _startDayOfMonth;
 
   FinanceProvider() {
-    _init();
+    final load = Stopwatch()..start();
+    _init().then((_) {
+      if (NativeLedger.isAvailable) NativeLedger.reportLoaded(load.elapsed);
+    });
   }
 
   Future<void> _init() async {
@@ -37,6 +52,7 @@ class FinanceProvider with ChangeNotifier {
   }
 
   Future<void> refreshAllData() async {
+    _cachedUsers.clear();
     await _init();
     notifyListeners();
   }
@@ -75,6 +91,9 @@ class FinanceProvider with ChangeNotifier {
 
   Future<void> _loadUserData() async {
     final prefs = await SharedPreferences.getInstance();
+    _loadedOn = DateTime.now();
+    _nativeSummary = null;
+    _dailyStatsCache = {};
     
     final catData = prefs.getString('${_currentUser}_categories');
     if (catData != null) {
@@ -88,7 +107,17 @@ class FinanceProvider with ChangeNotifier {
     }
 
     final transData = prefs.getString('${_currentUser}_transactions');
-    if (transData != null) {
+    if (NativeLedger.isAvailable) {
+      // JSON still in the preferences (older versions, restored backups)
+      // replaces the native ledger once
+      if (transData != null) {
+        final List decoded = jsonDecode(transData);
+        await NativeLedger.replace(_currentUser, decoded.map((e) => TransactionModel.fromMap(e)).toList());
+        await prefs.remove('${_currentUser}_transactions');
+      }
+      _transactions = await NativeLedger.read(_currentUser);
+      _transactions.removeWhere((t) => isFutureDate(t.date));
+    } else if (transData != null) {
       final List decoded = jsonDecode(transData);
       _transactions = decoded.map((e) => TransactionModel.fromMap(e)).toList();
       _transactions.removeWhere((t) => isFutureDate(t.date));
@@ -97,20 +126,47 @@ class FinanceProvider with ChangeNotifier {
       _transactions = [];
     }
     
-    _calculateBalance();
+    await _calculateBalance();
   }
 
   // --- User Management ---
 
   Future<void> switchUser(String name) async {
     if (!_users.contains(name)) return;
+    _cacheCurrentUser();
     _currentUser = name;
     final prefs = await SharedPreferences.getInstance();
     await prefs.setString('current_user', name);
-    await _loadUserData();
+    if (!_restoreCachedUser(name)) await _loadUserData();
     notifyListeners();
   }
 
+  void _cacheCurrentUser() {
+    if (!_users.contains(_currentUser)) return; // Just removed
+    _cachedUsers.remove(_currentUser);
+    _cachedUsers[_currentUser] = _UserData(
+        _transactions, _categories, _balance, _nativeSummary, _dailyStatsCache, _loadedOn);
+    if (_cachedUsers.length > _maxCachedUsers) {
+      _cachedUsers.remove(_cachedUsers.keys.first);
+    }
+  }
+
+  /// Makes [name]'s cached data current. Data loaded on an earlier day is
+  /// dropped instead, as transactions dated since then were left out of it.
+  bool _restoreCachedUser(String name) {
+    final data = _cachedUsers.remove(name);
+    if (data == null || _normalizeDate(data.loadedOn) != _normalizeDate(DateTime.now())) {
+      return false;
+    }
+    _transactions = data.transactions;
+    _categories = data.categories;
+    _balance = data.balance;
+    _nativeSummary = data.nativeSummary;
+    _dailyStatsCache = data.dailyStatsCache;
+    _loadedOn = data.loadedOn;
+    return true;
+  }
+
   Future<void> addUser(String name) async {
     if (name.isEmpty || _users.contains(name)) return;
     _users.add(name);
@@ -126,6 +182,9 @@ class FinanceProvider with ChangeNotifier {
     await prefs.setStringList('users_list', _users);
     await prefs.remove('${name}_categories');
     await prefs.remove('${name}_transactions');
+    _cachedUsers.remove(name);
+    // Drops the user's ledger file
+    if (NativeLedger.isAvailable) await NativeLedger.remove(name);
     if (_currentUser == name) {
       await switchUser(_users.first);
     } else {
@@ -146,10 +205,17 @@ class FinanceProvider with ChangeNotifier {
     _startDayOfMonth = day;
     final prefs = await SharedPreferences.getInstance();
     await prefs.setInt('startDayOfMonth', day);
+    _cachedUsers.clear(); // Their sums follow the old billing month
+    if (NativeLedger.isAvailable) await _refreshNativeStats();
     notifyListeners();
   }
 
-  void _calculateBalance() {
+  /// Call once the change is in the ledger, which totals it natively.
+  Future<void> _calculateBalance() async {
+    if (NativeLedger.isAvailable) {
+      await _refreshNativeStats();
+      return;
+    }
     _balance = 0;
     for (var t in _transactions) {
       if (t.isIncome) {
@@ -197,14 +263,51 @@ class FinanceProvider with ChangeNotifier {
     await prefs.setString('${_currentUser}_transactions', encoded);
   }
 
-  void addTransaction(TransactionModel transaction) {
+  Future<void> addTransaction(TransactionModel transaction) async {
     if (isFutureDate(transaction.date)) {
       debugPrint('🚨 BLOCKED: Attempt to add a transaction with a future date: ${transaction.date}');
       return; 
     }
+    if (NativeLedger.isAvailable) {
+      // The ledger appends one record; the list stays in date order
+      _transactions.insert(_insertionIndex(transaction.date), transaction);
+      notifyListeners();
+      await NativeLedger.insert(_currentUser, transaction);
+      await _calculateBalance();
+      return;
+    }
     _transactions.add(transaction);
-    _calculateBalance();
-    saveTransactions();
+    await _calculateBalance();
+    await saveTransactions();
+  }
+
+  /// Fetches the dashboard sums again after the ledger or the settings changed.
+  Future<void> _refreshNativeStats() async {
+    _dailyStatsCache.clear();
+    final user = _currentUser;
+    final summary = await NativeLedger.summary(user, _startDayOfMonth);
+    if (user != _currentUser) {
+      // Switched away meanwhile; the sums cached for them may predate the change
+      _cachedUsers.remove(user);
+      return;
+    }
+    _nativeSummary = summary;
+    _balance = summary[0];
+    notifyListeners();
+  }
+
+  /// Position after the last transaction dated on or before [date].
+  int _insertionIndex(DateTime date) {
+    int lo = 0, hi = _transactions.length;
+    while (lo < hi) {
+      final mid = (lo + hi) ~/ 2;
+      if (_transactions[mid].date.isAfter(date)) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
   }
 
   // --- Dashboard & Filtering Calculations ---
@@ -212,6 +315,7 @@ class FinanceProvider with ChangeNotifier {
   double get currentBalance => _balance;
 
   double get savings {
+    if (_nativeSummary != null) return _nativeSummary![1];
     final now = DateTime.now();
     final startDay = DateTime(now.year, now.month, _startDayOfMonth);
     double amount = 0;
@@ -222,6 +326,7 @@ class FinanceProvider with ChangeNotifier {
   }
 
   double get spentThisMonth {
+    if (_nativeSummary != null) return _nativeSummary![2];
     final now = DateTime.now();
     final startDay = DateTime(now.year, now.month, _startDayOfMonth);
     double amount = 0;
@@ -241,6 +346,24 @@ class FinanceProvider with ChangeNotifier {
         i: {'income': 0.0, 'expense': 0.0}
     };
 
+    if (NativeLedger.isAvailable) {
+      // Zeros until the runner has summed the month; the listeners are told then
+      final key = year * 12 + month - 1;
+      final cache = _dailyStatsCache; // The user's, even if they are switched away from
+      final cached = cache[key];
+      if (cached != null) return cached;
+      cache[key] = stats;
+      NativeLedger.daily(_currentUser, DateTime(year, month, 1), DateTime(year, month + 1, 1)).then((days) {
+        if (!identical(cache[key], stats)) return; // Dropped by a newer change
+        cache[key] = {
+          for (int i = 1; i <= lastDayOfMonth; i++)
+            i: {'income': days[2 * i - 2], 'expense': days[2 * i - 1]}
+        };
+        notifyListeners();
+      });
+      return stats;
+    }
+
     for (var t in _transactions) {
       if (t.date.year == year && t.date.month == month) {
         final day = t.date.day;
@@ -301,3 +424,16 @@ class FinanceProvider with ChangeNotifier {
     return filtered;
   }
 }
+
+/// What [FinanceProvider] holds in memory for one user.
+class _UserData {
+  _UserData(this.transactions, this.categories, this.balance, this.nativeSummary,
+      this.dailyStatsCache, this.loadedOn);
+
+  final List<TransactionModel> transactions;
+  final List<CategoryModel> categories;
+  final double balance;
+  final Float64List? nativeSummary;
+  final Map<int, Map<int, Map<String, double>>> dailyStatsCache;
+  final DateTime loadedOn;
+}
@@ -231,7 +231,7 @@ class _SettingsScreenState extends State<SettingsScreen> {
                       child: const ListTile(
                         leading: Icon(Icons.upload_file, color: Colors.blue),
                         title: Text('Export Backup'),
-                        subtitle: Text('Save all data to a text file'),
+                        subtitle: Text('Save all data to a backup file'),
                       ),
                     ),
                     const Divider(height: 1),
@@ -3,6 +3,7 @@ import 'dart:io';
 import 'package:file_picker/file_picker.dart';
 import 'package:flutter/foundation.dart';
 import 'package:shared_preferences/shared_preferences.dart';
+import 'native_ledger.dart';
 
 class BackupService {
   static Future<bool> exportBackup() async {
@@ -15,8 +16,6 @@ class BackupService {
         backupData[key] = prefs.get(key);
       }
 
-      final jsonString = jsonEncode(backupData);
-      
       String? outputPath;
       if (kIsWeb) {
         // Handle web if necessary, but file_picker handles it differently
@@ -24,15 +23,26 @@ class BackupService {
       } else {
         outputPath = await FilePicker.platform.saveFile(
           dialogTitle: 'Save Backup',
-          fileName: 'money_tracker_backup_${DateTime.now().millisecondsSinceEpoch}.txt',
+          fileName: 'money_tracker_backup_${DateTime.now().millisecondsSinceEpoch}.'
+              '${NativeLedger.isAvailable ? 'mtbak' : 'txt'}',
           type: FileType.custom,
-          allowedExtensions: ['txt', 'json'],
+          allowedExtensions: NativeLedger.isAvailable ? ['mtbak'] : ['txt', 'json'],
         );
       }
 
+      // On Linux the runner streams the transactions straight from the native
+      // ledger into the file, unless JSON is still waiting to replace a ledger.
+      if (outputPath != null && NativeLedger.isAvailable) {
+        final users = (prefs.getStringList('users_list') ?? ['Default User'])
+            .where((user) => !backupData.containsKey('${user}_transactions'))
+            .toList();
+        await NativeLedger.exportBackup(outputPath, backupData, users);
+        return true;
+      }
+
       if (outputPath != null) {
         final file = File(outputPath);
-        await file.writeAsString(jsonString);
+        await file.writeAsString(jsonEncode(backupData));
         return true;
       }
       return false;
@@ -46,29 +56,34 @@ class BackupService {
     try {
       final result = await FilePicker.platform.pickFiles(
         type: FileType.custom,
-        allowedExtensions: ['txt', 'json'],
+        allowedExtensions: ['txt', 'json', 'mtbak'],
       );
 
       if (result != null && result.files.single.path != null) {
         final file = File(result.files.single.path!);
+        final prefs = await SharedPreferences.getInstance();
+
+        // Native backups restore the ledgers in the runner and hand back
+        // only the preferences. The runner keeps them pending with the
+        // ledgers, and puts them in place on the next start if the app
+        // stops before they are all applied here.
+        if (NativeLedger.isAvailable && await _isNativeBackup(file)) {
+          final preferences = await NativeLedger.importBackup(file.path);
+          await _restorePreferences(prefs, preferences);
+          await NativeLedger.finishImport();
+          return true;
+        }
+
         final jsonString = await file.readAsString();
         final Map<String, dynamic> backupData = jsonDecode(jsonString);
+        await _restorePreferences(prefs, backupData);
 
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.clear();
-
-        for (final entry in backupData.entries) {
-          final value = entry.value;
-          if (value is String) {
-            await prefs.setString(entry.key, value);
-          } else if (value is int) {
-            await prefs.setInt(entry.key, value);
-          } else if (value is bool) {
-            await prefs.setBool(entry.key, value);
-          } else if (value is double) {
-            await prefs.setDouble(entry.key, value);
-          } else if (value is List) {
-            await prefs.setStringList(entry.key, value.map((e) => e.toString()).toList());
+        // Every restored user's ledger is replaced when it is next loaded,
+        // including users who had no transactions in the backup
+        if (NativeLedger.isAvailable) {
+          for (final user in prefs.getStringList('users_list') ?? ['Default User']) {
+            final key = '${user}_transactions';
+            if (!prefs.containsKey(key)) await prefs.setString(key, '[]');
           }
         }
         return true;
@@ -79,4 +94,31 @@ class BackupService {
       return false;
     }
   }
+
+  static Future<bool> _isNativeBackup(File file) async {
+    final head = <int>[];
+    await for (final chunk in file.openRead(0, NativeLedger.backupMagic.length)) {
+      head.addAll(chunk);
+    }
+    return String.fromCharCodes(head) == NativeLedger.backupMagic;
+  }
+
+  static Future<void> _restorePreferences(SharedPreferences prefs, Map<String, dynamic> backupData) async {
+    await prefs.clear();
+
+    for (final entry in backupData.entries) {
+      final value = entry.value;
+      if (value is String) {
+        await prefs.setString(entry.key, value);
+      } else if (value is int) {
+        await prefs.setInt(entry.key, value);
+      } else if (value is bool) {
+        await prefs.setBool(entry.key, value);
+      } else if (value is double) {
+        await prefs.setDouble(entry.key, value);
+      } else if (value is List) {
+        await prefs.setStringList(entry.key, value.map((e) => e.toString()).toList());
+      }
+    }
+  }
 }
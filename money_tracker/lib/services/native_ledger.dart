@@ -0,0 +1,177 @@
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import '../models/transaction_model.dart';
+
+/// 📒 Client of the native ledger in the Linux runner (linux/runner/ledger.h).
+/// Each user's transactions live in an append-only, date-ordered file, so
+/// adding one costs a single record instead of rewriting the whole history.
+class NativeLedger {
+  static const MethodChannel _channel = MethodChannel('money_tracker/ledger');
+  static const MethodChannel _startupChannel = MethodChannel('money_tracker/startup');
+
+  /// Widget tests run without the runner, so they keep the JSON storage.
+  static bool get isAvailable =>
+      !kIsWeb && Platform.isLinux && !Platform.environment.containsKey('FLUTTER_TEST');
+
+  /// Dates cross the channel as local wall-clock microseconds counted as if
+  /// they were UTC, so the native side can split days without time zones.
+  static int encodeDate(DateTime date) {
+    return DateTime.utc(date.year, date.month, date.day, date.hour, date.minute,
+            date.second, date.millisecond, date.microsecond)
+        .microsecondsSinceEpoch;
+  }
+
+  static DateTime decodeDate(int micros) {
+    final d = DateTime.fromMicrosecondsSinceEpoch(micros, isUtc: true);
+    return DateTime(d.year, d.month, d.day, d.hour, d.minute, d.second,
+        d.millisecond, d.microsecond);
+  }
+
+  /// Tells the runner the first load of the user's data took [elapsed]. The
+  /// app is usable from then on, so this ends the runner's startup trace.
+  static Future<void> reportLoaded(Duration elapsed) async {
+    await _startupChannel.invokeMethod('loaded', {'micros': elapsed.inMicroseconds});
+  }
+
+  static Future<int> insert(String user, TransactionModel t) async {
+    return await _channel.invokeMethod<int>('insert', {
+          'user': user,
+          'date': encodeDate(t.date),
+          'amount': t.amount,
+          'isIncome': t.isIncome,
+          'category': t.category,
+        }) ??
+        0;
+  }
+
+  /// Replaces the user's whole ledger, e.g. with transactions from a backup.
+  static Future<int> replace(String user, List<TransactionModel> transactions) async {
+    final names = <String>[];
+    final ids = <String, int>{};
+    final categories = Int32List(transactions.length);
+    for (int i = 0; i < transactions.length; i++) {
+      categories[i] = ids.putIfAbsent(transactions[i].category, () {
+        names.add(transactions[i].category);
+        return names.length - 1;
+      });
+    }
+    return await _channel.invokeMethod<int>('replace', {
+          'user': user,
+          'dates': Int64List.fromList(transactions.map((t) => encodeDate(t.date)).toList()),
+          'amounts': Float64List.fromList(transactions.map((t) => t.amount).toList()),
+          'income': Uint8List.fromList(transactions.map((t) => t.isIncome ? 1 : 0).toList()),
+          'categories': categories,
+          'categoryNames': names,
+        }) ??
+        0;
+  }
+
+  /// Transactions with from <= date < to, oldest first.
+  static Future<List<TransactionModel>> read(String user, {DateTime? from, DateTime? to}) async {
+    final result = await _channel.invokeMapMethod<String, dynamic>('read', {
+      'user': user,
+      if (from != null) 'from': encodeDate(from),
+      if (to != null) 'to': encodeDate(to),
+    });
+    if (result == null) return [];
+    final Int64List dates = result['dates'];
+    final Float64List amounts = result['amounts'];
+    final Uint8List income = result['income'];
+    final Int32List categories = result['categories'];
+    final List names = result['categoryNames'];
+    return List<TransactionModel>.generate(dates.length, (i) {
+      return TransactionModel(
+        amount: amounts[i],
+        date: decodeDate(dates[i]),
+        isIncome: income[i] != 0,
+        category: names[categories[i]] as String,
+      );
+    });
+  }
+
+  static Future<void> remove(String user) async {
+    await _channel.invokeMethod('remove', {'user': user});
+  }
+
+  /// Writes the statement PDF of the days [from] through [to] to [path],
+  /// page by page from the ledger, with text in the [font] asset. Returns the
+  /// number of pages.
+  static Future<int> statement(String user, DateTime from, DateTime to, String title, String path, String font) async {
+    return await _channel.invokeMethod<int>('statement', {
+          'user': user,
+          'from': encodeDate(from),
+          'to': encodeDate(to),
+          'title': title,
+          'path': path,
+          'font': font,
+        }) ??
+        0;
+  }
+
+  // --- Backups (linux/runner/backup.h) ---
+
+  /// Files written by [exportBackup] start with these bytes.
+  static const String backupMagic = 'MTBACKP1';
+
+  /// Streams [preferences] and the ledgers of [users] into a compressed,
+  /// checksummed backup at [path].
+  static Future<void> exportBackup(String path, Map<String, Object?> preferences, List<String> users) async {
+    await _channel.invokeMethod('exportBackup', {
+      'path': path,
+      'preferences': preferences,
+      'users': users,
+    });
+  }
+
+  /// Replaces every ledger with those in the backup at [path] and returns
+  /// the preferences it holds, to be applied and then confirmed with
+  /// [finishImport]. A damaged backup throws and changes nothing.
+  static Future<Map<String, Object?>> importBackup(String path) async {
+    return await _channel.invokeMapMethod<String, Object?>('importBackup', {'path': path}) ?? {};
+  }
+
+  /// Tells the runner the preferences from [importBackup] are applied.
+  static Future<void> finishImport() async {
+    await _channel.invokeMethod('finishImport');
+  }
+
+  // --- Sums (prefix sums over per-day totals in the runner) ---
+  // Transactions dated after today are left out, like the provider does.
+
+  static int get _today => encodeDate(DateTime.now());
+
+  /// [balance, savings, spentThisMonth] for billing months starting on [startDayOfMonth].
+  static Future<Float64List> summary(String user, int startDayOfMonth) async {
+    return await _channel.invokeMethod<Float64List>('summary', {
+          'user': user,
+          'today': _today,
+          'startDayOfMonth': startDayOfMonth,
+        }) ??
+        Float64List(3);
+  }
+
+  /// [income, expense] of the whole days from [from] up to but not including [to].
+  static Future<Float64List> totals(String user, DateTime from, DateTime to) async {
+    return await _channel.invokeMethod<Float64List>('totals', {
+          'user': user,
+          'from': encodeDate(from),
+          'to': encodeDate(to),
+          'today': _today,
+        }) ??
+        Float64List(2);
+  }
+
+  /// Income and expense of each day from [from] up to but not including [to],
+  /// interleaved.
+  static Future<Float64List> daily(String user, DateTime from, DateTime to) async {
+    return await _channel.invokeMethod<Float64List>('daily', {
+          'user': user,
+          'from': encodeDate(from),
+          'to': encodeDate(to),
+          'today': _today,
+        }) ??
+        Float64List(0);
+  }
+}
@@ -6,8 +6,11 @@ import 'package:pdf/widgets.dart' as pw;
 import 'package:printing/printing.dart';
 import 'package:file_picker/file_picker.dart';
 import '../models/transaction_model.dart';
+import 'native_ledger.dart';
 
 class PdfService {
+  static const String _fontAsset = 'assets/fonts/Roboto-Regular.ttf';
+
   /// 📄 Generates and opens the native print dialog.
   static Future<void> printTransactionReport({
     required List<TransactionModel> transactions,
@@ -15,7 +18,14 @@ class PdfService {
     required double totalExpense,
     required double netBalance,
     required String periodTitle,
+    String? user,
+    DateTime? from,
+    DateTime? to,
   }) async {
+    if (NativeLedger.isAvailable && user != null && from != null && to != null) {
+      await _printNativeStatement(user, from, to, periodTitle);
+      return;
+    }
     try {
       final pdf = await _generateDocument(
         transactions, 
@@ -57,7 +67,14 @@ class PdfService {
     required double totalExpense,
     required double netBalance,
     required String periodTitle,
+    String? user,
+    DateTime? from,
+    DateTime? to,
   }) async {
+    if (NativeLedger.isAvailable && user != null && from != null && to != null) {
+      await _saveNativeStatement(user, from, to, periodTitle);
+      return;
+    }
     final pdf = await _generateDocument(
       transactions, 
       totalIncome, 
@@ -93,6 +110,39 @@ class PdfService {
     );
   }
 
+  static String _fileName(String periodTitle) => 'Money_Map_Statement_${periodTitle.replaceAll(' ', '_')}.pdf';
+
+  /// 🐧 On Linux the runner streams the statement straight from the ledger
+  /// into the file a page at a time, so long ranges don't build up in memory.
+  static Future<void> _saveNativeStatement(String user, DateTime from, DateTime to, String periodTitle) async {
+    final String? outputFile = await FilePicker.platform.saveFile(
+      dialogTitle: 'Save Statement',
+      fileName: _fileName(periodTitle),
+      type: FileType.custom,
+      allowedExtensions: ['pdf'],
+    );
+    if (outputFile == null) return;
+    await NativeLedger.statement(user, from, to, periodTitle, outputFile, _fontAsset);
+  }
+
+  static Future<void> _printNativeStatement(String user, DateTime from, DateTime to, String periodTitle) async {
+    final dir = await Directory.systemTemp.createTemp('money_map_');
+    try {
+      final file = File('${dir.path}/${_fileName(periodTitle)}');
+      await NativeLedger.statement(user, from, to, periodTitle, file.path, _fontAsset);
+      final bool success = await Printing.layoutPdf(
+        onLayout: (PdfPageFormat format) => file.readAsBytes(),
+        name: _fileName(periodTitle),
+      );
+      if (success) return;
+    } catch (e) {
+      debugPrint('⚠️ Printing failed: $e. Saving instead.');
+    } finally {
+      await dir.delete(recursive: true);
+    }
+    await _saveNativeStatement(user, from, to, periodTitle);
+  }
+
   static Future<pw.Document> _generateDocument(
     List<TransactionModel> transactions,
     double totalIncome,
@@ -101,7 +151,7 @@ class PdfService {
     String periodTitle,
   ) async {
     final pdf = pw.Document();
-    final fontData = await rootBundle.load('assets/fonts/Roboto-Regular.ttf');
+    final fontData = await rootBundle.load(_fontAsset);
     final ttf = pw.Font.ttf(fontData);
 
     final theme = pw.ThemeData.withFont(
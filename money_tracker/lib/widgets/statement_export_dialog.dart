@@ -1,6 +1,8 @@
 import 'package:flutter/material.dart';
 import 'package:provider/provider.dart';
+import '../models/transaction_model.dart';
 import '../providers/finance_provider.dart';
+import '../services/native_ledger.dart';
 import '../services/pdf_service.dart';
 import '../widgets/bounce_button.dart';
 
@@ -84,25 +86,35 @@ class _StatementExportDialogState extends State<StatementExportDialog> {
     if (!_isValidRange) return;
 
     final finance = context.read<FinanceProvider>();
-    final transactions = finance.getTransactionsInRange(_fromDate, _toDate);
+    List<TransactionModel> transactions = const [];
+    double income = 0;
+    double expense = 0;
 
-    if (transactions.isEmpty) {
+    if (NativeLedger.isAvailable) {
+      // The runner sums the range and writes the statement from the ledger
+      final end = DateTime(_toDate.year, _toDate.month, _toDate.day + 1);
+      final totals = await NativeLedger.totals(finance.currentUser, _fromDate, end);
+      if (!mounted) return;
+      income = totals[0];
+      expense = totals[1];
+    } else {
+      transactions = finance.getTransactionsInRange(_fromDate, _toDate);
+      for (var t in transactions) {
+        if (t.isIncome) {
+          income += t.amount;
+        } else {
+          expense += t.amount;
+        }
+      }
+    }
+
+    if (income == 0 && expense == 0) {
       ScaffoldMessenger.of(context).showSnackBar(
         const SnackBar(content: Text('No transactions found in this range')),
       );
       return;
     }
 
-    double income = 0;
-    double expense = 0;
-    for (var t in transactions) {
-      if (t.isIncome) {
-        income += t.amount;
-      } else {
-        expense += t.amount;
-      }
-    }
-
     final rangeTitle = _selectedPreset == 'other'
         ? '${_fromDate.day}/${_fromDate.month}/${_fromDate.year} - ${_toDate.day}/${_toDate.month}/${_toDate.year}'
         : _getPresetLabel(_selectedPreset);
@@ -116,6 +128,9 @@ class _StatementExportDialogState extends State<StatementExportDialog> {
         totalExpense: expense,
         netBalance: income - expense,
         periodTitle: rangeTitle,
+        user: finance.currentUser,
+        from: _fromDate,
+        to: _toDate,
       );
     } else {
       await PdfService.saveTransactionReport(
@@ -124,6 +139,9 @@ class _StatementExportDialogState extends State<StatementExportDialog> {
         totalExpense: expense,
         netBalance: income - expense,
         periodTitle: rangeTitle,
+        user: finance.currentUser,
+        from: _fromDate,
+        to: _toDate,
       );
     }
   }
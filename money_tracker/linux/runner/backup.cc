@@ -0,0 +1,592 @@
+#include "backup.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <set>
+#include <sstream>
+
+#include "preferences.h"
+
+// File layout, all integers little-endian:
+//   "MTBACKP1"
+//   frames of
+//     u8 method ('Z' deflated, 'S' stored), u32 size, u32 stored size,
+//     u32 CRC-32 of the size bytes, stored bytes
+//   and last a frame with size 0 whose CRC-32 is that of all the records.
+//
+// The frames hold these records:
+//   'P' u8 type, u16 key length, key, value     a preference, the value being
+//       s: u32 length, bytes   i: i64   b: u8   d: f64
+//       l: u32 count, each u32 length, bytes
+//   'U' u16 length, name                        starts a user's ledger
+//   'C' u16 length, name                        a category of that ledger
+//   'T' i64 date, f64 amount, u8 income, u32 category
+namespace {
+
+const char kMagic[8] = {'M', 'T', 'B', 'A', 'C', 'K', 'P', '1'};
+const char kDeflated = 'Z';
+const char kStored = 'S';
+const size_t kFrameHeaderSize = 1 + 4 + 4 + 4;
+
+const char kPreferenceRecord = 'P';
+const char kUserRecord = 'U';
+const char kCategoryRecord = 'C';
+const char kTransactionRecord = 'T';
+const size_t kTransactionSize = 8 + 8 + 1 + 4;
+
+std::string ErrnoMessage(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+template <typename T>
+void Put(std::string* out, T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(const char* p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+bool PutString16(std::string* out, const std::string& value,
+                 std::string* error) {
+  if (value.size() > UINT16_MAX) {
+    *error = "Name too long for a backup: " + value.substr(0, 40);
+    return false;
+  }
+  Put<uint16_t>(out, static_cast<uint16_t>(value.size()));
+  *out += value;
+  return true;
+}
+
+void PutString32(std::string* out, const std::string& value) {
+  Put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+  *out += value;
+}
+
+bool WriteAll(int fd, const char* p, size_t left) {
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+// Reads up to |size| bytes, fewer only at the end of the file.
+ssize_t ReadUpTo(int fd, char* p, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, p + done, size - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    if (n == 0) break;
+    done += n;
+  }
+  return done;
+}
+
+// The record stream of a backup, read one frame at a time.
+class FrameReader {
+ public:
+  ~FrameReader() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool Open(const std::string& path, std::string* error) {
+    path_ = path;
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+      *error = ErrnoMessage("Cannot open", path);
+      return false;
+    }
+    char magic[sizeof(kMagic)];
+    ssize_t n = ReadUpTo(fd_, magic, sizeof(magic));
+    if (n < 0) {
+      *error = ErrnoMessage("Cannot read", path);
+      return false;
+    }
+    if (n != sizeof(magic) || memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+      *error = path + " is not a backup";
+      return false;
+    }
+    crc_ = crc32(0, Z_NULL, 0);
+    return true;
+  }
+
+  // Sets |end| once the last record has been read and every frame checked.
+  bool AtEnd(bool* end, std::string* error) {
+    while (pos_ == frame_.size() && !ended_) {
+      if (!NextFrame(error)) return false;
+    }
+    *end = pos_ == frame_.size();
+    return true;
+  }
+
+  bool Read(char* out, size_t size, std::string* error) {
+    while (size > 0) {
+      if (pos_ == frame_.size()) {
+        if (ended_) return Damaged(error);
+        if (!NextFrame(error)) return false;
+        continue;
+      }
+      size_t n = std::min(size, frame_.size() - pos_);
+      memcpy(out, frame_.data() + pos_, n);
+      pos_ += n;
+      out += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  template <typename T>
+  bool Read(T* value, std::string* error) {
+    char bytes[sizeof(T)];
+    if (!Read(bytes, sizeof(bytes), error)) return false;
+    *value = Get<T>(bytes);
+    return true;
+  }
+
+  // Reads |size| bytes a frame at a time, so a damaged length runs into the
+  // end of the backup instead of allocating it up front.
+  bool ReadString(size_t size, std::string* out, std::string* error) {
+    out->clear();
+    char chunk[4096];
+    while (out->size() < size) {
+      size_t n = std::min(sizeof(chunk), size - out->size());
+      if (!Read(chunk, n, error)) return false;
+      out->append(chunk, n);
+    }
+    return true;
+  }
+
+  template <typename Length>
+  bool ReadString(std::string* out, std::string* error) {
+    Length length;
+    return Read(&length, error) && ReadString(length, out, error);
+  }
+
+  bool Damaged(std::string* error) {
+    *error = path_ + " is damaged or cut off";
+    return false;
+  }
+
+ private:
+  bool NextFrame(std::string* error) {
+    char header[kFrameHeaderSize];
+    ssize_t n = ReadUpTo(fd_, header, sizeof(header));
+    if (n < 0) {
+      *error = ErrnoMessage("Cannot read", path_);
+      return false;
+    }
+    if (n != sizeof(header)) return Damaged(error);
+    char method = header[0];
+    uint32_t size = Get<uint32_t>(header + 1);
+    uint32_t stored_size = Get<uint32_t>(header + 5);
+    uint32_t crc = Get<uint32_t>(header + 9);
+    frame_.clear();
+    pos_ = 0;
+
+    if (size == 0) {
+      // The end: nothing may follow, and no frame may have gone missing
+      char extra;
+      if (stored_size != 0 || crc != crc_ || ReadUpTo(fd_, &extra, 1) != 0) {
+        return Damaged(error);
+      }
+      ended_ = true;
+      return true;
+    }
+
+    if (size > kBackupFrameSize ||
+        stored_size > compressBound(kBackupFrameSize) ||
+        (method == kStored && stored_size != size) ||
+        (method != kStored && method != kDeflated)) {
+      return Damaged(error);
+    }
+    stored_.resize(stored_size);
+    n = ReadUpTo(fd_, &stored_[0], stored_size);
+    if (n < 0) {
+      *error = ErrnoMessage("Cannot read", path_);
+      return false;
+    }
+    if (static_cast<size_t>(n) != stored_size) return Damaged(error);
+    if (method == kStored) {
+      frame_.swap(stored_);
+    } else {
+      frame_.resize(size);
+      uLongf length = size;
+      if (uncompress(reinterpret_cast<Bytef*>(&frame_[0]), &length,
+                     reinterpret_cast<const Bytef*>(stored_.data()),
+                     stored_size) != Z_OK ||
+          length != size) {
+        return Damaged(error);
+      }
+    }
+    const Bytef* bytes = reinterpret_cast<const Bytef*>(frame_.data());
+    if (crc32(0, bytes, size) != crc) return Damaged(error);
+    crc_ = crc32(crc_, bytes, size);
+    return true;
+  }
+
+  std::string path_;
+  int fd_ = -1;
+  std::string frame_;
+  size_t pos_ = 0;
+  std::string stored_;
+  uint32_t crc_ = 0;
+  bool ended_ = false;
+};
+
+bool ReadPreference(FrameReader* reader, BackupPreference* preference,
+                    std::string* error) {
+  char type;
+  if (!reader->Read(&type, 1, error) ||
+      !reader->ReadString<uint16_t>(&preference->key, error)) {
+    return false;
+  }
+  preference->type = static_cast<BackupPreference::Type>(type);
+  switch (type) {
+    case BackupPreference::kString:
+      return reader->ReadString<uint32_t>(&preference->string_value, error);
+    case BackupPreference::kInt:
+      return reader->Read(&preference->int_value, error);
+    case BackupPreference::kBool: {
+      uint8_t value;
+      if (!reader->Read(&value, error)) return false;
+      preference->bool_value = value != 0;
+      return true;
+    }
+    case BackupPreference::kDouble:
+      return reader->Read(&preference->double_value, error);
+    case BackupPreference::kStringList: {
+      uint32_t count;
+      if (!reader->Read(&count, error)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+        std::string value;
+        if (!reader->ReadString<uint32_t>(&value, error)) return false;
+        preference->string_list.push_back(std::move(value));
+      }
+      return true;
+    }
+  }
+  return reader->Damaged(error);
+}
+
+// |text| as a JSON string.
+std::string JsonString(const std::string& text) {
+  std::string out = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out += escape;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  return out + "\"";
+}
+
+// |preferences| as the shared_preferences plugin keeps them in its file.
+std::string PreferencesJson(const std::vector<BackupPreference>& preferences) {
+  std::ostringstream json;
+  json.imbue(std::locale::classic());  // GTK may have set a decimal comma
+  json << '{';
+  for (size_t i = 0; i < preferences.size(); i++) {
+    const BackupPreference& preference = preferences[i];
+    if (i > 0) json << ',';
+    json << JsonString(PreferenceFileKey(preference.key)) << ':';
+    switch (preference.type) {
+      case BackupPreference::kString:
+        json << JsonString(preference.string_value);
+        break;
+      case BackupPreference::kInt:
+        json << preference.int_value;
+        break;
+      case BackupPreference::kBool:
+        json << (preference.bool_value ? "true" : "false");
+        break;
+      case BackupPreference::kDouble: {
+        std::ostringstream number;
+        number.imbue(std::locale::classic());
+        number.precision(17);
+        number << preference.double_value;
+        // Dart reads a number without a point back as an int
+        std::string text = number.str();
+        if (text.find_first_of(".e") == std::string::npos) text += ".0";
+        json << text;
+        break;
+      }
+      case BackupPreference::kStringList:
+        json << '[';
+        for (size_t j = 0; j < preference.string_list.size(); j++) {
+          if (j > 0) json << ',';
+          json << JsonString(preference.string_list[j]);
+        }
+        json << ']';
+        break;
+    }
+  }
+  json << '}';
+  return json.str();
+}
+
+bool WriteSynced(const std::string& path, const std::string& data,
+                 std::string* error) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    *error = ErrnoMessage("Cannot create", path);
+    return false;
+  }
+  bool written = WriteAll(fd, data.data(), data.size()) && fdatasync(fd) == 0;
+  if (close(fd) != 0) written = false;
+  if (!written) {
+    *error = ErrnoMessage("Cannot write", path);
+    unlink(path.c_str());
+  }
+  return written;
+}
+
+// Discards the store's staging directory unless it was committed.
+class StagedLedgers {
+ public:
+  explicit StagedLedgers(LedgerStore* store) : store_(store) {}
+  ~StagedLedgers() {
+    if (!committed_) store_->DiscardStaged();
+  }
+
+  bool Contains(const std::string& user) const {
+    return seen_.count(user) != 0;
+  }
+
+  std::string Add(const std::string& user) {
+    seen_.insert(user);
+    return store_->StagedPathFor(user);
+  }
+
+  bool Commit(std::string* error) {
+    committed_ = store_->CommitStaged(error);
+    return committed_;
+  }
+
+ private:
+  LedgerStore* store_;
+  std::set<std::string> seen_;
+  bool committed_ = false;
+};
+
+}  // namespace
+
+BackupWriter::~BackupWriter() {
+  if (fd_ < 0) return;
+  close(fd_);
+  unlink(temp_.c_str());
+}
+
+bool BackupWriter::Open(const std::string& path, std::string* error) {
+  path_ = path;
+  temp_ = path + ".tmp";
+  fd_ = open(temp_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    *error = ErrnoMessage("Cannot create", temp_);
+    return false;
+  }
+  if (!WriteAll(fd_, kMagic, sizeof(kMagic))) {
+    *error = ErrnoMessage("Cannot write", temp_);
+    return false;
+  }
+  crc_ = crc32(0, Z_NULL, 0);
+  return true;
+}
+
+bool BackupWriter::WriteFrame(const char* data, size_t size,
+                              std::string* error) {
+  const Bytef* bytes = reinterpret_cast<const Bytef*>(data);
+  uint32_t crc = crc32(0, bytes, size);
+  crc_ = crc32(crc_, bytes, size);
+
+  // The header goes in front of the deflated bytes, so a frame is one write
+  compressed_.resize(kFrameHeaderSize + compressBound(size));
+  uLongf length = compressed_.size() - kFrameHeaderSize;
+  char method = kDeflated;
+  if (compress2(reinterpret_cast<Bytef*>(&compressed_[kFrameHeaderSize]),
+                &length, bytes, size, Z_BEST_SPEED) != Z_OK ||
+      length >= size) {
+    method = kStored;
+    length = size;
+    memcpy(&compressed_[kFrameHeaderSize], data, size);
+  }
+  std::string header(1, method);
+  Put<uint32_t>(&header, static_cast<uint32_t>(size));
+  Put<uint32_t>(&header, static_cast<uint32_t>(length));
+  Put<uint32_t>(&header, crc);
+  memcpy(&compressed_[0], header.data(), kFrameHeaderSize);
+  if (!WriteAll(fd_, compressed_.data(), kFrameHeaderSize + length)) {
+    *error = ErrnoMessage("Cannot write", temp_);
+    return false;
+  }
+  return true;
+}
+
+bool BackupWriter::Append(const std::string& record, std::string* error) {
+  frame_ += record;
+  size_t done = 0;
+  for (; frame_.size() - done >= kBackupFrameSize; done += kBackupFrameSize) {
+    if (!WriteFrame(frame_.data() + done, kBackupFrameSize, error)) {
+      return false;
+    }
+  }
+  frame_.erase(0, done);
+  return true;
+}
+
+bool BackupWriter::AddPreference(const BackupPreference& preference,
+                                 std::string* error) {
+  std::string record(1, kPreferenceRecord);
+  record += preference.type;
+  if (!PutString16(&record, preference.key, error)) return false;
+  switch (preference.type) {
+    case BackupPreference::kString:
+      PutString32(&record, preference.string_value);
+      break;
+    case BackupPreference::kInt:
+      Put<int64_t>(&record, preference.int_value);
+      break;
+    case BackupPreference::kBool:
+      Put<uint8_t>(&record, preference.bool_value ? 1 : 0);
+      break;
+    case BackupPreference::kDouble:
+      Put<double>(&record, preference.double_value);
+      break;
+    case BackupPreference::kStringList:
+      Put<uint32_t>(&record,
+                    static_cast<uint32_t>(preference.string_list.size()));
+      for (const std::string& value : preference.string_list) {
+        PutString32(&record, value);
+      }
+      break;
+  }
+  return Append(record, error);
+}
+
+bool BackupWriter::AddLedger(const std::string& user, const Ledger& ledger,
+                             std::string* error) {
+  std::string record(1, kUserRecord);
+  if (!PutString16(&record, user, error)) return false;
+  for (const std::string& name : ledger.categories()) {
+    record += kCategoryRecord;
+    if (!PutString16(&record, name, error)) return false;
+  }
+  if (!Append(record, error)) return false;
+
+  // A span is at most one block of the ledger, so this stays small too
+  bool ok = true;
+  ledger.ForEachSpan(
+      std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(),
+      [&](const LedgerSpan& span) {
+        if (!ok) return;
+        std::string rows;
+        rows.reserve(span.count * (1 + kTransactionSize));
+        for (size_t i = 0; i < span.count; i++) {
+          rows += kTransactionRecord;
+          Put<int64_t>(&rows, span.dates[i]);
+          Put<double>(&rows, span.amounts[i]);
+          Put<uint8_t>(&rows, span.income[i]);
+          Put<uint32_t>(&rows, span.categories[i]);
+        }
+        ok = Append(rows, error);
+      });
+  return ok;
+}
+
+bool BackupWriter::Finish(std::string* error) {
+  if (!frame_.empty() && !WriteFrame(frame_.data(), frame_.size(), error)) {
+    return false;
+  }
+  frame_.clear();
+  std::string end(1, kStored);
+  Put<uint32_t>(&end, 0);
+  Put<uint32_t>(&end, 0);
+  Put<uint32_t>(&end, crc_);
+  if (!WriteAll(fd_, end.data(), end.size()) || fdatasync(fd_) != 0) {
+    *error = ErrnoMessage("Cannot write", temp_);
+    return false;
+  }
+  close(fd_);
+  fd_ = -1;
+  if (rename(temp_.c_str(), path_.c_str()) != 0) {
+    *error = ErrnoMessage("Cannot write", path_);
+    unlink(temp_.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool RestoreBackup(const std::string& path, LedgerStore* store,
+                   std::vector<BackupPreference>* preferences,
+                   std::string* error) {
+  FrameReader reader;
+  if (!reader.Open(path, error)) return false;
+
+  if (!store->BeginStaging(error)) return false;
+  StagedLedgers staged(store);
+  std::unique_ptr<LedgerWriter> ledger;
+  while (true) {
+    bool end;
+    if (!reader.AtEnd(&end, error)) return false;
+    if (end) break;
+
+    char type;
+    if (!reader.Read(&type, 1, error)) return false;
+    if (type == kPreferenceRecord) {
+      BackupPreference preference;
+      if (!ReadPreference(&reader, &preference, error)) return false;
+      preferences->push_back(std::move(preference));
+    } else if (type == kUserRecord) {
+      std::string user;
+      if (!reader.ReadString<uint16_t>(&user, error)) return false;
+      if (ledger && !ledger->Finish(error)) return false;
+      if (staged.Contains(user)) return reader.Damaged(error);
+      ledger.reset(new LedgerWriter());
+      if (!ledger->Open(staged.Add(user), error)) return false;
+    } else if (type == kCategoryRecord && ledger) {
+      std::string name;
+      if (!reader.ReadString<uint16_t>(&name, error) ||
+          !ledger->AddCategory(name, error)) {
+        return false;
+      }
+    } else if (type == kTransactionRecord && ledger) {
+      char bytes[kTransactionSize];
+      if (!reader.Read(bytes, sizeof(bytes), error)) return false;
+      LedgerRow row{Get<int64_t>(bytes), Get<double>(bytes + 8),
+                    bytes[16] != 0, Get<uint32_t>(bytes + 17)};
+      if (!ledger->AddRow(row, error)) return false;
+    } else {
+      return reader.Damaged(error);
+    }
+  }
+  if (ledger && !ledger->Finish(error)) return false;
+
+  // Committed with the ledgers, to be applied by the Dart side
+  if (!WriteSynced(PendingPreferencesPath(store->StagingDirectory()),
+                   PreferencesJson(*preferences), error)) {
+    return false;
+  }
+  return staged.Commit(error);
+}
@@ -0,0 +1,80 @@
+#ifndef RUNNER_BACKUP_H_
+#define RUNNER_BACKUP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ledger.h"
+
+// A backup file is a stream of records cut into frames of at most
+// kBackupFrameSize bytes. Each frame is deflated and checked with a CRC-32
+// on its own, so both writing and restoring hold one frame at a time however
+// large the ledgers are. A record may run on into the next frame.
+const size_t kBackupFrameSize = 64 * 1024;
+
+// One SharedPreferences entry.
+struct BackupPreference {
+  enum Type : char {
+    kString = 's',
+    kInt = 'i',
+    kBool = 'b',
+    kDouble = 'd',
+    kStringList = 'l',
+  };
+
+  std::string key;
+  Type type = kString;
+  std::string string_value;
+  int64_t int_value = 0;
+  bool bool_value = false;
+  double double_value = 0;
+  std::vector<std::string> string_list;
+};
+
+// Writes a backup to |path|. The file is written next to it and renamed over
+// it by Finish(), so an export that fails leaves nothing half written.
+class BackupWriter {
+ public:
+  BackupWriter() = default;
+  ~BackupWriter();
+
+  BackupWriter(const BackupWriter&) = delete;
+  BackupWriter& operator=(const BackupWriter&) = delete;
+
+  bool Open(const std::string& path, std::string* error);
+
+  bool AddPreference(const BackupPreference& preference, std::string* error);
+
+  // Streams |ledger|'s categories and rows, oldest first.
+  bool AddLedger(const std::string& user, const Ledger& ledger,
+                 std::string* error);
+
+  bool Finish(std::string* error);
+
+ private:
+  bool Append(const std::string& record, std::string* error);
+  bool WriteFrame(const char* data, size_t size, std::string* error);
+
+  std::string path_;
+  std::string temp_;
+  int fd_ = -1;
+  std::string frame_;
+  std::string compressed_;
+  uint32_t crc_ = 0;  // Of every record so far
+};
+
+// Restores the backup at |path|: its ledgers replace all of |store|'s, and
+// its preferences are returned in |preferences| for the caller to apply.
+//
+// The ledgers are written to the store's staging directory while the backup
+// is read, and the preferences beside them. Only once every frame has
+// checked out is the directory committed in place of the live one, so a
+// damaged or cut-off backup, or a crash at any point, leaves either the old
+// data or the new. The preferences become pending (see preferences.h) rather
+// than replacing the plugin's file, which it would overwrite from memory.
+bool RestoreBackup(const std::string& path, LedgerStore* store,
+                   std::vector<BackupPreference>* preferences,
+                   std::string* error);
+
+#endif  // RUNNER_BACKUP_H_
@@ -0,0 +1,625 @@
+#include "ledger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "startup_trace.h"
+
+// Log layout, all integers little-endian:
+//   "MTLEDGR1"
+//   'C' u16 length, name          a new category; ids count up from 0
+//   'T' i64 date, f64 amount, u8 income, u32 category
+namespace {
+
+const char kMagic[8] = {'M', 'T', 'L', 'E', 'D', 'G', 'R', '1'};
+const char kCategoryRecord = 'C';
+const char kTransactionRecord = 'T';
+const size_t kTransactionRecordSize = 1 + 8 + 8 + 1 + 4;
+const char kLedgerExtension[] = ".ledger";
+
+// Beside the ledger directory while a backup is restored
+const char kStagingSuffix[] = ".restore";
+const char kOldSuffix[] = ".old";
+
+// LedgerWriter writes in pieces of about this size
+const size_t kWriteBufferSize = 64 * 1024;
+
+std::string ErrnoMessage(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+template <typename T>
+void Put(std::string* out, T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(const char* p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::string CategoryRecord(const std::string& name) {
+  std::string record(1, kCategoryRecord);
+  Put<uint16_t>(&record, static_cast<uint16_t>(name.size()));
+  record += name;
+  return record;
+}
+
+void PutTransaction(std::string* out, const LedgerRow& row) {
+  *out += kTransactionRecord;
+  Put<int64_t>(out, row.date_us);
+  Put<double>(out, row.amount);
+  Put<uint8_t>(out, row.is_income ? 1 : 0);
+  Put<uint32_t>(out, row.category);
+}
+
+bool WriteAll(int fd, const std::string& data) {
+  const char* p = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+// A whole file mapped read-only for as long as the object lives. The log is
+// parsed straight from the page cache instead of being copied into a buffer
+// first.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() {
+    if (size_ > 0) munmap(const_cast<char*>(data_), size_);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Map(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    if (st.st_size == 0) return true;
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return false;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+    size_ = st.st_size;
+    return true;
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// User names are free text, so anything but [A-Za-z0-9_-] is hex-escaped
+std::string LedgerFileName(const std::string& user) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string name;
+  for (unsigned char c : user) {
+    if (isalnum(c) || c == '_' || c == '-') {
+      name += static_cast<char>(c);
+    } else {
+      name += '%';
+      name += kHex[c >> 4];
+      name += kHex[c & 15];
+    }
+  }
+  return name + kLedgerExtension;
+}
+
+std::string ParentDirectory(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if (slash == std::string::npos) return ".";
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Makes the names in |path| durable, e.g. after renames into it.
+bool SyncDirectory(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return false;
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+// Deletes the directory at |path| and the files in it, if it is there.
+void RemoveDirectory(const std::string& path) {
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) return;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") unlink((path + "/" + name).c_str());
+  }
+  closedir(dir);
+  rmdir(path.c_str());
+}
+
+bool MakeDirectories(const std::string& path) {
+  for (size_t i = 1; i <= path.size(); i++) {
+    if (i < path.size() && path[i] != '/') continue;
+    std::string prefix = path.substr(0, i);
+    if (mkdir(prefix.c_str(), 0700) != 0 && errno != EEXIST) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+LedgerWriter::~LedgerWriter() {
+  if (fd_ < 0) return;
+  close(fd_);
+  unlink(path_.c_str());
+}
+
+bool LedgerWriter::Open(const std::string& path, std::string* error) {
+  path_ = path;
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    *error = ErrnoMessage("Cannot create", path);
+    return false;
+  }
+  buffer_.assign(kMagic, sizeof(kMagic));
+  return true;
+}
+
+bool LedgerWriter::AddCategory(const std::string& name, std::string* error) {
+  if (name.size() > UINT16_MAX) {
+    *error = "Category name too long";
+    return false;
+  }
+  buffer_ += CategoryRecord(name);
+  category_count_++;
+  return buffer_.size() < kWriteBufferSize || Flush(error);
+}
+
+bool LedgerWriter::AddRow(const LedgerRow& row, std::string* error) {
+  if (row.category >= category_count_) {
+    *error = "Unknown category";
+    return false;
+  }
+  PutTransaction(&buffer_, row);
+  return buffer_.size() < kWriteBufferSize || Flush(error);
+}
+
+bool LedgerWriter::Flush(std::string* error) {
+  if (!WriteAll(fd_, buffer_)) {
+    *error = ErrnoMessage("Cannot write", path_);
+    return false;
+  }
+  buffer_.clear();
+  return true;
+}
+
+bool LedgerWriter::Finish(std::string* error) {
+  if (!Flush(error)) return false;
+  if (fdatasync(fd_) != 0) {
+    *error = ErrnoMessage("Cannot write", path_);
+    return false;
+  }
+  close(fd_);
+  fd_ = -1;
+  return true;
+}
+
+Ledger::~Ledger() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool Ledger::Open(const std::string& path, std::string* error) {
+  path_ = path;
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    *error = ErrnoMessage("Cannot open", path);
+    return false;
+  }
+
+  MappedFile data;
+  if (!data.Map(fd_)) {
+    *error = ErrnoMessage("Cannot read", path);
+    return false;
+  }
+  if (data.size() == 0) {
+    if (!WriteAll(fd_, std::string(kMagic, sizeof(kMagic)))) {
+      *error = ErrnoMessage("Cannot write", path);
+      return false;
+    }
+    BuildBlocks({});
+    return true;
+  }
+  if (data.size() < sizeof(kMagic) ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    *error = path + " is not a ledger";
+    return false;
+  }
+
+  std::vector<LedgerRow> rows;
+  rows.reserve(data.size() / kTransactionRecordSize);
+  size_t pos = sizeof(kMagic);
+  while (pos < data.size()) {
+    const char* p = data.data() + pos;
+    size_t left = data.size() - pos;
+    if (*p == kCategoryRecord) {
+      if (left < 3) break;
+      size_t length = Get<uint16_t>(p + 1);
+      if (left < 3 + length) break;
+      std::string name(p + 3, length);
+      category_ids_.emplace(name, static_cast<uint32_t>(categories_.size()));
+      categories_.push_back(std::move(name));
+      pos += 3 + length;
+    } else if (*p == kTransactionRecord) {
+      if (left < kTransactionRecordSize) break;
+      LedgerRow row;
+      row.date_us = Get<int64_t>(p + 1);
+      row.amount = Get<double>(p + 9);
+      row.is_income = p[17] != 0;
+      row.category = Get<uint32_t>(p + 18);
+      if (row.category >= categories_.size()) {
+        *error = path + " is damaged at byte " + std::to_string(pos);
+        return false;
+      }
+      rows.push_back(row);
+      pos += kTransactionRecordSize;
+    } else {
+      *error = path + " is damaged at byte " + std::to_string(pos);
+      return false;
+    }
+  }
+  // Whatever follows the last whole record was cut off mid-write
+  if (pos < data.size() && ftruncate(fd_, pos) != 0) {
+    *error = ErrnoMessage("Cannot repair", path);
+    return false;
+  }
+
+  BuildBlocks(std::move(rows));
+  return true;
+}
+
+bool Ledger::AppendRecord(const std::string& record, std::string* error) {
+  if (!WriteAll(fd_, record) || fdatasync(fd_) != 0) {
+    *error = ErrnoMessage("Cannot write", path_);
+    return false;
+  }
+  return true;
+}
+
+bool Ledger::InternCategory(const std::string& name, uint32_t* id,
+                            std::string* error) {
+  auto it = category_ids_.find(name);
+  if (it != category_ids_.end()) {
+    *id = it->second;
+    return true;
+  }
+  if (name.size() > UINT16_MAX) {
+    *error = "Category name too long";
+    return false;
+  }
+  if (!AppendRecord(CategoryRecord(name), error)) return false;
+  *id = static_cast<uint32_t>(categories_.size());
+  category_ids_.emplace(name, *id);
+  categories_.push_back(name);
+  return true;
+}
+
+bool Ledger::Insert(int64_t date_us, double amount, bool is_income,
+                    const std::string& category, std::string* error) {
+  LedgerRow row{date_us, amount, is_income, 0};
+  if (!InternCategory(category, &row.category, error)) return false;
+  std::string record;
+  PutTransaction(&record, row);
+  if (!AppendRecord(record, error)) return false;
+  InsertRow(row);
+  return true;
+}
+
+void Ledger::InsertRow(const LedgerRow& row) {
+  if (blocks_.empty()) blocks_.emplace_back(new Block());
+
+  // The first block ending after the date, so equal dates go last
+  auto it = std::upper_bound(
+      blocks_.begin(), blocks_.end(), row.date_us,
+      [](int64_t date, const std::unique_ptr<Block>& block) {
+        return !block->dates.empty() && date < block->dates.back();
+      });
+  if (it == blocks_.end()) --it;
+  Block& block = **it;
+  size_t at = std::upper_bound(block.dates.begin(), block.dates.end(),
+                               row.date_us) -
+              block.dates.begin();
+  block.dates.insert(block.dates.begin() + at, row.date_us);
+  block.amounts.insert(block.amounts.begin() + at, row.amount);
+  block.income.insert(block.income.begin() + at, row.is_income ? 1 : 0);
+  block.categories.insert(block.categories.begin() + at, row.category);
+  size_++;
+  daily_.Add(LedgerDay(row.date_us), &block.amounts[at], &block.income[at], 1);
+  if (block.dates.size() <= kMaxBlockRows) return;
+
+  // Appending to the newest block starts a fresh one, so a ledger that only
+  // grows at the end keeps its blocks full. Otherwise the block is halved.
+  size_t keep = std::next(it) == blocks_.end() && at == kMaxBlockRows
+                    ? kMaxBlockRows
+                    : block.dates.size() / 2;
+  std::unique_ptr<Block> rest(new Block());
+  rest->dates.assign(block.dates.begin() + keep, block.dates.end());
+  rest->amounts.assign(block.amounts.begin() + keep, block.amounts.end());
+  rest->income.assign(block.income.begin() + keep, block.income.end());
+  rest->categories.assign(block.categories.begin() + keep,
+                          block.categories.end());
+  block.dates.resize(keep);
+  block.amounts.resize(keep);
+  block.income.resize(keep);
+  block.categories.resize(keep);
+  blocks_.insert(std::next(it), std::move(rest));
+}
+
+void Ledger::BuildBlocks(std::vector<LedgerRow> rows) {
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](const LedgerRow& a, const LedgerRow& b) {
+                     return a.date_us < b.date_us;
+                   });
+  blocks_.clear();
+  size_ = rows.size();
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (i % kMaxBlockRows == 0) blocks_.emplace_back(new Block());
+    Block& block = *blocks_.back();
+    block.dates.push_back(rows[i].date_us);
+    block.amounts.push_back(rows[i].amount);
+    block.income.push_back(rows[i].is_income ? 1 : 0);
+    block.categories.push_back(rows[i].category);
+  }
+
+  // Each day's rows are next to each other, so they are summed in one go
+  daily_.Clear();
+  for (const std::unique_ptr<Block>& block : blocks_) {
+    for (size_t first = 0, last; first < block->dates.size(); first = last) {
+      int64_t day = LedgerDay(block->dates[first]);
+      last = first + 1;
+      while (last < block->dates.size() &&
+             LedgerDay(block->dates[last]) == day) {
+        last++;
+      }
+      daily_.Add(day, &block->amounts[first], &block->income[first],
+                 last - first);
+    }
+  }
+}
+
+bool Ledger::Replace(const std::vector<LedgerRow>& rows,
+                     const std::vector<std::string>& categories,
+                     std::string* error) {
+  std::string temp = path_ + ".tmp";
+  LedgerWriter writer;
+  if (!writer.Open(temp, error)) return false;
+  for (const std::string& name : categories) {
+    if (!writer.AddCategory(name, error)) return false;
+  }
+  for (const LedgerRow& row : rows) {
+    if (!writer.AddRow(row, error)) return false;
+  }
+  if (!writer.Finish(error)) return false;
+  if (rename(temp.c_str(), path_.c_str()) != 0) {
+    *error = ErrnoMessage("Cannot replace", path_);
+    unlink(temp.c_str());
+    return false;
+  }
+
+  int fd = open(path_.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+  if (fd < 0) {
+    *error = ErrnoMessage("Cannot open", path_);
+    return false;
+  }
+  close(fd_);
+  fd_ = fd;
+  categories_ = categories;
+  category_ids_.clear();
+  for (uint32_t id = 0; id < categories_.size(); id++) {
+    category_ids_.emplace(categories_[id], id);
+  }
+  BuildBlocks(rows);
+  return true;
+}
+
+void Ledger::ForEachSpan(
+    int64_t from_us, int64_t to_us,
+    const std::function<void(const LedgerSpan&)>& visit) const {
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), from_us,
+      [](const std::unique_ptr<Block>& block, int64_t date) {
+        return !block->dates.empty() && block->dates.back() < date;
+      });
+  for (; it != blocks_.end(); ++it) {
+    const Block& block = **it;
+    size_t first = std::lower_bound(block.dates.begin(), block.dates.end(),
+                                    from_us) -
+                   block.dates.begin();
+    size_t last = std::lower_bound(block.dates.begin() + first,
+                                   block.dates.end(), to_us) -
+                  block.dates.begin();
+    if (last > first) {
+      visit(LedgerSpan{&block.dates[first], &block.amounts[first],
+                       &block.income[first], &block.categories[first],
+                       last - first});
+    }
+    if (last < block.dates.size()) break;
+  }
+}
+
+void Ledger::Read(int64_t from_us, int64_t to_us, LedgerColumns* out) const {
+  ForEachSpan(from_us, to_us, [out](const LedgerSpan& span) {
+    out->dates.insert(out->dates.end(), span.dates, span.dates + span.count);
+    out->amounts.insert(out->amounts.end(), span.amounts,
+                        span.amounts + span.count);
+    out->income.insert(out->income.end(), span.income,
+                       span.income + span.count);
+    out->categories.insert(out->categories.end(), span.categories,
+                           span.categories + span.count);
+  });
+}
+
+LedgerStore::LedgerStore(std::string directory)
+    : directory_(std::move(directory)) {}
+
+LedgerStore::~LedgerStore() { FinishPreload(); }
+
+void LedgerStore::Preload(const std::string& user) {
+  FinishPreload();
+  std::string path = PathFor(user);
+  if (access(path.c_str(), F_OK) != 0) return;
+  preload_user_ = user;
+  preload_thread_ = std::thread([this, path] {
+    ScopedStartupSpan span("Preload ledger");
+    std::unique_ptr<Ledger> ledger(new Ledger());
+    std::string error;
+    // A ledger that can't be opened is left for Get() to report
+    if (ledger->Open(path, &error)) preloaded_ = std::move(ledger);
+  });
+}
+
+void LedgerStore::FinishPreload() {
+  if (!preload_thread_.joinable()) return;
+  preload_thread_.join();
+  if (preloaded_ != nullptr && Find(preload_user_) == ledgers_.end()) {
+    Keep(preload_user_, std::move(preloaded_));
+  }
+  preloaded_.reset();
+  preload_user_.clear();
+}
+
+std::string LedgerStore::PathFor(const std::string& user) const {
+  return directory_ + "/" + LedgerFileName(user);
+}
+
+std::string LedgerStore::StagedPathFor(const std::string& user) const {
+  return StagingDirectory() + "/" + LedgerFileName(user);
+}
+
+std::string LedgerStore::StagingDirectory() const {
+  return directory_ + kStagingSuffix;
+}
+
+Ledger* LedgerStore::Get(const std::string& user, std::string* error) {
+  if (user == preload_user_) FinishPreload();
+  auto it = Find(user);
+  if (it != ledgers_.end()) {
+    ledgers_.splice(ledgers_.begin(), ledgers_, it);
+    return it->second.get();
+  }
+  if (!MakeDirectories(directory_)) {
+    *error = ErrnoMessage("Cannot create", directory_);
+    return nullptr;
+  }
+  std::unique_ptr<Ledger> ledger(new Ledger());
+  if (!ledger->Open(PathFor(user), error)) return nullptr;
+  return Keep(user, std::move(ledger));
+}
+
+Ledger* LedgerStore::Keep(const std::string& user,
+                          std::unique_ptr<Ledger> ledger) {
+  ledgers_.emplace_front(user, std::move(ledger));
+  while (ledgers_.size() > kMaxOpenLedgers) ledgers_.pop_back();
+  return ledgers_.front().second.get();
+}
+
+LedgerStore::LedgerList::iterator LedgerStore::Find(const std::string& user) {
+  return std::find_if(ledgers_.begin(), ledgers_.end(),
+                      [&](const LedgerList::value_type& entry) {
+                        return entry.first == user;
+                      });
+}
+
+bool LedgerStore::Remove(const std::string& user, std::string* error) {
+  FinishPreload();
+  auto it = Find(user);
+  if (it != ledgers_.end()) ledgers_.erase(it);
+  std::string path = PathFor(user);
+  if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+    *error = ErrnoMessage("Cannot delete", path);
+    return false;
+  }
+  return true;
+}
+
+bool LedgerStore::BeginStaging(std::string* error) {
+  const std::string staging = StagingDirectory();
+  RemoveDirectory(staging);  // A restore that failed to clean up
+  if (!MakeDirectories(staging)) {
+    *error = ErrnoMessage("Cannot create", staging);
+    return false;
+  }
+  return true;
+}
+
+bool LedgerStore::CommitStaged(std::string* error) {
+  FinishPreload();
+  ledgers_.clear();
+  const std::string staging = StagingDirectory();
+  const std::string old = directory_ + kOldSuffix;
+  if (!SyncDirectory(staging)) {
+    *error = ErrnoMessage("Cannot write", staging);
+    return false;
+  }
+  if (access(directory_.c_str(), F_OK) != 0) {
+    // Nothing to replace yet
+    if (rename(staging.c_str(), directory_.c_str()) != 0) {
+      *error = ErrnoMessage("Cannot restore", directory_);
+      return false;
+    }
+  } else if (renameat2(AT_FDCWD, staging.c_str(), AT_FDCWD, directory_.c_str(),
+                       RENAME_EXCHANGE) == 0) {
+    RemoveDirectory(staging);  // Holds the old ledgers now
+  } else if (errno == EINVAL || errno == ENOSYS) {
+    // The file system can't exchange. If the app stops between these two
+    // renames, RecoverStaged() does the second one.
+    if (rename(directory_.c_str(), old.c_str()) != 0) {
+      *error = ErrnoMessage("Cannot restore", directory_);
+      return false;
+    }
+    if (rename(staging.c_str(), directory_.c_str()) != 0) {
+      *error = ErrnoMessage("Cannot restore", directory_);
+      rename(old.c_str(), directory_.c_str());
+      return false;
+    }
+    RemoveDirectory(old);
+  } else {
+    *error = ErrnoMessage("Cannot restore", directory_);
+    return false;
+  }
+  SyncDirectory(ParentDirectory(directory_));
+  return true;
+}
+
+void LedgerStore::DiscardStaged() { RemoveDirectory(StagingDirectory()); }
+
+void LedgerStore::RecoverStaged(const std::string& directory) {
+  const std::string staging = directory + kStagingSuffix;
+  const std::string old = directory + kOldSuffix;
+  if (access(directory.c_str(), F_OK) != 0 && access(old.c_str(), F_OK) == 0) {
+    // Stopped between the two renames of CommitStaged(), so the staging
+    // directory was complete
+    if (rename(staging.c_str(), directory.c_str()) != 0) {
+      rename(old.c_str(), directory.c_str());
+    }
+  }
+  // Either a restore that never committed or the ledgers one replaced
+  RemoveDirectory(staging);
+  RemoveDirectory(old);
+}
@@ -0,0 +1,215 @@
+#ifndef RUNNER_LEDGER_H_
+#define RUNNER_LEDGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ledger_stats.h"
+
+// One transaction as the ledger stores it. Dates are local wall-clock time in
+// microseconds, counted as if it were UTC, so a day is always 86400 s long.
+struct LedgerRow {
+  int64_t date_us;
+  double amount;
+  bool is_income;
+  uint32_t category;  // Index into Ledger::categories()
+};
+
+// Rows of a date range, one array per field.
+struct LedgerColumns {
+  std::vector<int64_t> dates;
+  std::vector<double> amounts;
+  std::vector<uint8_t> income;
+  std::vector<int32_t> categories;
+};
+
+// Rows that are stored next to each other, one pointer per field.
+struct LedgerSpan {
+  const int64_t* dates;
+  const double* amounts;
+  const uint8_t* income;
+  const uint32_t* categories;
+  size_t count;
+};
+
+// Writes a new ledger file one record at a time, so a ledger can be built
+// without holding its rows in memory. Nothing is left behind unless Finish()
+// succeeds.
+class LedgerWriter {
+ public:
+  LedgerWriter() = default;
+  ~LedgerWriter();
+
+  LedgerWriter(const LedgerWriter&) = delete;
+  LedgerWriter& operator=(const LedgerWriter&) = delete;
+
+  bool Open(const std::string& path, std::string* error);
+
+  // Categories get ids in the order they are added, counting up from 0.
+  bool AddCategory(const std::string& name, std::string* error);
+  bool AddRow(const LedgerRow& row, std::string* error);
+
+  // Flushes the file and syncs it to disk.
+  bool Finish(std::string* error);
+
+ private:
+  bool Flush(std::string* error);
+
+  std::string path_;
+  int fd_ = -1;
+  std::string buffer_;
+  uint32_t category_count_ = 0;
+};
+
+// A user's transactions, kept in date order.
+//
+// In memory the rows live in blocks of at most kMaxBlockRows, each block
+// holding its fields as separate arrays. An insert binary-searches the block
+// and shifts at most one block, so it costs O(log n) plus a constant however
+// long the history gets. Rows with equal dates keep their insertion order.
+//
+// On disk the ledger is an append-only log: an insert appends one record and
+// never rewrites earlier ones. The log is in insertion order and is sorted
+// once when it is opened.
+class Ledger {
+ public:
+  static const size_t kMaxBlockRows = 1024;
+
+  Ledger() = default;
+  ~Ledger();
+
+  Ledger(const Ledger&) = delete;
+  Ledger& operator=(const Ledger&) = delete;
+
+  // Opens the log at |path|, creating it if it does not exist. A record cut
+  // short by a crash is dropped.
+  bool Open(const std::string& path, std::string* error);
+
+  // Adds one transaction and appends it to the log.
+  bool Insert(int64_t date_us, double amount, bool is_income,
+              const std::string& category, std::string* error);
+
+  // Replaces the whole ledger with |rows|, whose categories index
+  // |categories|. The new log is written next to the old one and renamed over
+  // it, so a failure leaves the old ledger in place.
+  bool Replace(const std::vector<LedgerRow>& rows,
+               const std::vector<std::string>& categories, std::string* error);
+
+  // Copies the rows with from_us <= date < to_us.
+  void Read(int64_t from_us, int64_t to_us, LedgerColumns* out) const;
+
+  // Calls |visit| with the rows with from_us <= date < to_us, oldest first,
+  // one contiguous span at a time.
+  void ForEachSpan(int64_t from_us, int64_t to_us,
+                   const std::function<void(const LedgerSpan&)>& visit) const;
+
+  // Income and expense per day, kept up to date by every insert.
+  const DailyTotals& daily() const { return daily_; }
+
+  size_t size() const { return size_; }
+  const std::vector<std::string>& categories() const { return categories_; }
+  const std::string& path() const { return path_; }
+
+ private:
+  struct Block {
+    std::vector<int64_t> dates;
+    std::vector<double> amounts;
+    std::vector<uint8_t> income;
+    std::vector<uint32_t> categories;
+  };
+
+  // Returns the id of |name|, adding it (and its log record) if it is new.
+  bool InternCategory(const std::string& name, uint32_t* id,
+                      std::string* error);
+  void InsertRow(const LedgerRow& row);
+  void BuildBlocks(std::vector<LedgerRow> rows);
+  bool AppendRecord(const std::string& record, std::string* error);
+
+  std::string path_;
+  int fd_ = -1;
+  std::vector<std::unique_ptr<Block>> blocks_;
+  size_t size_ = 0;
+  std::vector<std::string> categories_;
+  std::map<std::string, uint32_t> category_ids_;
+  DailyTotals daily_;
+};
+
+// The ledgers of all users, one log file each under a directory.
+//
+// The most recently used ledgers stay open, so going back to a user who was
+// just looked at costs a lookup instead of reading their log again. Older
+// ones are closed to bound memory.
+class LedgerStore {
+ public:
+  static const size_t kMaxOpenLedgers = 4;
+
+  explicit LedgerStore(std::string directory);
+  ~LedgerStore();
+
+  LedgerStore(const LedgerStore&) = delete;
+  LedgerStore& operator=(const LedgerStore&) = delete;
+
+  // Starts opening |user|'s ledger on a thread of its own, so reading and
+  // sorting a long history overlaps with whatever the caller does next. The
+  // first Get() of |user| waits for it. Does nothing if |user| has no ledger
+  // yet.
+  void Preload(const std::string& user);
+
+  // Opens |user|'s ledger on first use. Returns nullptr and sets |error| if it
+  // can't be opened. The ledger may be closed by any later call on the store.
+  Ledger* Get(const std::string& user, std::string* error);
+
+  // Closes |user|'s ledger and deletes its file.
+  bool Remove(const std::string& user, std::string* error);
+
+  // Restoring a backup: BeginStaging() creates an empty staging directory
+  // beside the ledger directory, the new ledgers are written to
+  // StagedPathFor(user) along with anything else that must change with them,
+  // and CommitStaged() swaps the two directories in a single rename. That is
+  // the one point at which the restore takes effect; the old ledgers are
+  // deleted after it. Open ledgers are closed. DiscardStaged() drops a
+  // restore that is not going ahead.
+  bool BeginStaging(std::string* error);
+  bool CommitStaged(std::string* error);
+  void DiscardStaged();
+
+  // Finishes or undoes a CommitStaged() the app stopped in the middle of,
+  // and deletes whatever an interrupted restore left behind. Call at startup,
+  // before anything in |directory| is read.
+  static void RecoverStaged(const std::string& directory);
+
+  // The ledger file of |user|, which need not exist.
+  std::string PathFor(const std::string& user) const;
+  std::string StagedPathFor(const std::string& user) const;
+  std::string StagingDirectory() const;
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  typedef std::list<std::pair<std::string, std::unique_ptr<Ledger>>>
+      LedgerList;
+
+  // Waits for Preload() and keeps the ledger it opened, if any.
+  void FinishPreload();
+  // Makes |ledger| the most recently used, closing the least recently used
+  // ones beyond kMaxOpenLedgers.
+  Ledger* Keep(const std::string& user, std::unique_ptr<Ledger> ledger);
+  LedgerList::iterator Find(const std::string& user);
+
+  std::string directory_;
+  LedgerList ledgers_;  // Most recently used first
+
+  // Only the preload thread touches preloaded_ until it is joined
+  std::thread preload_thread_;
+  std::string preload_user_;
+  std::unique_ptr<Ledger> preloaded_;
+};
+
+#endif  // RUNNER_LEDGER_H_
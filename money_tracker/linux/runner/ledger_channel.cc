@@ -0,0 +1,410 @@
+#include "ledger_channel.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "backup.h"
+#include "ledger.h"
+#include "preferences.h"
+#include "statement.h"
+
+namespace {
+
+const char kChannelName[] = "money_tracker/ledger";
+
+// What the method call handler works with
+struct ChannelData {
+  ChannelData(const gchar* directory, const gchar* assets_directory)
+      : store(directory), assets_directory(assets_directory) {}
+
+  LedgerStore store;
+  std::string assets_directory;
+};
+
+// Longest ranges the per-day and per-month calls answer
+const int64_t kMaxDays = 366 * 10;
+
+// Returns args[key] if it is there and has the right type.
+FlValue* Arg(FlValue* args, const char* key, FlValueType type) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value : nullptr;
+}
+
+int64_t DateArg(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = Arg(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+// The day after |today|. Rows dated later are left out of the sums, as
+// FinanceProvider drops future transactions when it loads them.
+int64_t EndDay(FlValue* args) {
+  FlValue* today = Arg(args, "today", FL_VALUE_TYPE_INT);
+  return today != nullptr ? LedgerDay(fl_value_get_int(today)) + 1
+                          : std::numeric_limits<int64_t>::max();
+}
+
+FlValue* FloatList(const std::vector<double>& values) {
+  return fl_value_new_float_list(values.data(), values.size());
+}
+
+FlMethodResponse* Success(FlValue* result) {
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* Error(const std::string& message) {
+  return FL_METHOD_RESPONSE(
+      fl_method_error_response_new("ledger", message.c_str(), nullptr));
+}
+
+FlMethodResponse* Count(const Ledger& ledger) {
+  g_autoptr(FlValue) result = fl_value_new_int(ledger.size());
+  return Success(result);
+}
+
+FlMethodResponse* Insert(Ledger* ledger, FlValue* args) {
+  FlValue* date = Arg(args, "date", FL_VALUE_TYPE_INT);
+  FlValue* amount = Arg(args, "amount", FL_VALUE_TYPE_FLOAT);
+  FlValue* is_income = Arg(args, "isIncome", FL_VALUE_TYPE_BOOL);
+  FlValue* category = Arg(args, "category", FL_VALUE_TYPE_STRING);
+  if (date == nullptr || amount == nullptr || is_income == nullptr ||
+      category == nullptr) {
+    return Error("insert needs date, amount, isIncome and category");
+  }
+  std::string error;
+  if (!ledger->Insert(fl_value_get_int(date), fl_value_get_float(amount),
+                      fl_value_get_bool(is_income),
+                      fl_value_get_string(category), &error)) {
+    return Error(error);
+  }
+  return Count(*ledger);
+}
+
+FlMethodResponse* Replace(Ledger* ledger, FlValue* args) {
+  FlValue* dates = Arg(args, "dates", FL_VALUE_TYPE_INT64_LIST);
+  FlValue* amounts = Arg(args, "amounts", FL_VALUE_TYPE_FLOAT_LIST);
+  FlValue* income = Arg(args, "income", FL_VALUE_TYPE_UINT8_LIST);
+  FlValue* categories = Arg(args, "categories", FL_VALUE_TYPE_INT32_LIST);
+  FlValue* names = Arg(args, "categoryNames", FL_VALUE_TYPE_LIST);
+  if (dates == nullptr || amounts == nullptr || income == nullptr ||
+      categories == nullptr || names == nullptr) {
+    return Error(
+        "replace needs dates, amounts, income, categories and categoryNames");
+  }
+  size_t count = fl_value_get_length(dates);
+  if (fl_value_get_length(amounts) != count ||
+      fl_value_get_length(income) != count ||
+      fl_value_get_length(categories) != count) {
+    return Error("replace needs columns of the same length");
+  }
+
+  std::vector<std::string> category_names;
+  for (size_t i = 0; i < fl_value_get_length(names); i++) {
+    FlValue* name = fl_value_get_list_value(names, i);
+    if (fl_value_get_type(name) != FL_VALUE_TYPE_STRING) {
+      return Error("categoryNames must be strings");
+    }
+    category_names.push_back(fl_value_get_string(name));
+  }
+
+  const int64_t* date_values = fl_value_get_int64_list(dates);
+  const double* amount_values = fl_value_get_float_list(amounts);
+  const uint8_t* income_values = fl_value_get_uint8_list(income);
+  const int32_t* category_values = fl_value_get_int32_list(categories);
+  std::vector<LedgerRow> rows(count);
+  for (size_t i = 0; i < count; i++) {
+    if (category_values[i] < 0) return Error("Unknown category");
+    rows[i] = LedgerRow{date_values[i], amount_values[i],
+                        income_values[i] != 0,
+                        static_cast<uint32_t>(category_values[i])};
+  }
+
+  std::string error;
+  if (!ledger->Replace(rows, category_names, &error)) return Error(error);
+  return Count(*ledger);
+}
+
+FlMethodResponse* Read(const Ledger& ledger, FlValue* args) {
+  LedgerColumns columns;
+  ledger.Read(DateArg(args, "from", std::numeric_limits<int64_t>::min()),
+              DateArg(args, "to", std::numeric_limits<int64_t>::max()),
+              &columns);
+
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "dates",
+      fl_value_new_int64_list(columns.dates.data(), columns.dates.size()));
+  fl_value_set_string_take(
+      result, "amounts",
+      fl_value_new_float_list(columns.amounts.data(), columns.amounts.size()));
+  fl_value_set_string_take(
+      result, "income",
+      fl_value_new_uint8_list(columns.income.data(), columns.income.size()));
+  fl_value_set_string_take(result, "categories",
+                           fl_value_new_int32_list(columns.categories.data(),
+                                                   columns.categories.size()));
+  FlValue* names = fl_value_new_list();
+  for (const std::string& name : ledger.categories()) {
+    fl_value_append_take(names, fl_value_new_string(name.c_str()));
+  }
+  fl_value_set_string_take(result, "categoryNames", names);
+  return Success(result);
+}
+
+// [balance, savings, spentThisMonth] as the home screen shows them: savings
+// is everything before the current billing month, spending is what went out
+// since it started.
+FlMethodResponse* Summary(const Ledger& ledger, FlValue* args) {
+  FlValue* start_day = Arg(args, "startDayOfMonth", FL_VALUE_TYPE_INT);
+  if (start_day == nullptr || Arg(args, "today", FL_VALUE_TYPE_INT) == nullptr) {
+    return Error("summary needs today and startDayOfMonth");
+  }
+  int64_t end = EndDay(args);
+  int64_t year;
+  int month, day;
+  CivilFromDays(end - 1, &year, &month, &day);
+  int64_t period = PeriodStart(year, month, fl_value_get_int(start_day));
+
+  const DailyTotals& daily = ledger.daily();
+  const int64_t kBeginning = std::numeric_limits<int64_t>::min();
+  Totals all = daily.Range(kBeginning, end);
+  Totals before = daily.Range(kBeginning, std::min(period, end));
+  Totals since = daily.Range(period, end);
+  g_autoptr(FlValue) result = FloatList({all.income - all.expense,
+                                         before.income - before.expense,
+                                         since.expense});
+  return Success(result);
+}
+
+// [income, expense] of the days from |from| up to but not including |to|.
+FlMethodResponse* RangeTotals(const Ledger& ledger, FlValue* args) {
+  FlValue* from = Arg(args, "from", FL_VALUE_TYPE_INT);
+  FlValue* to = Arg(args, "to", FL_VALUE_TYPE_INT);
+  if (from == nullptr || to == nullptr) return Error("totals needs from and to");
+  Totals totals =
+      ledger.daily().Range(LedgerDay(fl_value_get_int(from)),
+                           std::min(LedgerDay(fl_value_get_int(to)), EndDay(args)));
+  g_autoptr(FlValue) result = FloatList({totals.income, totals.expense});
+  return Success(result);
+}
+
+// Income and expense of each day from |from| up to but not including |to|.
+FlMethodResponse* Daily(const Ledger& ledger, FlValue* args) {
+  FlValue* from = Arg(args, "from", FL_VALUE_TYPE_INT);
+  FlValue* to = Arg(args, "to", FL_VALUE_TYPE_INT);
+  if (from == nullptr || to == nullptr) return Error("daily needs from and to");
+  int64_t first = LedgerDay(fl_value_get_int(from));
+  int64_t end = LedgerDay(fl_value_get_int(to));
+  if (end < first || end - first > kMaxDays) return Error("Bad day range");
+
+  std::vector<double> values;
+  values.reserve(2 * (end - first));
+  ledger.daily().Days(first, std::min(end, std::max(first, EndDay(args))),
+                      &values);
+  values.resize(2 * (end - first), 0);
+  g_autoptr(FlValue) result = FloatList(values);
+  return Success(result);
+}
+
+// Writes every ledger named in |users| and the |preferences| map to a backup
+// at |path|.
+FlMethodResponse* ExportBackup(LedgerStore* store, FlValue* args) {
+  FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+  FlValue* preferences = Arg(args, "preferences", FL_VALUE_TYPE_MAP);
+  FlValue* users = Arg(args, "users", FL_VALUE_TYPE_LIST);
+  if (path == nullptr || preferences == nullptr || users == nullptr) {
+    return Error("exportBackup needs path, preferences and users");
+  }
+
+  std::string error;
+  BackupWriter writer;
+  if (!writer.Open(fl_value_get_string(path), &error)) return Error(error);
+  for (size_t i = 0; i < fl_value_get_length(preferences); i++) {
+    FlValue* key = fl_value_get_map_key(preferences, i);
+    FlValue* value = fl_value_get_map_value(preferences, i);
+    if (fl_value_get_type(key) != FL_VALUE_TYPE_STRING) {
+      return Error("Preference keys must be strings");
+    }
+    BackupPreference preference;
+    preference.key = fl_value_get_string(key);
+    switch (fl_value_get_type(value)) {
+      case FL_VALUE_TYPE_STRING:
+        preference.type = BackupPreference::kString;
+        preference.string_value = fl_value_get_string(value);
+        break;
+      case FL_VALUE_TYPE_INT:
+        preference.type = BackupPreference::kInt;
+        preference.int_value = fl_value_get_int(value);
+        break;
+      case FL_VALUE_TYPE_BOOL:
+        preference.type = BackupPreference::kBool;
+        preference.bool_value = fl_value_get_bool(value);
+        break;
+      case FL_VALUE_TYPE_FLOAT:
+        preference.type = BackupPreference::kDouble;
+        preference.double_value = fl_value_get_float(value);
+        break;
+      case FL_VALUE_TYPE_LIST:
+        preference.type = BackupPreference::kStringList;
+        for (size_t j = 0; j < fl_value_get_length(value); j++) {
+          FlValue* item = fl_value_get_list_value(value, j);
+          if (fl_value_get_type(item) != FL_VALUE_TYPE_STRING) {
+            return Error("Preference lists must hold strings");
+          }
+          preference.string_list.push_back(fl_value_get_string(item));
+        }
+        break;
+      default:
+        continue;  // SharedPreferences has no other types
+    }
+    if (!writer.AddPreference(preference, &error)) return Error(error);
+  }
+  for (size_t i = 0; i < fl_value_get_length(users); i++) {
+    FlValue* user = fl_value_get_list_value(users, i);
+    if (fl_value_get_type(user) != FL_VALUE_TYPE_STRING) {
+      return Error("users must be strings");
+    }
+    Ledger* ledger = store->Get(fl_value_get_string(user), &error);
+    if (ledger == nullptr ||
+        !writer.AddLedger(fl_value_get_string(user), *ledger, &error)) {
+      return Error(error);
+    }
+  }
+  if (!writer.Finish(&error)) return Error(error);
+  return Success(nullptr);
+}
+
+// Replaces every ledger with those in the backup at |path| and returns its
+// preferences as a map. They stay pending until finishImport.
+FlMethodResponse* ImportBackup(LedgerStore* store, FlValue* args) {
+  FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+  if (path == nullptr) return Error("importBackup needs a path");
+
+  std::string error;
+  std::vector<BackupPreference> preferences;
+  if (!RestoreBackup(fl_value_get_string(path), store, &preferences,
+                     &error)) {
+    return Error(error);
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  for (const BackupPreference& preference : preferences) {
+    FlValue* value = nullptr;
+    switch (preference.type) {
+      case BackupPreference::kString:
+        value = fl_value_new_string(preference.string_value.c_str());
+        break;
+      case BackupPreference::kInt:
+        value = fl_value_new_int(preference.int_value);
+        break;
+      case BackupPreference::kBool:
+        value = fl_value_new_bool(preference.bool_value);
+        break;
+      case BackupPreference::kDouble:
+        value = fl_value_new_float(preference.double_value);
+        break;
+      case BackupPreference::kStringList:
+        value = fl_value_new_list();
+        for (const std::string& item : preference.string_list) {
+          fl_value_append_take(value, fl_value_new_string(item.c_str()));
+        }
+        break;
+    }
+    fl_value_set_string_take(result, preference.key.c_str(), value);
+  }
+  return Success(result);
+}
+
+// Writes the statement PDF of the days |from| through |to| to |path|, with
+// text in the bundled font asset |font|. Returns the number of pages.
+FlMethodResponse* Statement(const Ledger& ledger, const std::string& assets,
+                            FlValue* args) {
+  FlValue* from = Arg(args, "from", FL_VALUE_TYPE_INT);
+  FlValue* to = Arg(args, "to", FL_VALUE_TYPE_INT);
+  FlValue* title = Arg(args, "title", FL_VALUE_TYPE_STRING);
+  FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+  FlValue* font = Arg(args, "font", FL_VALUE_TYPE_STRING);
+  if (from == nullptr || to == nullptr || title == nullptr ||
+      path == nullptr || font == nullptr) {
+    return Error("statement needs from, to, title, path and font");
+  }
+  int pages;
+  std::string error;
+  if (!WriteStatement(ledger, LedgerDay(fl_value_get_int(from)),
+                      LedgerDay(fl_value_get_int(to)),
+                      fl_value_get_string(title),
+                      assets + "/" + fl_value_get_string(font),
+                      fl_value_get_string(path), &pages, &error)) {
+    return Error(error);
+  }
+  g_autoptr(FlValue) result = fl_value_new_int(pages);
+  return Success(result);
+}
+
+FlMethodResponse* Respond(ChannelData* data, const std::string& method,
+                          FlValue* args) {
+  LedgerStore* store = &data->store;
+  if (method == "exportBackup") return ExportBackup(store, args);
+  if (method == "importBackup") return ImportBackup(store, args);
+  if (method == "finishImport") {
+    DiscardPendingPreferences(store->directory());
+    return Success(nullptr);
+  }
+
+  FlValue* user = Arg(args, "user", FL_VALUE_TYPE_STRING);
+  if (user == nullptr) return Error(method + " needs a user");
+
+  std::string error;
+  if (method == "remove") {
+    if (!store->Remove(fl_value_get_string(user), &error)) return Error(error);
+    return Success(nullptr);
+  }
+
+  Ledger* ledger = store->Get(fl_value_get_string(user), &error);
+  if (ledger == nullptr) return Error(error);
+  if (method == "insert") return Insert(ledger, args);
+  if (method == "replace") return Replace(ledger, args);
+  if (method == "read") return Read(*ledger, args);
+  if (method == "summary") return Summary(*ledger, args);
+  if (method == "totals") return RangeTotals(*ledger, args);
+  if (method == "daily") return Daily(*ledger, args);
+  if (method == "statement") {
+    return Statement(*ledger, data->assets_directory, args);
+  }
+  return FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+}
+
+void HandleMethodCall(FlMethodChannel* channel, FlMethodCall* method_call,
+                      gpointer user_data) {
+  ChannelData* data = static_cast<ChannelData*>(user_data);
+  g_autoptr(FlMethodResponse) response =
+      Respond(data, fl_method_call_get_name(method_call),
+              fl_method_call_get_args(method_call));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send ledger response: %s", error->message);
+  }
+}
+
+void DeleteData(gpointer user_data) {
+  delete static_cast<ChannelData*>(user_data);
+}
+
+}  // namespace
+
+FlMethodChannel* ledger_channel_new(FlBinaryMessenger* messenger,
+                                    const gchar* directory,
+                                    const gchar* assets_directory,
+                                    const gchar* preload_user) {
+  ChannelData* data = new ChannelData(directory, assets_directory);
+  if (preload_user != nullptr) data->store.Preload(preload_user);
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  FlMethodChannel* channel =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, HandleMethodCall, data,
+                                            DeleteData);
+  return channel;
+}
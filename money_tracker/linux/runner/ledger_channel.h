@@ -0,0 +1,57 @@
+#ifndef RUNNER_LEDGER_CHANNEL_H_
+#define RUNNER_LEDGER_CHANNEL_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+/**
+ * ledger_channel_new:
+ * @messenger: the engine's binary messenger.
+ * @directory: where the ledger files are kept.
+ * @assets_directory: the Flutter assets, for the fonts statements are set in.
+ * @preload_user: (nullable): a user whose ledger is opened in the background
+ *   right away, as the first calls are likely to be about them.
+ *
+ * Serves the "money_tracker/ledger" method channel from the native ledger
+ * (see ledger.h). Every call names the user whose ledger it works on:
+ *
+ *   insert  {user, date, amount, isIncome, category}   -> new count
+ *   replace {user, dates, amounts, income, categories, categoryNames}
+ *                                           -> new count
+ *   read    {user, from?, to?}              -> {dates, amounts, income,
+ *                                               categories, categoryNames}
+ *   remove  {user}                          -> null, deletes the ledger
+ *
+ * and the sums the dashboards show, all as Float64Lists:
+ *
+ *   summary    {user, today, startDayOfMonth}
+ *                                  -> [balance, savings, spentThisMonth]
+ *   totals     {user, from, to, today?}     -> [income, expense]
+ *   daily      {user, from, to, today?}     -> [income, expense] per day
+ *
+ * a statement PDF, streamed straight from the ledger (see statement.h):
+ *
+ *   statement  {user, from, to, title, path, font}
+ *                                  -> number of pages written to path
+ *
+ * and backups of every user at once (see backup.h):
+ *
+ *   exportBackup {path, preferences, users} -> null, writes the preferences
+ *                                              map and the users' ledgers
+ *   importBackup {path}                     -> the backup's preferences, after
+ *                                              its ledgers replaced them all
+ *   finishImport {}                         -> null, once those preferences
+ *                                              are applied
+ *
+ * Dates are local wall-clock microseconds, counted as if they were UTC; the
+ * sums take whole days and leave out rows dated after |today|. The column
+ * arguments and results are typed lists, and categories index
+ * categoryNames.
+ *
+ * Returns: the channel; it stays registered until it is unreffed.
+ */
+FlMethodChannel* ledger_channel_new(FlBinaryMessenger* messenger,
+                                    const gchar* directory,
+                                    const gchar* assets_directory,
+                                    const gchar* preload_user);
+
+#endif  // RUNNER_LEDGER_CHANNEL_H_
@@ -0,0 +1,151 @@
+#include "ledger_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Dates outside 1900-2199 are counted on the nearest day inside, so a stray
+// date can't blow up the per-day arrays.
+const int64_t kFirstDay = -25567;  // 1900-01-01
+const int64_t kLastDay = 84005;    // 2199-12-31
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  return a % b < 0 ? q - 1 : q;
+}
+
+}  // namespace
+
+// Civil calendar conversions after Howard Hinnant's days_from_civil and
+// civil_from_days, proleptic Gregorian.
+int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day) {
+  year += FloorDiv(month - 1, 12);
+  int64_t m = month - 1 - FloorDiv(month - 1, 12) * 12 + 1;
+  int64_t y = m <= 2 ? year - 1 : year;
+  int64_t era = FloorDiv(y, 400);
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468 + day - 1;
+}
+
+void CivilFromDays(int64_t days, int64_t* year, int* month, int* day) {
+  int64_t z = days + 719468;
+  int64_t era = FloorDiv(z, 146097);
+  int64_t doe = z - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int64_t mp = (5 * doy + 2) / 153;
+  *day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+  *month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+  *year = yoe + era * 400 + (*month <= 2 ? 1 : 0);
+}
+
+Totals SumAmounts(const double* amounts, const uint8_t* income, size_t count) {
+  Totals totals;
+  size_t i = 0;
+#if defined(__SSE2__)
+  // Four rows per round: the income flags become all-ones lane masks that
+  // pick each amount into one of two pairs of accumulators.
+  const __m128i zero = _mm_setzero_si128();
+  __m128d income_low = _mm_setzero_pd(), income_high = _mm_setzero_pd();
+  __m128d expense_low = _mm_setzero_pd(), expense_high = _mm_setzero_pd();
+  for (; i + 4 <= count; i += 4) {
+    int32_t flags;
+    memcpy(&flags, income + i, sizeof(flags));
+    __m128i is_expense = _mm_cmpeq_epi8(_mm_cvtsi32_si128(flags), zero);
+    is_expense = _mm_unpacklo_epi8(is_expense, is_expense);
+    is_expense = _mm_unpacklo_epi16(is_expense, is_expense);
+    __m128d low = _mm_castsi128_pd(_mm_unpacklo_epi32(is_expense, is_expense));
+    __m128d high = _mm_castsi128_pd(_mm_unpackhi_epi32(is_expense, is_expense));
+    __m128d a = _mm_loadu_pd(amounts + i);
+    __m128d b = _mm_loadu_pd(amounts + i + 2);
+    expense_low = _mm_add_pd(expense_low, _mm_and_pd(low, a));
+    income_low = _mm_add_pd(income_low, _mm_andnot_pd(low, a));
+    expense_high = _mm_add_pd(expense_high, _mm_and_pd(high, b));
+    income_high = _mm_add_pd(income_high, _mm_andnot_pd(high, b));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(income_low, income_high));
+  totals.income = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, _mm_add_pd(expense_low, expense_high));
+  totals.expense = lanes[0] + lanes[1];
+#endif
+  for (; i < count; i++) {
+    if (income[i]) {
+      totals.income += amounts[i];
+    } else {
+      totals.expense += amounts[i];
+    }
+  }
+  return totals;
+}
+
+void DailyTotals::Clear() {
+  first_day_ = 0;
+  income_.clear();
+  expense_.clear();
+  running_income_.assign(1, 0);
+  running_expense_.assign(1, 0);
+  valid_ = 1;
+}
+
+void DailyTotals::Add(int64_t day, const double* amounts, const uint8_t* income,
+                      size_t count) {
+  day = std::min(std::max(day, kFirstDay), kLastDay);
+  if (income_.empty()) first_day_ = day;
+  if (day < first_day_) {
+    size_t grow = first_day_ - day;
+    income_.insert(income_.begin(), grow, 0);
+    expense_.insert(expense_.begin(), grow, 0);
+    first_day_ = day;
+    valid_ = 1;
+  } else if (day >= end_day()) {
+    income_.resize(day - first_day_ + 1);
+    expense_.resize(day - first_day_ + 1);
+  }
+
+  size_t index = day - first_day_;
+  Totals totals = SumAmounts(amounts, income, count);
+  income_[index] += totals.income;
+  expense_[index] += totals.expense;
+  valid_ = std::min(valid_, index + 1);
+}
+
+void DailyTotals::UpdateRunningSums() const {
+  size_t size = income_.size() + 1;
+  if (valid_ == size) return;
+  running_income_.resize(size);
+  running_expense_.resize(size);
+  for (size_t i = valid_; i < size; i++) {
+    running_income_[i] = running_income_[i - 1] + income_[i - 1];
+    running_expense_[i] = running_expense_[i - 1] + expense_[i - 1];
+  }
+  valid_ = size;
+}
+
+Totals DailyTotals::Range(int64_t first_day, int64_t end_day) const {
+  Totals totals;
+  first_day = std::max(first_day, first_day_);
+  end_day = std::min(end_day, this->end_day());
+  if (first_day >= end_day) return totals;
+  UpdateRunningSums();
+  size_t first = first_day - first_day_, end = end_day - first_day_;
+  totals.income = running_income_[end] - running_income_[first];
+  totals.expense = running_expense_[end] - running_expense_[first];
+  return totals;
+}
+
+void DailyTotals::Days(int64_t first_day, int64_t end_day,
+                       std::vector<double>* out) const {
+  for (int64_t day = first_day; day < end_day; day++) {
+    bool inside = day >= first_day_ && day < this->end_day();
+    out->push_back(inside ? income_[day - first_day_] : 0);
+    out->push_back(inside ? expense_[day - first_day_] : 0);
+  }
+}
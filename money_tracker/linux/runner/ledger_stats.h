@@ -0,0 +1,74 @@
+#ifndef RUNNER_LEDGER_STATS_H_
+#define RUNNER_LEDGER_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ledger dates are local wall-clock microseconds counted as if they were UTC
+// (see ledger.h), so days and months can be worked out without time zones.
+const int64_t kMicrosPerDay = 86400LL * 1000000;
+
+// Days since 1970-01-01 of a ledger date.
+inline int64_t LedgerDay(int64_t date_us) {
+  int64_t day = date_us / kMicrosPerDay;
+  return date_us % kMicrosPerDay < 0 ? day - 1 : day;
+}
+
+// Days since 1970-01-01 of a calendar date; month and day may run over like
+// they do in Dart's DateTime(year, month, day).
+int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day);
+void CivilFromDays(int64_t days, int64_t* year, int* month, int* day);
+
+// First day of the billing month named (year, month) when months start on
+// |start_day|, like DateTime(year, month, startDayOfMonth) in the app.
+inline int64_t PeriodStart(int64_t year, int64_t month, int start_day) {
+  return DaysFromCivil(year, month, start_day);
+}
+
+struct Totals {
+  double income = 0;
+  double expense = 0;
+};
+
+// Sums of the amounts flagged as income and of the rest. Vectorized.
+Totals SumAmounts(const double* amounts, const uint8_t* income, size_t count);
+
+// Income and expense of every day a ledger covers, with running sums over
+// them, so the totals of any range of days take O(1).
+//
+// An added row only invalidates the running sums from its day on, and they
+// are brought up to date on the next query. Rows are nearly always added on
+// the latest day, so that costs O(1) too.
+class DailyTotals {
+ public:
+  void Clear();
+
+  // |count| rows all dated |day|.
+  void Add(int64_t day, const double* amounts, const uint8_t* income,
+           size_t count);
+
+  // Totals of the days in [first_day, end_day).
+  Totals Range(int64_t first_day, int64_t end_day) const;
+
+  // The totals of each day in [first_day, end_day), income then expense.
+  void Days(int64_t first_day, int64_t end_day,
+            std::vector<double>* out) const;
+
+  bool empty() const { return income_.empty(); }
+  int64_t first_day() const { return first_day_; }
+  int64_t end_day() const { return first_day_ + income_.size(); }
+
+ private:
+  void UpdateRunningSums() const;
+
+  int64_t first_day_ = 0;
+  std::vector<double> income_;
+  std::vector<double> expense_;
+  // running_income_[i] is the income of the days before first_day_ + i
+  mutable std::vector<double> running_income_{0};
+  mutable std::vector<double> running_expense_{0};
+  mutable size_t valid_ = 1;  // Leading running sums that are up to date
+};
+
+#endif  // RUNNER_LEDGER_STATS_H_
@@ -5,18 +5,81 @@
 #include <gdk/gdkx.h>
 #endif
 
+#include <string>
+
 #include "flutter/generated_plugin_registrant.h"
+#include "ledger.h"
+#include "ledger_channel.h"
+#include "preferences.h"
+#include "startup_trace.h"
+
+// Set to a file name to have the startup trace written there once the Dart
+// side has loaded its data.
+static const char kTraceVariable[] = "MONEY_TRACKER_TRACE";
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  FlMethodChannel* ledger_channel;
+  FlMethodChannel* startup_channel;
+  // When the engine was started, in StartupTrace time
+  int64_t engine_start_us;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
 
+// The window is shown once Flutter has drawn into it, not blank before.
+static void first_frame_cb(MyApplication* self, FlView* view) {
+  StartupTrace* trace = StartupTrace::Get();
+  trace->Add("First frame", self->engine_start_us, trace->Now());
+  gtk_widget_show(gtk_widget_get_toplevel(GTK_WIDGET(view)));
+}
+
+// Handles "loaded" on the "money_tracker/startup" channel, which
+// FinanceProvider calls once with how long it took to load its data. That is
+// when the app becomes usable, so the trace ends there.
+static void startup_method_cb(FlMethodChannel* channel,
+                              FlMethodCall* method_call, gpointer user_data) {
+  g_autoptr(FlMethodResponse) response = nullptr;
+  FlValue* args = fl_method_call_get_args(method_call);
+  FlValue* micros = args != nullptr &&
+                            fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                        ? fl_value_lookup_string(args, "micros")
+                        : nullptr;
+  if (g_strcmp0(fl_method_call_get_name(method_call), "loaded") != 0) {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  } else if (micros == nullptr ||
+             fl_value_get_type(micros) != FL_VALUE_TYPE_INT) {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "startup", "loaded needs micros", nullptr));
+  } else {
+    StartupTrace* trace = StartupTrace::Get();
+    int64_t now = trace->Now();
+    trace->Add("Data load", now - fl_value_get_int(micros), now);
+    trace->Add("Time to interactive", 0, now);
+    const gchar* path = g_getenv(kTraceVariable);
+    std::string error;
+    if (path != nullptr && *path != '\0') {
+      if (trace->Write(path, &error)) {
+        g_message("Interactive after %.1f ms; startup trace written to %s",
+                  now / 1000.0, path);
+      } else {
+        g_warning("%s", error.c_str());
+      }
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send startup response: %s", error->message);
+  }
+}
+
 // Implements GApplication::activate.
 static void my_application_activate(GApplication* application) {
   MyApplication* self = MY_APPLICATION(application);
+  StartupTrace* trace = StartupTrace::Get();
+  int64_t window_start_us = trace->Now();
   GtkWindow* window =
       GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(application)));
 
@@ -48,16 +111,56 @@ static void my_application_activate(GApplication* application) {
   }
 
   gtk_window_set_default_size(window, 1280, 720);
-  gtk_widget_show(GTK_WIDGET(window));
+  trace->Add("Window", window_start_us, trace->Now());
 
+  self->engine_start_us = trace->Now();
   g_autoptr(FlDartProject) project = fl_dart_project_new();
   fl_dart_project_set_dart_entrypoint_arguments(project, self->dart_entrypoint_arguments);
 
   FlView* view = fl_view_new(project);
+  FlBinaryMessenger* messenger =
+      fl_engine_get_binary_messenger(fl_view_get_engine(view));
+
+  // The transactions are kept by the native ledger; see ledger_channel.h. The
+  // current user's ledger is read on another thread while the engine and
+  // the Dart side start up, so it is ready by the time they ask for it.
+  g_autofree gchar* data_directory =
+      g_build_filename(g_get_user_data_dir(), APPLICATION_ID, nullptr);
+  g_autofree gchar* ledger_directory =
+      g_build_filename(data_directory, "ledgers", nullptr);
+  g_autofree gchar* preferences_path =
+      g_build_filename(data_directory, "shared_preferences.json", nullptr);
+  // A restore the app stopped in the middle of is finished or undone first
+  LedgerStore::RecoverStaged(ledger_directory);
+  InstallPendingPreferences(ledger_directory, preferences_path);
+  std::string current_user;
+  if (!ReadStringPreference(preferences_path, "current_user", &current_user)) {
+    current_user = "Default User";  // FinanceProvider's first user
+  }
+  g_clear_object(&self->ledger_channel);
+  self->ledger_channel =
+      ledger_channel_new(messenger, ledger_directory,
+                         fl_dart_project_get_assets_path(project),
+                         current_user.c_str());
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_clear_object(&self->startup_channel);
+  self->startup_channel = fl_method_channel_new(
+      messenger, "money_tracker/startup", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(
+      self->startup_channel, startup_method_cb, nullptr, nullptr);
+
   gtk_widget_show(GTK_WIDGET(view));
   gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(view));
 
+  // Show the window when Flutter renders.
+  // Requires the view to be realized so we can start rendering.
+  g_signal_connect_swapped(view, "first-frame", G_CALLBACK(first_frame_cb),
+                           self);
+  gtk_widget_realize(GTK_WIDGET(view));
+
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
+  trace->Add("Engine", self->engine_start_us, trace->Now());
 
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
@@ -87,6 +190,8 @@ static void my_application_startup(GApplication* application) {
 
   // Perform any actions required at application startup.
 
+  // GtkApplication initializes GTK and connects to the display here
+  ScopedStartupSpan span("GTK init");
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
 }
 
@@ -103,6 +208,8 @@ static void my_application_shutdown(GApplication* application) {
 static void my_application_dispose(GObject* object) {
   MyApplication* self = MY_APPLICATION(object);
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  g_clear_object(&self->ledger_channel);
+  g_clear_object(&self->startup_channel);
   G_OBJECT_CLASS(my_application_parent_class)->dispose(object);
 }
 
@@ -0,0 +1,439 @@
+#include "pdf_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Objects whose ids are fixed before the pages are written
+const uint32_t kCatalog = 1;
+const uint32_t kPageTree = 2;
+const uint32_t kFont = 3;
+
+const char kHeader[] = "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n";
+
+// Control points of a quarter circle drawn as a Bezier curve
+const double kKappa = 0.5523;
+
+std::string ErrnoMessage(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+// Content coordinates, to a hundredth of a point. Done by hand rather than
+// with FormatFixed() as every drawing operation writes several.
+std::string Number(double value) {
+  long long hundredths = llround(value * 100);
+  std::string text = hundredths < 0 ? "-" : "";
+  unsigned long long magnitude = std::llabs(hundredths);
+  text += std::to_string(magnitude / 100);
+  if (magnitude % 100 != 0) {
+    text += '.';
+    text += static_cast<char>('0' + magnitude % 100 / 10);
+    if (magnitude % 10 != 0) text += static_cast<char>('0' + magnitude % 10);
+  }
+  return text;
+}
+
+std::string Hex16(uint32_t value) {
+  char hex[5];
+  snprintf(hex, sizeof(hex), "%04X", value & 0xffff);
+  return hex;
+}
+
+// UTF-16BE hex digits of a code point
+std::string Utf16Hex(uint32_t code_point) {
+  if (code_point < 0x10000) return Hex16(code_point);
+  code_point -= 0x10000;
+  return Hex16(0xd800 + (code_point >> 10)) +
+         Hex16(0xdc00 + (code_point & 0x3ff));
+}
+
+// Decodes the UTF-8 sequence at text[*i] and moves past it. Anything
+// malformed comes out as U+FFFD.
+uint32_t NextCodePoint(const std::string& text, size_t* i) {
+  unsigned char c = text[*i];
+  if (c < 0x80) {
+    ++*i;
+    return c;
+  }
+  size_t length = c >> 5 == 6 ? 2 : c >> 4 == 14 ? 3 : c >> 3 == 30 ? 4 : 0;
+  uint32_t code_point = c & (0x7f >> length);
+  bool valid = length != 0 && *i + length <= text.size();
+  for (size_t j = 1; valid && j < length; j++) {
+    unsigned char next = text[*i + j];
+    valid = next >> 6 == 2;
+    code_point = code_point << 6 | (next & 0x3f);
+  }
+  if (!valid || code_point > 0x10ffff) {
+    ++*i;
+    return 0xfffd;
+  }
+  *i += length;
+  return code_point;
+}
+
+std::string TextString(const std::string& text) {
+  std::string hex = "<FEFF";
+  for (size_t i = 0; i < text.size();) {
+    hex += Utf16Hex(NextCodePoint(text, &i));
+  }
+  return hex + ">";
+}
+
+}  // namespace
+
+std::string FormatFixed(double value, int decimals) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", decimals, value);
+  // GTK sets the locale from the environment, which may use a comma
+  const char* point = localeconv()->decimal_point;
+  std::string result = text;
+  if (point != nullptr && strcmp(point, ".") != 0) {
+    size_t at = result.find(point);
+    if (at != std::string::npos) result.replace(at, strlen(point), ".");
+  }
+  return result;
+}
+
+PdfWriter::~PdfWriter() {
+  if (fd_ < 0) return;
+  close(fd_);
+  unlink(temp_.c_str());
+}
+
+bool PdfWriter::Open(const std::string& path, std::string* error) {
+  path_ = path;
+  temp_ = path + ".tmp";
+  fd_ = open(temp_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    *error = ErrnoMessage("Cannot create", temp_);
+    return false;
+  }
+  offsets_.assign(kFont, 0);
+  glyph_used_.assign(font_->glyph_count(), false);
+  glyph_text_.assign(font_->glyph_count(), 0);
+  return Write(std::string(kHeader, sizeof(kHeader) - 1), error);
+}
+
+bool PdfWriter::Write(const std::string& data, std::string* error) {
+  const char* p = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    ssize_t n = write(fd_, p, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      *error = ErrnoMessage("Cannot write", temp_);
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  offset_ += data.size();
+  return true;
+}
+
+uint32_t PdfWriter::NewObject() {
+  offsets_.push_back(0);
+  return static_cast<uint32_t>(offsets_.size());
+}
+
+bool PdfWriter::WriteObject(uint32_t id, const std::string& body,
+                            std::string* error) {
+  offsets_[id - 1] = offset_;
+  return Write(std::to_string(id) + " 0 obj\n" + body + "\nendobj\n", error);
+}
+
+bool PdfWriter::WriteStream(uint32_t id, const std::string& dictionary,
+                            const std::string& data, std::string* error) {
+  std::string deflated(compressBound(data.size()), '\0');
+  uLongf length = deflated.size();
+  if (compress2(reinterpret_cast<Bytef*>(&deflated[0]), &length,
+                reinterpret_cast<const Bytef*>(data.data()), data.size(),
+                Z_DEFAULT_COMPRESSION) != Z_OK) {
+    *error = "Cannot compress a PDF stream";
+    return false;
+  }
+  deflated.resize(length);
+  return WriteObject(id,
+                     "<< /Length " + std::to_string(length) +
+                         " /Filter /FlateDecode " + dictionary +
+                         " >>\nstream\n" + deflated + "\nendstream",
+                     error);
+}
+
+void PdfWriter::StartPage(double width, double height) {
+  width_ = width;
+  height_ = height;
+  content_.clear();
+}
+
+bool PdfWriter::EndPage(std::string* error) {
+  uint32_t content = NewObject();
+  uint32_t page = NewObject();
+  pages_.push_back(page);
+  if (!WriteStream(content, "", content_, error)) return false;
+  content_.clear();
+  return WriteObject(
+      page,
+      "<< /Type /Page /Parent " + std::to_string(kPageTree) +
+          " 0 R /MediaBox [0 0 " + Number(width_) + " " + Number(height_) +
+          "] /Resources << /Font << /F1 " + std::to_string(kFont) +
+          " 0 R >> >> /Contents " + std::to_string(content) + " 0 R >>",
+      error);
+}
+
+void PdfWriter::SetColor(uint32_t color, bool stroke) {
+  content_ += Number(((color >> 16) & 0xff) / 255.0) + " " +
+              Number(((color >> 8) & 0xff) / 255.0) + " " +
+              Number((color & 0xff) / 255.0) + (stroke ? " RG\n" : " rg\n");
+}
+
+void PdfWriter::FillRect(double x, double y, double width, double height,
+                         uint32_t color) {
+  SetColor(color, false);
+  content_ += Number(x) + " " + Number(height_ - y - height) + " " +
+              Number(width) + " " + Number(height) + " re f\n";
+}
+
+void PdfWriter::FillRoundRect(double x, double y, double width, double height,
+                              double radius, uint32_t fill, uint32_t stroke,
+                              double line_width) {
+  double left = x, right = x + width;
+  double top = height_ - y, bottom = height_ - y - height;
+  double r = radius, k = radius * kKappa;
+  auto point = [](double px, double py) {
+    return Number(px) + " " + Number(py) + " ";
+  };
+  SetColor(fill, false);
+  SetColor(stroke, true);
+  content_ += Number(line_width) + " w\n";
+  content_ += point(left + r, bottom) + "m\n";
+  content_ += point(right - r, bottom) + "l\n";
+  content_ += point(right - r + k, bottom) + point(right, bottom + r - k) +
+              point(right, bottom + r) + "c\n";
+  content_ += point(right, top - r) + "l\n";
+  content_ += point(right, top - r + k) + point(right - r + k, top) +
+              point(right - r, top) + "c\n";
+  content_ += point(left + r, top) + "l\n";
+  content_ += point(left + r - k, top) + point(left, top - r + k) +
+              point(left, top - r) + "c\n";
+  content_ += point(left, bottom + r) + "l\n";
+  content_ += point(left, bottom + r - k) + point(left + r - k, bottom) +
+              point(left + r, bottom) + "c\n";
+  content_ += "b\n";
+}
+
+void PdfWriter::Line(double x1, double y1, double x2, double y2,
+                     double line_width, uint32_t color) {
+  SetColor(color, true);
+  content_ += Number(line_width) + " w " + Number(x1) + " " +
+              Number(height_ - y1) + " m " + Number(x2) + " " +
+              Number(height_ - y2) + " l S\n";
+}
+
+std::string PdfWriter::Glyphs(const std::string& text) {
+  std::string hex = "<";
+  for (size_t i = 0; i < text.size();) {
+    uint32_t code_point = NextCodePoint(text, &i);
+    uint16_t glyph = font_->GlyphFor(code_point);
+    if (!glyph_used_[glyph]) {
+      glyph_used_[glyph] = true;
+      glyph_text_[glyph] = code_point;
+    }
+    hex += Hex16(glyph);
+  }
+  return hex + ">";
+}
+
+void PdfWriter::Text(double x, double y, double size, uint32_t color,
+                     const std::string& text) {
+  SetColor(color, false);
+  content_ += "BT /F1 " + Number(size) + " Tf " + Number(x) + " " +
+              Number(height_ - y) + " Td " + Glyphs(text) + " Tj ET\n";
+}
+
+double PdfWriter::TextWidth(const std::string& text, double size) const {
+  double units = 0;
+  for (size_t i = 0; i < text.size();) {
+    units += font_->Advance(font_->GlyphFor(NextCodePoint(text, &i)));
+  }
+  return units * size / font_->units_per_em();
+}
+
+size_t PdfWriter::FitText(const std::string& text, double size,
+                          double width) const {
+  double units = 0, room = width * font_->units_per_em() / size;
+  size_t end = 0;
+  for (size_t i = 0; i < text.size(); end = i) {
+    units += font_->Advance(font_->GlyphFor(NextCodePoint(text, &i)));
+    if (units > room) break;
+  }
+  return units > room ? end : text.size();
+}
+
+double PdfWriter::Ascent(double size) const {
+  return font_->ascent() * size / font_->units_per_em();
+}
+
+double PdfWriter::Descent(double size) const {
+  return -font_->descent() * size / font_->units_per_em();
+}
+
+std::string PdfWriter::WidthsArray() const {
+  // Runs of consecutive glyphs share one array
+  std::string widths = "[";
+  for (uint32_t glyph = 0; glyph < glyph_used_.size(); glyph++) {
+    if (!glyph_used_[glyph]) continue;
+    widths += std::to_string(glyph) + " [";
+    for (; glyph < glyph_used_.size() && glyph_used_[glyph]; glyph++) {
+      widths += std::to_string(font_->Advance(static_cast<uint16_t>(glyph)) *
+                               1000 / font_->units_per_em()) +
+                " ";
+    }
+    widths.back() = ']';
+    widths += ' ';
+  }
+  return widths + "]";
+}
+
+std::string PdfWriter::ToUnicodeCMap() const {
+  std::vector<std::string> entries;
+  for (uint32_t glyph = 1; glyph < glyph_used_.size(); glyph++) {
+    if (glyph_used_[glyph]) {
+      entries.push_back("<" + Hex16(glyph) + "> <" +
+                        Utf16Hex(glyph_text_[glyph]) + ">\n");
+    }
+  }
+  std::string cmap =
+      "/CIDInit /ProcSet findresource begin\n"
+      "12 dict begin\n"
+      "begincmap\n"
+      "/CIDSystemInfo << /Registry (Adobe) /Ordering (UCS) /Supplement 0 >> "
+      "def\n"
+      "/CMapName /Adobe-Identity-UCS def\n"
+      "/CMapType 2 def\n"
+      "1 begincodespacerange\n<0000> <FFFF>\nendcodespacerange\n";
+  // At most 100 mappings per section
+  for (size_t i = 0; i < entries.size(); i += 100) {
+    size_t count = std::min<size_t>(100, entries.size() - i);
+    cmap += std::to_string(count) + " beginbfchar\n";
+    for (size_t j = i; j < i + count; j++) cmap += entries[j];
+    cmap += "endbfchar\n";
+  }
+  return cmap +
+         "endcmap\n"
+         "CMapName currentdict /CMap defineresource pop\n"
+         "end\n"
+         "end\n";
+}
+
+std::string PdfWriter::FontName() const {
+  // A subset is named with a six letter tag that depends on its glyphs
+  uint32_t hash = 2166136261u;
+  for (uint32_t glyph = 0; glyph < glyph_used_.size(); glyph++) {
+    if (glyph_used_[glyph]) hash = (hash ^ glyph) * 16777619u;
+  }
+  std::string tag;
+  for (int i = 0; i < 6; i++, hash /= 26) {
+    tag += static_cast<char>('A' + hash % 26);
+  }
+  std::string name = font_->postscript_name();
+  return tag + "+" + (name.empty() ? "Font" : name);
+}
+
+bool PdfWriter::Finish(const std::string& title, std::string* error) {
+  uint32_t cid_font = NewObject();
+  uint32_t descriptor = NewObject();
+  uint32_t font_file = NewObject();
+  uint32_t to_unicode = NewObject();
+  uint32_t info = NewObject();
+
+  std::string name = "/" + FontName();
+  auto scaled = [this](int units) {
+    return std::to_string(units * 1000 / font_->units_per_em());
+  };
+  const int* bbox = font_->bbox();
+  std::string subset = font_->Subset(glyph_used_);
+  std::string kids;
+  for (uint32_t page : pages_) kids += std::to_string(page) + " 0 R ";
+
+  if (!WriteObject(kFont,
+                   "<< /Type /Font /Subtype /Type0 /BaseFont " + name +
+                       " /Encoding /Identity-H /DescendantFonts [" +
+                       std::to_string(cid_font) + " 0 R] /ToUnicode " +
+                       std::to_string(to_unicode) + " 0 R >>",
+                   error) ||
+      !WriteObject(cid_font,
+                   "<< /Type /Font /Subtype /CIDFontType2 /BaseFont " + name +
+                       " /CIDSystemInfo << /Registry (Adobe) /Ordering "
+                       "(Identity) /Supplement 0 >> /FontDescriptor " +
+                       std::to_string(descriptor) +
+                       " 0 R /CIDToGIDMap /Identity /W " + WidthsArray() +
+                       " >>",
+                   error) ||
+      !WriteObject(descriptor,
+                   "<< /Type /FontDescriptor /FontName " + name +
+                       " /Flags 32 /FontBBox [" + scaled(bbox[0]) + " " +
+                       scaled(bbox[1]) + " " + scaled(bbox[2]) + " " +
+                       scaled(bbox[3]) + "] /ItalicAngle 0 /Ascent " +
+                       scaled(font_->ascent()) + " /Descent " +
+                       scaled(font_->descent()) + " /CapHeight " +
+                       scaled(font_->cap_height()) +
+                       " /StemV 80 /FontFile2 " + std::to_string(font_file) +
+                       " 0 R >>",
+                   error) ||
+      !WriteStream(font_file, "/Length1 " + std::to_string(subset.size()),
+                   subset, error) ||
+      !WriteStream(to_unicode, "", ToUnicodeCMap(), error) ||
+      !WriteObject(info,
+                   "<< /Title " + TextString(title) +
+                       " /Producer (Money Map) >>",
+                   error) ||
+      !WriteObject(kPageTree,
+                   "<< /Type /Pages /Kids [" + kids + "] /Count " +
+                       std::to_string(pages_.size()) + " >>",
+                   error) ||
+      !WriteObject(kCatalog,
+                   "<< /Type /Catalog /Pages " + std::to_string(kPageTree) +
+                       " 0 R >>",
+                   error)) {
+    return false;
+  }
+
+  uint64_t xref = offset_;
+  std::string table = "xref\n0 " + std::to_string(offsets_.size() + 1) +
+                      "\n0000000000 65535 f \n";
+  for (uint64_t offset : offsets_) {
+    char entry[32];
+    snprintf(entry, sizeof(entry), "%010llu 00000 n \n",
+             static_cast<unsigned long long>(offset));
+    table += entry;
+  }
+  table += "trailer\n<< /Size " + std::to_string(offsets_.size() + 1) +
+           " /Root " + std::to_string(kCatalog) + " 0 R /Info " +
+           std::to_string(info) + " 0 R >>\nstartxref\n" +
+           std::to_string(xref) + "\n%%EOF\n";
+  if (!Write(table, error)) return false;
+
+  if (fdatasync(fd_) != 0) {
+    *error = ErrnoMessage("Cannot write", temp_);
+    return false;
+  }
+  close(fd_);
+  fd_ = -1;
+  if (rename(temp_.c_str(), path_.c_str()) != 0) {
+    *error = ErrnoMessage("Cannot write", path_);
+    unlink(temp_.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,86 @@
+#ifndef RUNNER_PDF_WRITER_H_
+#define RUNNER_PDF_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "truetype.h"
+
+// Writes a PDF one page at a time, all text set in one TrueType font.
+//
+// Each page's content is deflated and written out as soon as the page ends,
+// so memory does not grow with the page count beyond an offset per object.
+// The font is embedded once at the end, holding only the glyphs the pages
+// used.
+//
+// Positions are in points from the top left corner of the page; colours are
+// 0xRRGGBB.
+class PdfWriter {
+ public:
+  explicit PdfWriter(const TrueTypeFont* font) : font_(font) {}
+  ~PdfWriter();
+
+  PdfWriter(const PdfWriter&) = delete;
+  PdfWriter& operator=(const PdfWriter&) = delete;
+
+  // The file is written next to |path| and renamed over it by Finish().
+  bool Open(const std::string& path, std::string* error);
+
+  void StartPage(double width, double height);
+  bool EndPage(std::string* error);
+
+  void FillRect(double x, double y, double width, double height,
+                uint32_t color);
+  void FillRoundRect(double x, double y, double width, double height,
+                     double radius, uint32_t fill, uint32_t stroke,
+                     double line_width);
+  void Line(double x1, double y1, double x2, double y2, double line_width,
+            uint32_t color);
+  // UTF-8 |text| starting at |x| on the baseline |y|.
+  void Text(double x, double y, double size, uint32_t color,
+            const std::string& text);
+
+  double TextWidth(const std::string& text, double size) const;
+  // Length in bytes of the longest start of |text| no wider than |width|,
+  // cut between characters.
+  size_t FitText(const std::string& text, double size, double width) const;
+
+  // Heights above and below the baseline of a line of |size|.
+  double Ascent(double size) const;
+  double Descent(double size) const;  // Positive
+
+  // Writes the font, the page tree and the cross-reference table.
+  bool Finish(const std::string& title, std::string* error);
+
+ private:
+  uint32_t NewObject();
+  bool WriteObject(uint32_t id, const std::string& body, std::string* error);
+  bool WriteStream(uint32_t id, const std::string& dictionary,
+                   const std::string& data, std::string* error);
+  bool Write(const std::string& data, std::string* error);
+  void SetColor(uint32_t color, bool stroke);
+  std::string Glyphs(const std::string& text);
+  std::string WidthsArray() const;
+  std::string ToUnicodeCMap() const;
+  std::string FontName() const;
+
+  const TrueTypeFont* font_;
+  std::string path_;
+  std::string temp_;
+  int fd_ = -1;
+  uint64_t offset_ = 0;
+  std::vector<uint64_t> offsets_;  // Of each object, by id - 1
+  std::vector<uint32_t> pages_;
+  std::string content_;
+  double width_ = 0;
+  double height_ = 0;
+  std::vector<bool> glyph_used_;
+  // The first code point drawn with each glyph, for copying text out
+  std::vector<uint32_t> glyph_text_;
+};
+
+// |value| with |decimals| digits after a '.', whatever the C locale says.
+std::string FormatFixed(double value, int decimals);
+
+#endif  // RUNNER_PDF_WRITER_H_
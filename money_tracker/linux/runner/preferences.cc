@@ -0,0 +1,184 @@
+#include "preferences.h"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// The plugin stores every key with this in front
+const char kKeyPrefix[] = "flutter.";
+
+// Just enough of a JSON reader to walk the top-level object of the file.
+class JsonReader {
+ public:
+  explicit JsonReader(const std::string& text) : text_(text) {}
+
+  bool Consume(char c) {
+    SkipSpace();
+    if (pos_ >= text_.size() || text_[pos_] != c) return false;
+    pos_++;
+    return true;
+  }
+
+  // Reads a string into |out|, which may be null to skip it.
+  bool String(std::string* out) {
+    if (!Consume('"')) return false;
+    while (pos_ < text_.size()) {
+      char c = text_[pos_++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        if (out != nullptr) *out += c;
+        continue;
+      }
+      if (pos_ >= text_.size()) return false;
+      char escape = text_[pos_++];
+      uint32_t code_point;
+      switch (escape) {
+        case 'b': code_point = '\b'; break;
+        case 'f': code_point = '\f'; break;
+        case 'n': code_point = '\n'; break;
+        case 'r': code_point = '\r'; break;
+        case 't': code_point = '\t'; break;
+        case 'u':
+          if (!Hex4(&code_point)) return false;
+          if (code_point >= 0xd800 && code_point < 0xdc00) {
+            uint32_t low;
+            if (text_.compare(pos_, 2, "\\u") != 0) return false;
+            pos_ += 2;
+            if (!Hex4(&low) || low < 0xdc00 || low >= 0xe000) return false;
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) +
+                         (low - 0xdc00);
+          }
+          break;
+        default: code_point = static_cast<unsigned char>(escape); break;
+      }
+      if (out != nullptr) AppendUtf8(code_point, out);
+    }
+    return false;
+  }
+
+  // Skips a value of any type.
+  bool SkipValue() {
+    SkipSpace();
+    if (pos_ >= text_.size()) return false;
+    char c = text_[pos_];
+    if (c == '"') return String(nullptr);
+    if (c != '{' && c != '[') {
+      // A number, true, false or null
+      size_t start = pos_;
+      while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' &&
+             text_[pos_] != ']' && !IsSpace(text_[pos_])) {
+        pos_++;
+      }
+      return pos_ > start;
+    }
+    int depth = 0;
+    while (pos_ < text_.size()) {
+      c = text_[pos_];
+      if (c == '"') {
+        if (!String(nullptr)) return false;
+        continue;
+      }
+      pos_++;
+      if (c == '{' || c == '[') depth++;
+      if ((c == '}' || c == ']') && --depth == 0) return true;
+    }
+    return false;
+  }
+
+ private:
+  static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  void SkipSpace() {
+    while (pos_ < text_.size() && IsSpace(text_[pos_])) pos_++;
+  }
+
+  bool Hex4(uint32_t* value) {
+    if (pos_ + 4 > text_.size()) return false;
+    char digits[5] = {};
+    text_.copy(digits, 4, pos_);
+    char* end;
+    *value = strtoul(digits, &end, 16);
+    pos_ += 4;
+    return end == digits + 4;
+  }
+
+  static void AppendUtf8(uint32_t c, std::string* out) {
+    if (c < 0x80) {
+      *out += static_cast<char>(c);
+    } else if (c < 0x800) {
+      *out += static_cast<char>(0xc0 | (c >> 6));
+      *out += static_cast<char>(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+      *out += static_cast<char>(0xe0 | (c >> 12));
+      *out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      *out += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+      *out += static_cast<char>(0xf0 | (c >> 18));
+      *out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      *out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      *out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+  }
+
+  const std::string& text_;
+  size_t pos_ = 0;
+};
+
+bool ReadText(const std::string& path, std::string* text) {
+  FILE* file = fopen(path.c_str(), "re");
+  if (file == nullptr) return false;
+  char buffer[16 * 1024];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text->append(buffer, n);
+  }
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+}  // namespace
+
+bool ReadStringPreference(const std::string& path, const std::string& key,
+                          std::string* value) {
+  std::string text;
+  if (!ReadText(path, &text)) return false;
+  JsonReader reader(text);
+  if (!reader.Consume('{')) return false;
+  if (reader.Consume('}')) return false;
+  const std::string wanted = PreferenceFileKey(key);
+  do {
+    std::string name;
+    if (!reader.String(&name) || !reader.Consume(':')) return false;
+    if (name == wanted) {
+      value->clear();
+      return reader.String(value);
+    }
+    if (!reader.SkipValue()) return false;
+  } while (reader.Consume(','));
+  return false;
+}
+
+std::string PreferenceFileKey(const std::string& key) {
+  return kKeyPrefix + key;
+}
+
+std::string PendingPreferencesPath(const std::string& ledger_directory) {
+  return ledger_directory + "/preferences.pending";
+}
+
+bool InstallPendingPreferences(const std::string& ledger_directory,
+                               const std::string& path) {
+  return rename(PendingPreferencesPath(ledger_directory).c_str(),
+                path.c_str()) == 0;
+}
+
+void DiscardPendingPreferences(const std::string& ledger_directory) {
+  unlink(PendingPreferencesPath(ledger_directory).c_str());
+}
@@ -0,0 +1,29 @@
+#ifndef RUNNER_PREFERENCES_H_
+#define RUNNER_PREFERENCES_H_
+
+#include <string>
+
+// Reads the string |key| from the shared_preferences.json file at |path|, as
+// the shared_preferences plugin writes it, so the runner can use a setting
+// before the Dart side is up. |key| is the name Dart uses; the plugin's
+// "flutter." prefix is added here. Returns false if the file or key is
+// missing or the value is not a string.
+bool ReadStringPreference(const std::string& path, const std::string& key,
+                          std::string* value);
+
+// The name |key| has in the file, with the plugin's prefix.
+std::string PreferenceFileKey(const std::string& key);
+
+// Preferences restored from a backup are staged with its ledgers and land
+// in PendingPreferencesPath(|ledger_directory|) in the same commit (see
+// LedgerStore::CommitStaged). They wait there while the Dart side applies
+// them one at a time, and are discarded once it is done. If the app stopped
+// before that, InstallPendingPreferences() moves them over |path|, the
+// plugin's file, on the next start, before the plugin reads it, so a restore
+// is never left half applied. Returns true if there were any.
+std::string PendingPreferencesPath(const std::string& ledger_directory);
+bool InstallPendingPreferences(const std::string& ledger_directory,
+                               const std::string& path);
+void DiscardPendingPreferences(const std::string& ledger_directory);
+
+#endif  // RUNNER_PREFERENCES_H_
@@ -0,0 +1,96 @@
+#include "startup_trace.h"
+
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// |text| as the inside of a JSON string.
+std::string JsonEscape(const std::string& text) {
+  std::string out;
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out += escape;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+StartupTrace* StartupTrace::Get() {
+  static StartupTrace* trace = new StartupTrace();
+  return trace;
+}
+
+StartupTrace::StartupTrace() : origin_(std::chrono::steady_clock::now()) {}
+
+int64_t StartupTrace::Now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - origin_)
+      .count();
+}
+
+void StartupTrace::Add(const std::string& name, int64_t start_us,
+                       int64_t end_us) {
+  long thread = syscall(SYS_gettid);
+  std::lock_guard<std::mutex> lock(mutex_);
+  spans_.push_back(Span{name, start_us, end_us, thread});
+}
+
+bool StartupTrace::Write(const std::string& path, std::string* error) const {
+  std::vector<Span> spans;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans = spans_;
+  }
+  // Viewers nest spans of a thread by start time; ties go to the longer one
+  std::stable_sort(spans.begin(), spans.end(),
+                   [](const Span& a, const Span& b) {
+                     if (a.start_us != b.start_us) {
+                       return a.start_us < b.start_us;
+                     }
+                     return a.end_us > b.end_us;
+                   });
+
+  // Complete ("X") events, one per span; the process's main thread has the
+  // process id as its thread id
+  long pid = getpid();
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < spans.size(); i++) {
+    const Span& span = spans[i];
+    if (i > 0) json += ',';
+    json += "{\"name\":\"" + JsonEscape(span.name) +
+            "\",\"cat\":\"startup\",\"ph\":\"X\",\"ts\":" +
+            std::to_string(span.start_us) +
+            ",\"dur\":" + std::to_string(span.end_us - span.start_us) +
+            ",\"pid\":" + std::to_string(pid) +
+            ",\"tid\":" + std::to_string(span.thread) + "}";
+  }
+  json += "]}\n";
+
+  FILE* file = fopen(path.c_str(), "we");
+  if (file == nullptr) {
+    *error = "Cannot create " + path + ": " + strerror(errno);
+    return false;
+  }
+  bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+  if (fclose(file) != 0) written = false;
+  if (!written) {
+    *error = "Cannot write " + path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,64 @@
+#ifndef RUNNER_STARTUP_TRACE_H_
+#define RUNNER_STARTUP_TRACE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// How long each step of the runner's startup takes, for telling where the
+// time to a usable window goes. Spans can be added from any thread.
+//
+// Times are microseconds on a monotonic clock that starts with the first call
+// to Get(), which main() makes before anything else.
+class StartupTrace {
+ public:
+  static StartupTrace* Get();
+
+  StartupTrace(const StartupTrace&) = delete;
+  StartupTrace& operator=(const StartupTrace&) = delete;
+
+  int64_t Now() const;
+
+  // Records that |name| ran from |start_us| until |end_us| on this thread.
+  void Add(const std::string& name, int64_t start_us, int64_t end_us);
+
+  // Writes the spans so far to |path| in the Chrome trace event format, which
+  // chrome://tracing and Perfetto open.
+  bool Write(const std::string& path, std::string* error) const;
+
+ private:
+  struct Span {
+    std::string name;
+    int64_t start_us;
+    int64_t end_us;
+    long thread;
+  };
+
+  StartupTrace();
+
+  const std::chrono::steady_clock::time_point origin_;
+  mutable std::mutex mutex_;
+  std::vector<Span> spans_;
+};
+
+// Adds a span from its construction to the end of the enclosing scope.
+class ScopedStartupSpan {
+ public:
+  explicit ScopedStartupSpan(const char* name)
+      : name_(name), start_us_(StartupTrace::Get()->Now()) {}
+  ~ScopedStartupSpan() {
+    StartupTrace* trace = StartupTrace::Get();
+    trace->Add(name_, start_us_, trace->Now());
+  }
+
+  ScopedStartupSpan(const ScopedStartupSpan&) = delete;
+  ScopedStartupSpan& operator=(const ScopedStartupSpan&) = delete;
+
+ private:
+  const char* name_;
+  int64_t start_us_;
+};
+
+#endif  // RUNNER_STARTUP_TRACE_H_
@@ -0,0 +1,250 @@
+#include "statement.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "pdf_writer.h"
+
+namespace {
+
+// A4 in points, as PdfPageFormat.a4
+const double kPageWidth = 595.28;
+const double kPageHeight = 841.89;
+const double kMargin = 32;
+const double kContentWidth = kPageWidth - 2 * kMargin;
+
+const double kHeaderRowHeight = 30;
+const double kRowHeight = 25;
+const double kCellPadding = 5;
+// Flex widths of the Date, Category, Type and Amount columns
+const double kColumnFlex[] = {2, 4, 2, 2};
+const int kColumns = 4;
+
+// The PdfColors the Dart statement uses
+const uint32_t kBlue900 = 0x0d47a1;
+const uint32_t kGreen700 = 0x388e3c;
+const uint32_t kRed700 = 0xd32f2f;
+const uint32_t kGrey50 = 0xfafafa;
+const uint32_t kGrey100 = 0xf5f5f5;
+const uint32_t kGrey200 = 0xeeeeee;
+const uint32_t kGrey300 = 0xe0e0e0;
+const uint32_t kGrey600 = 0x757575;
+const uint32_t kGrey700 = 0x616161;
+const uint32_t kBlack = 0x000000;
+
+std::string Money(double amount) { return "$" + FormatFixed(amount, 2); }
+
+std::string DateText(int64_t date_us) {
+  int64_t year;
+  int month, day;
+  CivilFromDays(LedgerDay(date_us), &year, &month, &day);
+  return std::to_string(day) + "/" + std::to_string(month) + "/" +
+         std::to_string(year);
+}
+
+class StatementLayout {
+ public:
+  explicit StatementLayout(PdfWriter* pdf) : pdf_(pdf) {
+    double x = kMargin, flex = 0;
+    for (double f : kColumnFlex) flex += f;
+    for (int i = 0; i < kColumns; i++) {
+      column_x_[i] = x;
+      column_width_[i] = kContentWidth * kColumnFlex[i] / flex;
+      x += column_width_[i];
+    }
+    body_bottom_ = kPageHeight - kMargin - 10 - LineHeight(10);
+  }
+
+  double LineHeight(double size) const {
+    return pdf_->Ascent(size) + pdf_->Descent(size);
+  }
+
+  // Height of the title, summary and table caption on the first page.
+  double IntroHeight() const {
+    return LineHeight(26) + 4 + LineHeight(14) + 16 + 20 + SummaryHeight() +
+           24 + LineHeight(14) + 8;
+  }
+
+  int RowsOnPage(int page) const {
+    double top = kMargin + (page == 0 ? IntroHeight() : 0) + kHeaderRowHeight;
+    return std::max(1, static_cast<int>((body_bottom_ - top) / kRowHeight));
+  }
+
+  void Intro(const std::string& title, double income, double expense,
+             double* y) {
+    TextLine(kMargin, y, 26, kBlue900, "Money Map Statement");
+    *y += 4;
+    TextLine(kMargin, y, 14, kGrey700, "Date Range: " + title);
+    pdf_->Line(kMargin, *y + 8, kMargin + kContentWidth, *y + 8, 2, kBlue900);
+    *y += 16 + 20;
+    Summary(income, expense, *y);
+    *y += SummaryHeight() + 24;
+    TextLine(kMargin, y, 14, kGrey700, "Transaction Details");
+    *y += 8;
+  }
+
+  void HeaderRow(double y) {
+    static const char* const kHeaders[] = {"Date", "Category", "Type",
+                                           "Amount"};
+    pdf_->FillRect(kMargin, y, kContentWidth, kHeaderRowHeight, kGrey100);
+    for (int i = 0; i < kColumns; i++) {
+      Cell(i, y, kHeaderRowHeight, 12, kHeaders[i]);
+    }
+  }
+
+  void Row(int index, double y, int64_t date_us, double amount, bool income,
+           const std::string& category) {
+    if (index % 2 == 1) {
+      pdf_->FillRect(kMargin, y, kContentWidth, kRowHeight, kGrey50);
+    }
+    Cell(0, y, kRowHeight, 10, DateText(date_us));
+    Cell(1, y, kRowHeight, 10, category);
+    Cell(2, y, kRowHeight, 10, income ? "Income" : "Expense");
+    Cell(3, y, kRowHeight, 10, (income ? "+" : "-") + Money(amount));
+  }
+
+  void Footer(int page, int pages) {
+    std::string text =
+        "Page " + std::to_string(page) + " of " + std::to_string(pages);
+    double x = kPageWidth - kMargin - pdf_->TextWidth(text, 10);
+    pdf_->Text(x, kPageHeight - kMargin - pdf_->Descent(10), 10, kGrey600,
+               text);
+  }
+
+ private:
+  double SummaryHeight() const {
+    return std::max(40.0, LineHeight(10) + 4 + LineHeight(16)) + 24;
+  }
+
+  void TextLine(double x, double* y, double size, uint32_t color,
+                const std::string& text) {
+    pdf_->Text(x, *y + pdf_->Ascent(size), size, color, text);
+    *y += LineHeight(size);
+  }
+
+  // Text left-aligned in a table cell and centred vertically; whatever does
+  // not fit the column is cut off with an ellipsis.
+  void Cell(int column, double y, double height, double size,
+            const std::string& text) {
+    double room = column_width_[column] - 2 * kCellPadding;
+    std::string fitted = text;
+    if (pdf_->TextWidth(text, size) > room) {
+      const std::string kEllipsis = "\xe2\x80\xa6";
+      fitted.resize(pdf_->FitText(
+          text, size, room - pdf_->TextWidth(kEllipsis, size)));
+      fitted += kEllipsis;
+    }
+    double baseline = y + (height - LineHeight(size)) / 2 + pdf_->Ascent(size);
+    pdf_->Text(column_x_[column] + kCellPadding, baseline, size, kBlack,
+               fitted);
+  }
+
+  // Three figures spread evenly across a rounded box, with rules between
+  void Summary(double income, double expense, double y) {
+    double height = SummaryHeight();
+    pdf_->FillRoundRect(kMargin, y, kContentWidth, height, 8, kGrey50,
+                        kGrey200, 0.5);
+    struct Item {
+      const char* label;
+      std::string amount;
+      uint32_t color;
+      double width;
+    };
+    Item items[] = {{"Total Income", Money(income), kGreen700, 0},
+                    {"Total Expense", Money(expense), kRed700, 0},
+                    {"Net Balance", Money(income - expense), kBlue900, 0}};
+    double used = 2;  // The two rules
+    for (Item& item : items) {
+      item.width = std::max(pdf_->TextWidth(item.label, 10),
+                            pdf_->TextWidth(item.amount, 16));
+      used += item.width;
+    }
+    double inner = kContentWidth - 24;
+    double space = (inner - used) / 5;
+    double x = kMargin + 12 + space / 2;
+    double middle = y + height / 2;
+    double text_top = middle - (LineHeight(10) + 4 + LineHeight(16)) / 2;
+    for (int i = 0; i < 3; i++) {
+      const Item& item = items[i];
+      double label_y = text_top;
+      pdf_->Text(x + (item.width - pdf_->TextWidth(item.label, 10)) / 2,
+                 label_y + pdf_->Ascent(10), 10, kGrey600, item.label);
+      double amount_y = label_y + LineHeight(10) + 4;
+      pdf_->Text(x + (item.width - pdf_->TextWidth(item.amount, 16)) / 2,
+                 amount_y + pdf_->Ascent(16), 16, item.color, item.amount);
+      x += item.width + space;
+      if (i < 2) {
+        pdf_->FillRect(x, middle - 20, 1, 40, kGrey300);
+        x += 1 + space;
+      }
+    }
+  }
+
+  PdfWriter* pdf_;
+  double column_x_[kColumns];
+  double column_width_[kColumns];
+  double body_bottom_;
+};
+
+}  // namespace
+
+bool WriteStatement(const Ledger& ledger, int64_t first_day, int64_t last_day,
+                    const std::string& title, const std::string& font_path,
+                    const std::string& path, int* pages, std::string* error) {
+  TrueTypeFont font;
+  if (!font.Load(font_path, error)) return false;
+  PdfWriter pdf(&font);
+  if (!pdf.Open(path, error)) return false;
+  StatementLayout layout(&pdf);
+
+  // The totals and page count go on the first page, so the rows are gone
+  // over once before they are drawn. A span is one block of the ledger;
+  // keeping them lets the rows be drawn newest first.
+  int64_t from_us = first_day * kMicrosPerDay;
+  int64_t to_us = (last_day + 1) * kMicrosPerDay;
+  std::vector<LedgerSpan> spans;
+  Totals totals;
+  size_t rows = 0;
+  ledger.ForEachSpan(from_us, to_us, [&](const LedgerSpan& span) {
+    spans.push_back(span);
+    Totals sums = SumAmounts(span.amounts, span.income, span.count);
+    totals.income += sums.income;
+    totals.expense += sums.expense;
+    rows += span.count;
+  });
+
+  *pages = 1;
+  for (size_t left = rows - std::min<size_t>(rows, layout.RowsOnPage(0));
+       left > 0; left -= std::min<size_t>(left, layout.RowsOnPage(1))) {
+    (*pages)++;
+  }
+
+  int page = 0, row_on_page = 0;
+  double y = kMargin;
+  pdf.StartPage(kPageWidth, kPageHeight);
+  layout.Intro(title, totals.income, totals.expense, &y);
+  layout.HeaderRow(y);
+  y += kHeaderRowHeight;
+  for (auto span = spans.rbegin(); span != spans.rend(); ++span) {
+    for (size_t i = span->count; i-- > 0;) {
+      if (row_on_page == layout.RowsOnPage(page)) {
+        layout.Footer(page + 1, *pages);
+        if (!pdf.EndPage(error)) return false;
+        page++;
+        row_on_page = 0;
+        y = kMargin;
+        pdf.StartPage(kPageWidth, kPageHeight);
+        layout.HeaderRow(y);
+        y += kHeaderRowHeight;
+      }
+      layout.Row(row_on_page, y, span->dates[i], span->amounts[i],
+                 span->income[i] != 0,
+                 ledger.categories()[span->categories[i]]);
+      y += kRowHeight;
+      row_on_page++;
+    }
+  }
+  layout.Footer(page + 1, *pages);
+  if (!pdf.EndPage(error)) return false;
+  return pdf.Finish("Money Map Statement " + title, error);
+}
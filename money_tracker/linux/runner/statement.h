@@ -0,0 +1,20 @@
+#ifndef RUNNER_STATEMENT_H_
+#define RUNNER_STATEMENT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "ledger.h"
+
+// Writes the statement PDF of |ledger|'s transactions dated from |first_day|
+// through |last_day| to |path|, newest first, laid out like the one
+// PdfService draws in Dart. Text is set in the TrueType font at |font_path|.
+//
+// The rows are read straight from the ledger and each page is written as
+// soon as it is full, so memory stays the same however long the statement.
+// Sets |pages| to the number of pages written.
+bool WriteStatement(const Ledger& ledger, int64_t first_day, int64_t last_day,
+                    const std::string& title, const std::string& font_path,
+                    const std::string& path, int* pages, std::string* error);
+
+#endif  // RUNNER_STATEMENT_H_
@@ -0,0 +1,391 @@
+#include "truetype.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace {
+
+// TrueType is big-endian
+uint16_t U16(const char* p) {
+  const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+  return static_cast<uint16_t>(b[0] << 8 | b[1]);
+}
+
+int16_t I16(const char* p) { return static_cast<int16_t>(U16(p)); }
+
+uint32_t U32(const char* p) {
+  return static_cast<uint32_t>(U16(p)) << 16 | U16(p + 2);
+}
+
+void Put16(std::string* out, uint16_t value) {
+  *out += static_cast<char>(value >> 8);
+  *out += static_cast<char>(value & 0xff);
+}
+
+void Put32(std::string* out, uint32_t value) {
+  Put16(out, static_cast<uint16_t>(value >> 16));
+  Put16(out, static_cast<uint16_t>(value & 0xffff));
+}
+
+void Set16(std::string* out, size_t at, uint16_t value) {
+  (*out)[at] = static_cast<char>(value >> 8);
+  (*out)[at + 1] = static_cast<char>(value & 0xff);
+}
+
+void Set32(std::string* out, size_t at, uint32_t value) {
+  Set16(out, at, static_cast<uint16_t>(value >> 16));
+  Set16(out, at + 2, static_cast<uint16_t>(value & 0xffff));
+}
+
+uint32_t Tag(const char* tag) { return U32(tag); }
+
+// Sum of the data as big-endian u32s, zero-padded to a multiple of four
+uint32_t Checksum(const std::string& data, size_t start, size_t length) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < length; i += 4) {
+    char word[4] = {0, 0, 0, 0};
+    memcpy(word, data.data() + start + i, std::min<size_t>(4, length - i));
+    sum += U32(word);
+  }
+  return sum;
+}
+
+// Composite glyph flags
+const uint16_t kArgsAreWords = 0x0001;
+const uint16_t kHaveScale = 0x0008;
+const uint16_t kMoreComponents = 0x0020;
+const uint16_t kHaveXYScale = 0x0040;
+const uint16_t kHaveTwoByTwo = 0x0080;
+
+// The tables a PDF viewer needs to draw embedded TrueType glyphs
+const char* const kSubsetTables[] = {"cvt ", "fpgm", "glyf", "head", "hhea",
+                                     "hmtx", "loca", "maxp", "prep"};
+
+}  // namespace
+
+bool TrueTypeFont::Load(const std::string& path, std::string* error) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    *error = "Cannot open " + path + ": " + strerror(errno);
+    if (fd >= 0) close(fd);
+    return false;
+  }
+  data_.resize(st.st_size);
+  size_t done = 0;
+  while (done < data_.size()) {
+    ssize_t n = read(fd, &data_[done], data_.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    done += n;
+  }
+  close(fd);
+  if (done != data_.size()) {
+    *error = "Cannot read " + path;
+    return false;
+  }
+
+  const std::string bad = path + " is not a TrueType font";
+  if (data_.size() < 12 || U32(data_.data()) != 0x00010000) {
+    *error = bad;
+    return false;
+  }
+  uint16_t count = U16(data_.data() + 4);
+  if (data_.size() < 12 + 16u * count) {
+    *error = bad;
+    return false;
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    const char* record = data_.data() + 12 + 16 * i;
+    Table table{U32(record + 8), U32(record + 12)};
+    if (table.offset > data_.size() ||
+        table.length > data_.size() - table.offset) {
+      *error = bad;
+      return false;
+    }
+    tables_[U32(record)] = table;
+  }
+
+  const Table* head = Find("head");
+  const Table* hhea = Find("hhea");
+  const Table* maxp = Find("maxp");
+  const Table* hmtx = Find("hmtx");
+  const Table* loca = Find("loca");
+  if (head == nullptr || head->length < 54 || hhea == nullptr ||
+      hhea->length < 36 || maxp == nullptr || maxp->length < 6 ||
+      hmtx == nullptr || loca == nullptr || Find("glyf") == nullptr) {
+    *error = bad;
+    return false;
+  }
+  const char* p = data_.data() + head->offset;
+  units_per_em_ = std::max<int>(U16(p + 18), 16);
+  for (int i = 0; i < 4; i++) bbox_[i] = I16(p + 36 + 2 * i);
+  long_loca_ = I16(p + 50) == 1;
+  p = data_.data() + hhea->offset;
+  ascent_ = I16(p + 4);
+  descent_ = I16(p + 6);
+  metric_count_ = U16(p + 34);
+  glyph_count_ = U16(data_.data() + maxp->offset + 4);
+  if (metric_count_ == 0 || hmtx->length < 4u * metric_count_ ||
+      loca->length < (long_loca_ ? 4u : 2u) * (glyph_count_ + 1u)) {
+    *error = bad;
+    return false;
+  }
+
+  const Table* os2 = Find("OS/2");
+  cap_height_ = ascent_ * 7 / 10;
+  if (os2 != nullptr && os2->length >= 90 &&
+      U16(data_.data() + os2->offset) >= 2) {
+    cap_height_ = I16(data_.data() + os2->offset + 88);
+  }
+
+  hmtx_ = data_.data() + hmtx->offset;
+
+  LoadName();
+  if (!LoadCmap(error)) return false;
+  for (uint32_t c = 0; c < 256; c++) {
+    auto it = cmap_.find(c);
+    if (it != cmap_.end()) latin1_[c] = it->second;
+  }
+  return true;
+}
+
+const TrueTypeFont::Table* TrueTypeFont::Find(const char* tag) const {
+  auto it = tables_.find(Tag(tag));
+  return it != tables_.end() ? &it->second : nullptr;
+}
+
+bool TrueTypeFont::LoadCmap(std::string* error) {
+  const Table* cmap = Find("cmap");
+  const std::string bad = "The font's character map is damaged";
+  if (cmap == nullptr || cmap->length < 4) {
+    *error = bad;
+    return false;
+  }
+  const char* base = data_.data() + cmap->offset;
+  const char* end = base + cmap->length;
+
+  // A full Unicode (format 12) subtable if there is one, else the BMP one
+  const char* best = nullptr;
+  uint16_t best_format = 0;
+  uint16_t count = U16(base + 2);
+  for (uint16_t i = 0; i < count && base + 12 + 8 * i <= end; i++) {
+    const char* record = base + 4 + 8 * i;
+    uint16_t platform = U16(record), encoding = U16(record + 2);
+    uint32_t offset = U32(record + 4);
+    if (offset + 2 > cmap->length) continue;
+    bool unicode = platform == 0 || (platform == 3 && (encoding == 1 ||
+                                                       encoding == 10));
+    uint16_t format = U16(base + offset);
+    if (!unicode || (format != 4 && format != 12)) continue;
+    if (best == nullptr || format > best_format) {
+      best = base + offset;
+      best_format = format;
+    }
+  }
+  if (best == nullptr) {
+    *error = bad;
+    return false;
+  }
+
+  if (best_format == 12) {
+    if (best + 16 > end) {
+      *error = bad;
+      return false;
+    }
+    uint32_t groups = U32(best + 12);
+    if (groups > static_cast<size_t>(end - best - 16) / 12) {
+      *error = bad;
+      return false;
+    }
+    for (uint32_t i = 0; i < groups; i++) {
+      const char* group = best + 16 + 12 * i;
+      uint32_t first = U32(group), last = U32(group + 4);
+      uint32_t glyph = U32(group + 8);
+      if (last < first || last > 0x10ffff) continue;
+      for (uint32_t c = first; c <= last && glyph < glyph_count_;
+           c++, glyph++) {
+        if (glyph > 0) cmap_.emplace(c, static_cast<uint16_t>(glyph));
+      }
+    }
+    return true;
+  }
+
+  if (best + 14 > end) {
+    *error = bad;
+    return false;
+  }
+  uint16_t segments = U16(best + 6) / 2;
+  const char* ends = best + 14;
+  const char* starts = ends + 2 * segments + 2;
+  const char* deltas = starts + 2 * segments;
+  const char* offsets = deltas + 2 * segments;
+  if (offsets + 2 * segments > end) {
+    *error = bad;
+    return false;
+  }
+  for (uint16_t s = 0; s < segments; s++) {
+    uint16_t first = U16(starts + 2 * s), last = U16(ends + 2 * s);
+    uint16_t delta = U16(deltas + 2 * s);
+    uint16_t range_offset = U16(offsets + 2 * s);
+    for (uint32_t c = first; c <= last && c != 0xffff; c++) {
+      uint16_t glyph;
+      if (range_offset == 0) {
+        glyph = static_cast<uint16_t>(c + delta);
+      } else {
+        const char* at = offsets + 2 * s + range_offset + 2 * (c - first);
+        if (at + 2 > end) break;
+        glyph = U16(at);
+        if (glyph != 0) glyph = static_cast<uint16_t>(glyph + delta);
+      }
+      if (glyph > 0 && glyph < glyph_count_) cmap_.emplace(c, glyph);
+    }
+  }
+  return true;
+}
+
+void TrueTypeFont::LoadName() {
+  const Table* name = Find("name");
+  if (name == nullptr || name->length < 6) return;
+  const char* base = data_.data() + name->offset;
+  uint16_t count = U16(base + 2);
+  uint16_t strings = U16(base + 4);
+  for (uint16_t i = 0; i < count; i++) {
+    if (6 + 12u * (i + 1) > name->length) break;
+    const char* record = base + 6 + 12 * i;
+    uint16_t platform = U16(record), id = U16(record + 6);
+    uint16_t length = U16(record + 8), offset = U16(record + 10);
+    if (id != 6 || uint32_t{strings} + offset + length > name->length) {
+      continue;
+    }
+    // Mac names are single bytes, Windows ones UTF-16BE; both are ASCII
+    const char* text = base + strings + offset;
+    std::string value;
+    size_t step = platform == 1 ? 1 : 2;
+    for (size_t j = step - 1; j < length; j += step) {
+      char c = text[j];
+      if (c > ' ' && c < 127 && strchr("[](){}<>/%", c) == nullptr) {
+        value += c;
+      }
+    }
+    if (!value.empty()) {
+      postscript_name_ = value;
+      return;
+    }
+  }
+}
+
+uint16_t TrueTypeFont::GlyphFor(uint32_t code_point) const {
+  if (code_point < 256) return latin1_[code_point];
+  auto it = cmap_.find(code_point);
+  return it != cmap_.end() ? it->second : 0;
+}
+
+int TrueTypeFont::Advance(uint16_t glyph) const {
+  return U16(hmtx_ + 4 * std::min<uint16_t>(glyph, metric_count_ - 1));
+}
+
+void TrueTypeFont::GlyphRange(uint16_t glyph, uint32_t* start,
+                              uint32_t* end) const {
+  const char* loca = data_.data() + Find("loca")->offset;
+  const Table* glyf = Find("glyf");
+  if (long_loca_) {
+    *start = U32(loca + 4 * glyph);
+    *end = U32(loca + 4 * glyph + 4);
+  } else {
+    *start = 2u * U16(loca + 2 * glyph);
+    *end = 2u * U16(loca + 2 * glyph + 2);
+  }
+  if (*end > glyf->length || *start > *end) *start = *end = 0;
+}
+
+std::string TrueTypeFont::Subset(const std::vector<bool>& used) const {
+  const char* glyf = data_.data() + Find("glyf")->offset;
+
+  std::vector<bool> keep(glyph_count_, false);
+  std::vector<uint16_t> pending = {0};
+  for (uint16_t glyph = 0; glyph < glyph_count_ && glyph < used.size();
+       glyph++) {
+    if (used[glyph]) pending.push_back(glyph);
+  }
+  while (!pending.empty()) {
+    uint16_t glyph = pending.back();
+    pending.pop_back();
+    if (glyph >= glyph_count_ || keep[glyph]) continue;
+    keep[glyph] = true;
+
+    uint32_t start, end;
+    GlyphRange(glyph, &start, &end);
+    if (end - start < 10 || I16(glyf + start) >= 0) continue;
+    // A composite glyph: each component is another glyph
+    for (uint32_t at = start + 10; at + 4 <= end;) {
+      uint16_t flags = U16(glyf + at);
+      pending.push_back(U16(glyf + at + 2));
+      at += 4 + ((flags & kArgsAreWords) ? 4 : 2);
+      if (flags & kHaveScale) at += 2;
+      if (flags & kHaveXYScale) at += 4;
+      if (flags & kHaveTwoByTwo) at += 8;
+      if (!(flags & kMoreComponents)) break;
+    }
+  }
+
+  // Outlines of the kept glyphs, located by a long loca
+  std::string new_glyf, new_loca;
+  for (uint16_t glyph = 0; glyph < glyph_count_; glyph++) {
+    Put32(&new_loca, static_cast<uint32_t>(new_glyf.size()));
+    if (!keep[glyph]) continue;
+    uint32_t start, end;
+    GlyphRange(glyph, &start, &end);
+    new_glyf.append(glyf + start, end - start);
+    new_glyf.resize((new_glyf.size() + 3) & ~size_t(3), '\0');
+  }
+  Put32(&new_loca, static_cast<uint32_t>(new_glyf.size()));
+
+  std::map<uint32_t, std::string> tables;
+  for (const char* tag : kSubsetTables) {
+    const Table* table = Find(tag);
+    if (table == nullptr) continue;
+    tables[Tag(tag)] = data_.substr(table->offset, table->length);
+  }
+  tables[Tag("glyf")] = new_glyf;
+  tables[Tag("loca")] = new_loca;
+  std::string& head = tables[Tag("head")];
+  Set32(&head, 8, 0);  // checkSumAdjustment, filled in below
+  Set16(&head, 50, 1);  // indexToLocFormat: long
+
+  uint16_t count = static_cast<uint16_t>(tables.size());
+  uint16_t power = 1, log = 0;
+  while (power * 2 <= count) {
+    power *= 2;
+    log++;
+  }
+  std::string font;
+  Put32(&font, 0x00010000);
+  Put16(&font, count);
+  Put16(&font, static_cast<uint16_t>(power * 16));
+  Put16(&font, log);
+  Put16(&font, static_cast<uint16_t>(count * 16 - power * 16));
+  size_t offset = 12 + 16 * count;
+  size_t head_offset = 0;
+  for (const auto& entry : tables) {
+    const std::string& table = entry.second;
+    Put32(&font, entry.first);
+    Put32(&font, Checksum(table, 0, table.size()));
+    Put32(&font, static_cast<uint32_t>(offset));
+    Put32(&font, static_cast<uint32_t>(table.size()));
+    if (entry.first == Tag("head")) head_offset = offset;
+    offset += (table.size() + 3) & ~size_t(3);
+  }
+  for (const auto& entry : tables) {
+    font += entry.second;
+    font.resize((font.size() + 3) & ~size_t(3), '\0');
+  }
+  Set32(&font, head_offset + 8, 0xB1B0AFBA - Checksum(font, 0, font.size()));
+  return font;
+}
@@ -0,0 +1,66 @@
+#ifndef RUNNER_TRUETYPE_H_
+#define RUNNER_TRUETYPE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A TrueType (glyf outline) font, read enough to lay out text and to embed
+// the glyphs a document uses in a PDF.
+class TrueTypeFont {
+ public:
+  bool Load(const std::string& path, std::string* error);
+
+  // The glyph of a Unicode code point, 0 (.notdef) if the font lacks it.
+  uint16_t GlyphFor(uint32_t code_point) const;
+
+  // Advance width in font units.
+  int Advance(uint16_t glyph) const;
+
+  // A copy of the font with the outlines of all glyphs not in |used| left
+  // out. Glyph ids stay as they are, so text keeps pointing at the right
+  // glyphs; the components of composite glyphs are kept too.
+  std::string Subset(const std::vector<bool>& used) const;
+
+  uint16_t glyph_count() const { return glyph_count_; }
+  int units_per_em() const { return units_per_em_; }
+  int ascent() const { return ascent_; }
+  int descent() const { return descent_; }  // Negative, below the baseline
+  int cap_height() const { return cap_height_; }
+  const int* bbox() const { return bbox_; }  // xMin, yMin, xMax, yMax
+  const std::string& postscript_name() const { return postscript_name_; }
+
+ private:
+  struct Table {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  const Table* Find(const char* tag) const;
+  bool LoadCmap(std::string* error);
+  void LoadName();
+  // Where glyph |glyph|'s outline lies within the glyf table.
+  void GlyphRange(uint16_t glyph, uint32_t* start, uint32_t* end) const;
+
+  std::string data_;
+  std::unordered_map<uint32_t, Table> tables_;
+  uint16_t glyph_count_ = 0;
+  uint16_t metric_count_ = 0;
+  int units_per_em_ = 1000;
+  int ascent_ = 0;
+  int descent_ = 0;
+  int cap_height_ = 0;
+  int bbox_[4] = {0, 0, 0, 0};
+  bool long_loca_ = false;
+  std::string postscript_name_;
+
+  const char* hmtx_ = nullptr;
+
+  // Code point to glyph; ranges are expanded when the font is loaded, and
+  // Latin-1 is also kept in an array as nearly all text is in it
+  std::unordered_map<uint32_t, uint16_t> cmap_;
+  uint16_t latin1_[256] = {};
+};
+
+#endif  // RUNNER_TRUETYPE_H_
@@ -4,11 +4,44 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <sstream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <functional>
+#include <cstdio> // For snprintf
 #include <algorithm>
-#include <map>
 #include <cmath> // For std::clamp
 #include <cfloat> // For FLT_MAX
+#include <climits> // For INT_MAX
+#include <array>
+#include <utility> // For std::index_sequence
+#include <chrono>
+#include <random>
+#include <cstring> // For memcpy
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <charconv> // For std::from_chars
+#include <filesystem> // For the replay export directory
+#ifndef _WIN32
+#include <fcntl.h> // For mapping input files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h> // For the performance HUD's hardware counters
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__)
+#include <immintrin.h> // For the SIMD bitonic kernels
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 using namespace sf;
 using namespace std;
@@ -40,19 +73,213 @@ bool drawButton(RenderWindow& window, const Font& font, const string& label, Vec
     return hovered;
 }
 
+// --- Animation Scheduler ---
+// Sorts run on a worker thread and mark the end of every visible step in their
+// trace. The render thread replays the trace once per frame and stops at the
+// first step that has not been on screen long enough yet, so how many steps
+// fit in one frame follows the speed setting: at 10^9 steps/s a frame covers
+// millions of steps, at 0.1 steps/s one step stays up for ten seconds while
+// the window keeps redrawing at 60 fps.
+const double MIN_STEPS_PER_SECOND = 0.1;
+const double MAX_STEPS_PER_SECOND = 1e9;
+const double SPEED_FACTOR = 3.16227766; // Two clicks per power of ten
+const float FRAME_SECONDS = 1.0f / 60;
+
+struct AnimationScheduler {
+    double stepsPerSecond = 20; // Same pace as the old 50 ms delay
+    double budget = 0;          // Steps paid for by elapsed time
+    bool charged = false;       // The step on screen has already been billed
+    Clock frameClock;           // Time since the last frame began
+
+    void faster() { stepsPerSecond = std::min(MAX_STEPS_PER_SECOND, stepsPerSecond * SPEED_FACTOR); }
+    void slower() { stepsPerSecond = std::max(MIN_STEPS_PER_SECOND, stepsPerSecond / SPEED_FACTOR); }
+
+    string speedLabel() const {
+        char buf[32];
+        double s = stepsPerSecond;
+        if (s < 10) snprintf(buf, sizeof(buf), "%.1f", s);
+        else if (s < 1e3) snprintf(buf, sizeof(buf), "%.0f", s);
+        else if (s < 1e6) snprintf(buf, sizeof(buf), "%.0fK", s / 1e3);
+        else if (s < 1e9) snprintf(buf, sizeof(buf), "%.0fM", s / 1e6);
+        else snprintf(buf, sizeof(buf), "%.0fG", s / 1e9);
+        return string(buf) + " steps/s";
+    }
+
+    // Forget time spent outside of a sort (menus, input) before starting one
+    void start() {
+        budget = 0;
+        charged = false;
+        frameClock.restart();
+    }
+
+    // Once per frame, before replaying: credit the time since the last frame
+    void beginFrame() {
+        double dt = frameClock.restart().asSeconds();
+        budget = std::min(budget + dt * stepsPerSecond, stepsPerSecond * FRAME_SECONDS + 1);
+    }
+
+    // Called when replay reaches the end of a step. Returns true once that
+    // step has been on screen for cost / stepsPerSecond seconds.
+    bool pay(double cost) {
+        if (!charged) { budget -= cost; charged = true; }
+        if (budget < 0) return false;
+        charged = false;
+        return true;
+    }
+};
+
 // --- Global UI Draw Function (for animations) ---
-void drawGlobalUI(RenderWindow& window, const Font& font, int animationDelay) {
+void drawGlobalUI(RenderWindow& window, const Font& font, const AnimationScheduler& anim) {
     drawButton(window, font, "Reset", {850, 10}, {120, 40});
     drawButton(window, font, "New Array", {980, 10}, {120, 40});
     drawButton(window, font, "Speed -", {850, 60}, {80, 30});
     drawButton(window, font, "Speed +", {940, 60}, {80, 30});
-    Text speedText(font, "Delay: " + to_string(animationDelay) + "ms");
+    Text speedText(font, anim.speedLabel());
     speedText.setCharacterSize(16);
     speedText.setFillColor(Color::White);
     speedText.setPosition({1030, 65});
     window.draw(speedText);
 }
 
+// Speed buttons react to the click itself, so holding the mouse down neither
+// repeats nor needs a debounce sleep
+bool handleSpeedClick(AnimationScheduler& anim, Vector2i mouse) {
+    RectangleShape r_speedDown({80, 30}); r_speedDown.setPosition({850, 60});
+    RectangleShape r_speedUp({80, 30}); r_speedUp.setPosition({940, 60});
+    if (r_speedDown.getGlobalBounds().contains(Vector2f(mouse))) { anim.slower(); return true; }
+    if (r_speedUp.getGlobalBounds().contains(Vector2f(mouse))) { anim.faster(); return true; }
+    return false;
+}
+
+// --- Tree camera ---
+// Pan and zoom for the tree views as an sf::View, so the tree is built in
+// world coordinates and moved by the GPU. Zoom eases toward its target around
+// the cursor, a released drag keeps gliding, and F fits the whole tree.
+const float MIN_TREE_ZOOM = 0.01f;
+const float MAX_TREE_ZOOM = 2;
+const float ZOOM_STEP = 1.2f;   // Per wheel notch (Ctrl + wheel)
+const float ZOOM_EASE = 12;     // How fast zoom and fit catch up, per second
+const float PAN_FRICTION = 4;   // How fast a glide slows down, per second
+const float VIEW_MARGIN = 50;   // World units of overpan around the tree
+
+struct TreeCamera {
+    Vector2f center{WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f}; // Zoom 1 here matches the old unpanned view
+    float zoom = 1;
+    float targetZoom = 1;
+    Vector2f anchor;          // Screen point that stays put while zooming
+    Vector2f velocity;        // World units per second
+    Vector2f dragMoved;       // Since the last update, for the release velocity
+    bool dragging = false;
+    Vector2i lastMouse;
+    bool fitting = false;
+    Vector2f fitCenter;
+    FloatRect bounds;         // The tree's extent, kept up to date by the owner
+    Clock clock;
+
+    Vector2f viewSize() const { return {WINDOW_WIDTH / zoom, WINDOW_HEIGHT / zoom}; }
+    View view() const { return View(center, viewSize()); }
+    FloatRect visible() const { return FloatRect(center - viewSize() / 2.0f, viewSize()); }
+
+    Vector2f toWorld(Vector2f screen) const {
+        return center + (screen - Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f)) / zoom;
+    }
+
+    void zoomAt(Vector2f screen, float factor) {
+        targetZoom = std::clamp(targetZoom * factor, MIN_TREE_ZOOM, MAX_TREE_ZOOM);
+        anchor = screen;
+        fitting = false;
+    }
+
+    void fit() {
+        if (bounds.size.x <= 0) return;
+        targetZoom = std::clamp(std::min(WINDOW_WIDTH / (bounds.size.x + 2 * VIEW_MARGIN),
+                                         WINDOW_HEIGHT / (bounds.size.y + 2 * VIEW_MARGIN)),
+                                MIN_TREE_ZOOM, MAX_TREE_ZOOM);
+        fitCenter = bounds.position + bounds.size / 2.0f;
+        fitCenter.y = std::max(fitCenter.y, WINDOW_HEIGHT / 2.0f / targetZoom); // Same limit as update()
+        fitting = true;
+        velocity = {};
+    }
+
+    // Returns true if the event was meant for the camera
+    bool handleEvent(const Event& event) {
+        if (auto scroll = event.getIf<Event::MouseWheelScrolled>()) {
+            if (scroll->wheel != Mouse::Wheel::Vertical) return false;
+            if (Keyboard::isKeyPressed(Keyboard::Key::LControl) || Keyboard::isKeyPressed(Keyboard::Key::RControl)) {
+                zoomAt(Vector2f(scroll->position), std::pow(ZOOM_STEP, scroll->delta));
+            } else {
+                center.y -= scroll->delta * 20.0f / zoom;
+                fitting = false;
+            }
+            return true;
+        }
+        if (auto press = event.getIf<Event::MouseButtonPressed>()) {
+            if (press->button != Mouse::Button::Left) return false;
+            dragging = true;
+            lastMouse = press->position;
+            velocity = {};
+            dragMoved = {};
+            fitting = false;
+            return true;
+        }
+        if (auto release = event.getIf<Event::MouseButtonReleased>()) {
+            if (release->button != Mouse::Button::Left) return false;
+            dragging = false;
+            return true;
+        }
+        if (auto move = event.getIf<Event::MouseMoved>()) {
+            if (!dragging) return false;
+            Vector2f delta = Vector2f(move->position - lastMouse) / zoom;
+            lastMouse = move->position;
+            center -= delta;
+            dragMoved -= delta;
+            return true;
+        }
+        if (auto key = event.getIf<Event::KeyPressed>()) {
+            if (key->code != Keyboard::Key::F) return false;
+            fit();
+            return true;
+        }
+        return false;
+    }
+
+    // Once per frame
+    void update() {
+        float dt = std::min(clock.restart().asSeconds(), 0.1f);
+        float ease = 1 - std::exp(-ZOOM_EASE * dt);
+
+        if (zoom != targetZoom) {
+            Vector2f before = toWorld(anchor);
+            zoom = std::exp(std::log(zoom) + (std::log(targetZoom) - std::log(zoom)) * ease);
+            if (std::abs(std::log(zoom / targetZoom)) < 1e-3f) zoom = targetZoom;
+            if (!fitting) center += before - toWorld(anchor);
+        }
+
+        if (fitting) {
+            center += (fitCenter - center) * ease;
+            if (zoom == targetZoom && std::hypot(fitCenter.x - center.x, fitCenter.y - center.y) * zoom < 0.5f) fitting = false;
+        } else if (dragging) {
+            if (dt > 0) velocity = velocity * 0.5f + dragMoved / dt * 0.5f;
+            dragMoved = {};
+        } else if (velocity != Vector2f()) {
+            center += velocity * dt;
+            velocity *= std::exp(-PAN_FRICTION * dt);
+            if (std::hypot(velocity.x, velocity.y) * zoom < 5) velocity = {};
+        }
+
+        // Keep the tree in reach, and never scroll above the root
+        if (bounds.size.x > 0) {
+            float top = WINDOW_HEIGHT / 2.0f / zoom;
+            float bottom = std::max(top, bounds.position.y + bounds.size.y + VIEW_MARGIN);
+            Vector2f clamped(std::clamp(center.x, bounds.position.x - VIEW_MARGIN, bounds.position.x + bounds.size.x + VIEW_MARGIN),
+                             std::clamp(center.y, top, bottom));
+            if (clamped.x != center.x) velocity.x = 0;
+            if (clamped.y != center.y) velocity.y = 0;
+            center = clamped;
+        }
+    }
+};
+
 // --- Event Polling & UI Check ---
 struct UIState {
     bool resetPressed = false;
@@ -60,16 +287,9 @@ struct UIState {
     bool shouldClose = false;
 };
 
-// ✅ NEW: Added viewOffsetX, min/maxTreeX for panning
-UIState pollEventsAndCheckUI(
-    RenderWindow& window, const Font& font, int& animationDelay, 
-    float& viewOffsetX, float minTreeX, float maxTreeX,
-    float& viewOffsetY, float maxTreeY,
-    bool& isPanning, Vector2i& lastPanMousePos
-) {
+// ✅ NEW: The camera handles panning, scrolling and zoom
+UIState pollEventsAndCheckUI(RenderWindow& window, const Font& font, AnimationScheduler& anim, TreeCamera& camera) {
     UIState state;
-    bool speedUpPressed = false;
-    bool speedDownPressed = false;
     
     while (auto event = window.pollEvent()) {
         if (event->is<Event::Closed>()) {
@@ -77,570 +297,3845 @@ UIState pollEventsAndCheckUI(
             window.close();
         }
 
-        // Handle scroll wheel (Vertical)
-        if (auto scrollEvent = event->getIf<Event::MouseWheelScrolled>()) {
-            if (scrollEvent->wheel == Mouse::Wheel::Vertical) {
-                float delta = scrollEvent->delta; 
-                viewOffsetY = std::clamp(viewOffsetY - delta * 20.0f, 0.0f, std::max(0.0f, maxTreeY - WINDOW_HEIGHT + 100.0f));
-            }
-        }
+        if (auto mbp = event->getIf<Event::MouseButtonPressed>()) {
+            if (mbp->button == Mouse::Button::Left && handleSpeedClick(anim, mbp->position)) continue;
+        }
+        camera.handleEvent(*event);
+    }
+
+    // --- Check UI Buttons ---
+    Vector2i mouse = Mouse::getPosition(window);
+    bool mousePressed = Mouse::isButtonPressed(Mouse::Button::Left);
+
+    RectangleShape r_reset({120, 40}); r_reset.setPosition({850, 10});
+    RectangleShape r_new({120, 40}); r_new.setPosition({980, 10});
+
+    if (mousePressed && r_reset.getGlobalBounds().contains(Vector2f(mouse))) state.resetPressed = true;
+    if (mousePressed && r_new.getGlobalBounds().contains(Vector2f(mouse))) state.newArrayPressed = true;
+    
+    return state;
+}
+
+
+// --- Highlights (shared by every renderer) ---
+enum Highlight : uint8_t { HL_NONE, HL_COMPARE, HL_SWAP, HL_SORTED, HL_PIVOT, HL_BOUNDARY };
+
+Color highlightColor(uint8_t h, Color base) {
+    switch (h) {
+        case HL_COMPARE: return Color::Yellow;
+        case HL_SWAP: return Color::Red;
+        case HL_SORTED: return Color::Green;
+        case HL_PIVOT: return Color::Magenta;
+        case HL_BOUNDARY: return Color::Blue;
+        default: return base;
+    }
+}
+
+// One byte of state per element plus the list of marked elements, so a lookup
+// is an array read and clearing costs only as much as what was marked.
+struct HighlightBuffer {
+    vector<uint8_t> state;
+    vector<int> marked;
+
+    HighlightBuffer() = default;
+    explicit HighlightBuffer(size_t n) : state(n, HL_NONE) {}
+
+    uint8_t at(size_t i) const { return i < state.size() ? state[i] : HL_NONE; }
+
+    void set(size_t i, uint8_t h) {
+        if (i >= state.size()) return;
+        if (state[i] == HL_NONE && h != HL_NONE) marked.push_back(i);
+        state[i] = h;
+    }
+
+    void clear() {
+        for (int i : marked) state[i] = HL_NONE;
+        marked.clear();
+    }
+};
+
+const HighlightBuffer NO_HIGHLIGHTS;
+
+
+// --- Trace events (sort worker -> render thread) ---
+// A sort never touches what is on screen. It describes every change as an
+// event and the render thread replays them onto its own copy of the state.
+enum class TraceOp : uint8_t {
+    SET,         // node data[index] = value
+    MARK,        // highlight index with arg
+    CLEAR_MARKS, // drop all highlights of node
+    ACTIVE,      // node outline blue (arg = 1) or not
+    SORTED,      // node outline green (arg = 1) or not
+    TITLE,       // node title = NODE_TITLES[arg]
+    SPLIT,       // new child of node on side arg holding data[index, value)
+    LAYER,       // sorting network values have passed value layers
+    ALLOC,       // the sort took value more bytes of scratch memory (negative: freed)
+    STEP,        // end of one visible step costing arg; index comparisons and
+                 // value swaps were made since the previous step
+    DONE         // sort finished, with the last comparisons and swaps like STEP
+};
+
+// node is a tree node id (0 is the root, children are numbered in the order
+// they are split off). The bar and network modes only use node 0.
+struct TraceEvent {
+    TraceOp op;
+    uint8_t arg;
+    int node;
+    int index;
+    int value;
+};
+
+const size_t TRACE_RING_SIZE = 1 << 16; // 1 MB of events
+
+// Single-producer/single-consumer lock-free ring. Each side owns one counter
+// and keeps a cached copy of the other, so the shared counters are only read
+// when the ring looks full (worker) or empty (render thread).
+struct TraceRing {
+    vector<TraceEvent> slots = vector<TraceEvent>(TRACE_RING_SIZE);
+    alignas(64) atomic<size_t> head{0}; // Next slot to write, owned by the worker
+    size_t cachedTail = 0;
+    alignas(64) atomic<size_t> tail{0}; // Next slot to read, owned by the render thread
+    size_t cachedHead = 0;
+
+    bool tryPush(const TraceEvent& e) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h - cachedTail == TRACE_RING_SIZE) {
+            cachedTail = tail.load(memory_order_acquire);
+            if (h - cachedTail == TRACE_RING_SIZE) return false;
+        }
+        slots[h & (TRACE_RING_SIZE - 1)] = e;
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    const TraceEvent* front() {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(memory_order_acquire);
+            if (t == cachedHead) return nullptr;
+        }
+        return &slots[t & (TRACE_RING_SIZE - 1)];
+    }
+
+    void pop() { tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release); }
+
+    // Only while no worker is running
+    void clear() { head = 0; tail = 0; cachedHead = 0; cachedTail = 0; }
+};
+
+struct SortCancelled {};
+
+// Writes a trace to a replay file instead of the ring (see REPLAY FILES)
+struct TraceRecorder;
+void recordTraceEvent(TraceRecorder& recorder, const TraceEvent& e);
+
+// The worker's side of the trace. Index comes before node so the bar sorts
+// can leave node at 0.
+struct Tracer {
+    TraceRing* ring;
+    const atomic<bool>& cancel;
+    int nextNode = 1;
+    int compares = 0, swaps = 0; // Since the last step
+    TraceRecorder* recorder = nullptr;
+
+    void emit(TraceOp op, int node = 0, int index = 0, int value = 0, uint8_t arg = 0) {
+        TraceEvent e{op, arg, node, index, value};
+        if (recorder) { recordTraceEvent(*recorder, e); return; }
+        int spins = 0;
+        while (!ring->tryPush(e)) {
+            // Full: the render thread is holding a slow step on screen
+            if (cancel.load(memory_order_relaxed)) throw SortCancelled();
+            if (++spins < 64) this_thread::yield();
+            else this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    void set(int index, int value, int node = 0) { emit(TraceOp::SET, node, index, value); }
+    void mark(int index, Highlight h, int node = 0) { emit(TraceOp::MARK, node, index, 0, h); }
+    void clearMarks(int node = 0) { emit(TraceOp::CLEAR_MARKS, node); }
+    void active(int node, bool on) { emit(TraceOp::ACTIVE, node, 0, 0, on); }
+    void sorted(int node, bool on) { emit(TraceOp::SORTED, node, 0, 0, on); }
+    void title(int node, uint8_t title) { emit(TraceOp::TITLE, node, 0, 0, title); }
+    void layer(int layersDone) { emit(TraceOp::LAYER, 0, 0, layersDone); }
+    void allocated(long long bytes) { emit(TraceOp::ALLOC, 0, 0, (int)std::clamp<long long>(bytes, INT_MIN, INT_MAX)); }
+
+    // Returns the id of the new child
+    int split(int node, int side, int begin, int end) {
+        emit(TraceOp::SPLIT, node, begin, end, side);
+        return nextNode++;
+    }
+
+    // Counted for the race mode. Sorts that shift instead of exchanging
+    // (insertion, merge) count every element move as a swap.
+    void compared(int n = 1) { compares += n; }
+    void swapped() { swaps++; }
+
+    // Cancel is checked here, so Reset takes effect within one step
+    void step(int cost = 1) {
+        if (cancel.load(memory_order_relaxed)) throw SortCancelled();
+        emit(TraceOp::STEP, 0, compares, swaps, cost);
+        compares = 0; swaps = 0;
+    }
+
+    void done() { emit(TraceOp::DONE, 0, compares, swaps); }
+};
+
+// One sort in flight on its own thread
+struct SortRun {
+    TraceRing ring;
+    atomic<bool> cancel{false};
+    thread worker;
+
+    bool running() const { return worker.joinable(); }
+
+    void start(function<void(Tracer&)> sort) {
+        stop();
+        worker = thread([this, sort]() {
+            Tracer tracer{&ring, cancel};
+            try {
+                sort(tracer);
+                tracer.done();
+            } catch (const SortCancelled&) {}
+        });
+    }
+
+    // Cancels the sort if it is still going and drops whatever it traced
+    void stop() {
+        if (!worker.joinable()) return;
+        cancel = true;
+        worker.join();
+        cancel = false;
+        ring.clear();
+    }
+
+    ~SortRun() { stop(); }
+};
+
+
+// ##################################################################
+// --- MODE 1: BAR VISUALIZATION (Bubble, Insertion, Selection) ---
+// ##################################################################
+
+// --- Batched bar renderer ---
+// Every bar lives in one persistent vertex array and is drawn with a single
+// draw call. Only columns touched since the last frame are rebuilt. When there
+// are more elements than pixel columns, each column covers a range of elements
+// and shows its minimum as the bar and its maximum as a lighter cap.
+struct BarRenderer {
+    VertexArray vertices{sf::PrimitiveType::Triangles};
+    FloatRect area{{0, 0}, {WINDOW_WIDTH, WINDOW_HEIGHT}}; // Bars stand on its bottom edge
+    float headroom = 160; // Kept free above the tallest bar
+    size_t count = 0;
+    int columns = 0;
+    float columnWidth = 0;
+    float scale = 1; // Pixels per unit of value
+    vector<char> dirty;
+    vector<int> dirtyList;
+    vector<int> highlightedColumns; // Recolored last frame, restored on the next
+
+    int columnOf(size_t i) const { return (int)((unsigned long long)i * columns / count); }
+    size_t columnBegin(int c) const { return ((unsigned long long)c * count + columns - 1) / columns; }
+
+    void reset(const vector<int>& arr) {
+        count = arr.size();
+        columns = (int)std::min<size_t>(count, (size_t)area.size.x);
+        columnWidth = columns ? area.size.x / columns : 0;
+        int maxValue = 1;
+        for (int v : arr) maxValue = std::max(maxValue, v);
+        scale = std::min(1.0f, (area.size.y - headroom) / maxValue);
+        vertices.resize(columns * 12);
+        dirty.assign(columns, 0);
+        dirtyList.clear();
+        highlightedColumns.clear();
+        for (int c = 0; c < columns; c++) rebuildColumn(arr, NO_HIGHLIGHTS, c);
+    }
+
+    void touchColumn(int c) {
+        if (!dirty[c]) { dirty[c] = 1; dirtyList.push_back(c); }
+    }
+
+    // Call after writing arr[i]
+    void touch(size_t i) {
+        if (i < count) touchColumn(columnOf(i));
+    }
+
+    void setQuad(size_t v, float x0, float y0, float x1, float y1, Color color) {
+        Vertex* q = &vertices[v];
+        q[0].position = {x0, y0}; q[1].position = {x1, y0}; q[2].position = {x0, y1};
+        q[3].position = {x1, y0}; q[4].position = {x1, y1}; q[5].position = {x0, y1};
+        for (int k = 0; k < 6; k++) q[k].color = color;
+    }
+
+    void rebuildColumn(const vector<int>& arr, const HighlightBuffer& highlights, int c) {
+        int lo = INT_MAX, hi = INT_MIN;
+        uint8_t h = HL_NONE;
+        for (size_t i = columnBegin(c), end = columnBegin(c + 1); i < end; i++) {
+            lo = std::min(lo, arr[i]);
+            hi = std::max(hi, arr[i]);
+            if (h == HL_NONE) h = highlights.at(i);
+        }
+        Color color = highlightColor(h, Color::Green);
+        float x0 = area.position.x + c * columnWidth;
+        float x1 = x0 + columnWidth - (columnWidth > 4 ? 2 : 0);
+        float bottom = area.position.y + area.size.y;
+        float yLo = bottom - std::max(0, lo) * scale;
+        float yHi = bottom - std::max(0, hi) * scale;
+        Color cap(color.r + (255 - color.r) / 2, color.g + (255 - color.g) / 2, color.b + (255 - color.b) / 2);
+        setQuad(c * 12, x0, yLo, x1, bottom, color);
+        setQuad(c * 12 + 6, x0, yHi, x1, yLo, cap);
+    }
+
+    void update(const vector<int>& arr, const HighlightBuffer& highlights) {
+        if (arr.size() != count) reset(arr);
+        for (int c : highlightedColumns) touchColumn(c);
+        highlightedColumns.clear();
+        for (int i : highlights.marked) {
+            if ((size_t)i >= count || highlights.at(i) == HL_NONE) continue;
+            touchColumn(columnOf(i));
+            highlightedColumns.push_back(columnOf(i));
+        }
+        for (int c : dirtyList) {
+            rebuildColumn(arr, highlights, c);
+            dirty[c] = 0;
+        }
+        dirtyList.clear();
+    }
+};
+
+void drawSortState_bars(RenderTarget& target, const Font& font, BarRenderer& bars, const vector<int>& arr,
+                        const string& title, const HighlightBuffer& highlights = NO_HIGHLIGHTS) {
+    target.clear(Color::Black);
+
+    if (!title.empty()) {
+        Text titleText(font, title);
+        titleText.setCharacterSize(24);
+        titleText.setFillColor(Color::White);
+        titleText.setPosition({(WINDOW_WIDTH - titleText.getLocalBounds().size.x) / 2, 100});
+        target.draw(titleText);
+    }
+    
+    bars.update(arr, highlights);
+    target.draw(bars.vertices);
+
+    // Labels only when there is room for them (at most 60 bars)
+    float barWidth = bars.columnWidth;
+    if (barWidth > 20) {
+        for (size_t i = 0; i < arr.size(); i++) {
+            Text valText(font, to_string(arr[i]));
+            valText.setCharacterSize(14);
+            valText.setFillColor(Color::White);
+            FloatRect textBounds = valText.getLocalBounds();
+            valText.setPosition({
+                (i * barWidth + (barWidth / 2)) - (textBounds.size.x / 2) - textBounds.position.x,
+                WINDOW_HEIGHT - arr[i] * bars.scale - 20
+            });
+            target.draw(valText);
+        }
+    }
+    
+}
+
+// Bar sorts run on the worker with their own copy of the array and
+// describe every write and highlight through the tracer
+void bubbleSort_bars(Tracer& t, vector<int>& arr) {
+    for (size_t i = 0; i < arr.size(); i++) {
+        for (size_t j = 0; j < arr.size() - i - 1; j++) {
+            t.clearMarks(); t.mark(j, HL_COMPARE); t.mark(j + 1, HL_COMPARE);
+            t.compared();
+            t.step();
+
+            if (arr[j] > arr[j + 1]) {
+                swap(arr[j], arr[j + 1]);
+                t.swapped();
+                t.set(j, arr[j]); t.set(j + 1, arr[j + 1]);
+                t.mark(j, HL_SWAP); t.mark(j + 1, HL_SWAP);
+                t.step();
+            }
+        }
+    }
+}
+
+void insertionSort_bars(Tracer& t, vector<int>& arr) {
+    for (size_t i = 1; i < arr.size(); i++) {
+        int key = arr[i];
+        int j = i - 1;
+        while (j >= 0 && arr[j] > key) {
+            t.clearMarks(); t.mark(j, HL_COMPARE); t.mark(j + 1, HL_COMPARE);
+            t.compared();
+            t.step();
+            arr[j + 1] = arr[j];
+            t.swapped();
+            t.set(j + 1, arr[j + 1]);
+            j = j - 1;
+            t.clearMarks(); t.mark(j + 1, HL_SWAP); t.mark(j + 2, HL_SWAP);
+            t.step();
+        }
+        if (j >= 0) t.compared(); // The comparison that ended the loop
+        arr[j + 1] = key;
+        t.set(j + 1, key);
+    }
+}
+
+void selectionSort_bars(Tracer& t, vector<int>& arr) {
+    for (size_t i = 0; i < arr.size() - 1; i++) {
+        int min_idx = i;
+        for (size_t j = i + 1; j < arr.size(); j++) {
+            t.clearMarks(); t.mark(min_idx, HL_COMPARE); t.mark(j, HL_COMPARE);
+            t.compared();
+            t.step();
+            if (arr[j] < arr[min_idx]) {
+                min_idx = j;
+            }
+        }
+        swap(arr[min_idx], arr[i]);
+        t.swapped();
+        t.set(min_idx, arr[min_idx]); t.set(i, arr[i]);
+        t.clearMarks(); t.mark(min_idx, HL_SWAP); t.mark(i, HL_SWAP);
+        t.step();
+    }
+}
+
+
+// ################################################################
+// --- MODE 2: TREE VISUALIZATION (Quick, Merge) ---
+// ################################################################
+
+// --- Recursion tree ---
+// Nodes live in one flat arena and show a range of a shared buffer instead of
+// owning a copy of their slice. Quick sort works in place, so every node shows
+// buffer 0. Merge sort merges children from one buffer into the other, so a
+// node at depth d shows buffer d % 2: parent and children are always in
+// different buffers, and a finished subtree later shows what its ancestors
+// wrote over it, exactly as the memory of a ping-pong merge sort would.
+struct TreeNode {
+    int lo = 0, hi = 0;   // Values shown: buffers[buffer][lo, hi)
+    uint8_t buffer = 0;
+    int depth = 0;
+    int left = -1, right = -1, parent = -1;
+    float centerX = 0;    // Layout only depends on the path from the root
+    float spread = 0;     // Horizontal offset of the children
+    FloatRect bounds;
+    FloatRect subtree;    // Bounds of the node and everything below it
+    string title;
+    bool isSorted = false;
+    bool isActive = false;
+};
+
+// Titles a sort can give a node through the trace. The bar view shows them
+// as a status next to the sort's name.
+enum NodeTitle : uint8_t {
+    TITLE_SPLITTING, TITLE_MERGING, TITLE_PARTITION, TITLE_COMBINING, TITLE_COMBINED,
+    TITLE_FINDING_RUNS, TITLE_EXTENDING_RUN, TITLE_GALLOPING,
+    TITLE_BAD_PARTITION, TITLE_HEAPSORT, TITLE_PARTIAL_INSERTION
+};
+const char* const NODE_TITLES[] = {
+    "Splitting", "Merging", "Partition", "Combining", "Combined",
+    "Finding runs", "Extending run", "Galloping",
+    "Bad partition, breaking patterns", "Heapsort fallback", "Trying insertion sort"
+};
+
+// Highlights of all nodes, stored by buffer position. Nodes that share a
+// position (an ancestor and its descendants) are never highlighted at the
+// same time, so each position only needs to remember which node marked it.
+struct TreeHighlights {
+    HighlightBuffer marks;
+    vector<int> owner;
+    size_t bufferSize = 0;
+
+    void reset(size_t n) {
+        bufferSize = n;
+        marks = HighlightBuffer(2 * n);
+        owner.assign(2 * n, -1);
+    }
+
+    size_t slot(const TreeNode& node, int i) const { return node.buffer * bufferSize + node.lo + i; }
+
+    uint8_t at(int id, const TreeNode& node, int i) const {
+        size_t s = slot(node, i);
+        return owner[s] == id ? marks.at(s) : HL_NONE;
+    }
+
+    void set(int id, const TreeNode& node, int i, uint8_t h) {
+        size_t s = slot(node, i);
+        owner[s] = id;
+        marks.set(s, h);
+    }
+
+    // Drops the highlights of one node and leaves the others alone
+    void clear(int id) {
+        size_t keep = 0;
+        for (int s : marks.marked) {
+            if (owner[s] == id) marks.state[s] = HL_NONE;
+            else marks.marked[keep++] = s;
+        }
+        marks.marked.resize(keep);
+    }
+};
+
+const float TREE_TOP = 100;
+const float TREE_LEVEL_HEIGHT = 120;
+
+Vector2f getNodeSize(int count) {
+    float boxSize = 30;
+    float spacing = 5;
+    float totalWidth = count * (boxSize + spacing) - spacing;
+    return {totalWidth + 40, 80}; 
+}
+
+struct RecursionTree {
+    vector<int> buffers[2];
+    vector<TreeNode> nodes; // Arena; a node's id is its index
+    int root = 0;
+    TreeHighlights highlights;
+    // ✅ NEW: minX and maxX track the horizontal bounds for panning
+    float minX = FLT_MAX, maxX = -FLT_MAX, maxY = 0;
+    // Bumped on every change so renderers can tell when their cache is stale.
+    // The counter is shared by all trees so a reset tree never looks unchanged.
+    // Recording a replay builds trees on a worker, hence the atomic.
+    unsigned version = 0;
+
+    void changed() {
+        static atomic<unsigned> counter{0};
+        version = counter.fetch_add(1, memory_order_relaxed) + 1;
+    }
+
+    void reset(const vector<int>& values) {
+        buffers[0] = values;
+        buffers[1] = values;
+        nodes.clear();
+        root = 0;
+        highlights.reset(values.size());
+        minX = FLT_MAX; maxX = -FLT_MAX; maxY = 0;
+        changed();
+    }
+
+    FloatRect bounds() const {
+        if (nodes.empty()) return {};
+        return FloatRect({minX, 0}, {maxX - minX, maxY});
+    }
+
+    int value(const TreeNode& node, int i) const { return buffers[node.buffer][node.lo + i]; }
+
+    int addNode(int lo, int hi, uint8_t buffer) {
+        TreeNode node;
+        node.lo = lo; node.hi = hi; node.buffer = buffer;
+        nodes.push_back(node);
+        changed();
+        return nodes.size() - 1;
+    }
+
+    void attach(int parent, int side, int child) {
+        (side ? nodes[parent].right : nodes[parent].left) = child;
+        nodes[child].parent = parent;
+    }
+
+    // Sizes the node for its current range; its position does not change
+    void place(int id) {
+        TreeNode& node = nodes[id];
+        Vector2f size = getNodeSize(node.hi - node.lo);
+        node.bounds.position = {node.centerX - size.x / 2, TREE_TOP + node.depth * TREE_LEVEL_HEIGHT};
+        node.bounds.size = size;
+        maxY = std::max(maxY, node.bounds.position.y + size.y);
+        minX = std::min(minX, node.bounds.position.x);
+        maxX = std::max(maxX, node.bounds.position.x + size.x);
+        growSubtree(id, node.bounds);
+        changed();
+    }
+
+    // Nodes never move or shrink, so subtree bounds only ever grow. The walk
+    // stops at the first ancestor that already covers the new bounds.
+    void growSubtree(int id, const FloatRect& r) {
+        for (; id >= 0; id = nodes[id].parent) {
+            FloatRect& s = nodes[id].subtree;
+            if (s.size.x == 0) { s = r; continue; }
+            float left = std::min(s.position.x, r.position.x), top = std::min(s.position.y, r.position.y);
+            float right = std::max(s.position.x + s.size.x, r.position.x + r.size.x);
+            float bottom = std::max(s.position.y + s.size.y, r.position.y + r.size.y);
+            if (left == s.position.x && top == s.position.y && right == s.position.x + s.size.x && bottom == s.position.y + s.size.y) break;
+            s = FloatRect({left, top}, {right - left, bottom - top});
+        }
+    }
+
+    // Places a node from its parent and then everything below it. Adding a
+    // leaf therefore costs O(1) and never moves the rest of the tree.
+    void layoutSubtree(int id) {
+        TreeNode& node = nodes[id];
+        if (node.parent < 0) {
+            node.depth = 0;
+            node.centerX = WINDOW_WIDTH / 2;
+            node.spread = WINDOW_WIDTH / 4;
+        } else {
+            const TreeNode& parent = nodes[node.parent];
+            node.depth = parent.depth + 1;
+            node.centerX = parent.centerX + (parent.right == id ? parent.spread : -parent.spread);
+            node.spread = parent.spread / 2;
+        }
+        place(id);
+        if (node.left >= 0) layoutSubtree(node.left);
+        if (node.right >= 0) layoutSubtree(nodes[id].right);
+    }
+
+    // The parent's [begin, end) becomes a new child on the given side
+    int split(int parent, int side, int begin, int end, bool pingPong) {
+        int lo = nodes[parent].lo;
+        uint8_t buffer = pingPong ? (nodes[parent].depth + 1) % 2 : 0;
+        int child = addNode(lo + begin, lo + end, buffer);
+        attach(parent, side, child);
+        layoutSubtree(child);
+        return child;
+    }
+};
+
+// --- Tree renderer ---
+// Only subtrees whose bounds reach the screen are visited, and within a node
+// only the boxes on screen are built. All shapes and labels are kept in world
+// coordinates and the camera's view moves and scales them on the GPU, so the
+// geometry is only rebuilt when the tree changes, the level of detail changes
+// or the camera leaves the region that was built (the screen plus half a
+// screen on every side).
+// How much detail a node gets depends on how big a 30 unit box is on screen:
+const float LOD_TEXT_PIXELS = 14; // Values and titles readable
+const float LOD_BOX_PIXELS = 3;   // Boxes still distinguishable; below this a node is one block
+const int MAX_TEXT_BOXES = 2000;  // Per build; deep levels of big trees overlap anyway
+
+enum TreeDetail { DETAIL_BLOCKS, DETAIL_BOXES, DETAIL_TEXT };
+
+TreeDetail treeDetail(float zoom) {
+    float boxPixels = 30 * zoom;
+    if (boxPixels < LOD_BOX_PIXELS) return DETAIL_BLOCKS;
+    return boxPixels < LOD_TEXT_PIXELS ? DETAIL_BOXES : DETAIL_TEXT;
+}
+
+void appendQuad(VertexArray& quads, float x0, float y0, float x1, float y1, Color color) {
+    Vector2f corners[6] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y0}, {x1, y1}, {x0, y1}};
+    for (const Vector2f& p : corners) {
+        Vertex v;
+        v.position = p;
+        v.color = color;
+        quads.append(v);
+    }
+}
+
+// A filled rectangle with an outline drawn inside an outer rectangle
+void appendFrame(VertexArray& quads, const FloatRect& r, float outline, Color fill, Color edge) {
+    float x0 = r.position.x, y0 = r.position.y, x1 = x0 + r.size.x, y1 = y0 + r.size.y;
+    appendQuad(quads, x0 - outline, y0 - outline, x1 + outline, y1 + outline, edge);
+    appendQuad(quads, x0, y0, x1, y1, fill);
+}
+
+bool containsRect(const FloatRect& outer, const FloatRect& inner) {
+    return inner.position.x >= outer.position.x && inner.position.y >= outer.position.y &&
+           inner.position.x + inner.size.x <= outer.position.x + outer.size.x &&
+           inner.position.y + inner.size.y <= outer.position.y + outer.size.y;
+}
+
+struct TreeRenderer {
+    VertexArray lines{sf::PrimitiveType::Lines};
+    VertexArray quads{sf::PrimitiveType::Triangles};
+    vector<Text> texts;
+    vector<int> stack;
+
+    // What the geometry above was built for
+    unsigned builtVersion = 0;
+    int builtDetail = -1;
+    FloatRect builtRegion;
+
+    // Rebuilds only if the cached geometry no longer covers `visible`
+    void update(const RecursionTree& tree, const Font& font, const FloatRect& visible, float zoom) {
+        TreeDetail detail = treeDetail(zoom);
+        if (tree.version == builtVersion && detail == builtDetail && containsRect(builtRegion, visible)) return;
+
+        FloatRect region(visible.position - visible.size / 2.0f, visible.size * 2.0f);
+        build(tree, font, region, detail);
+        builtVersion = tree.version;
+        builtDetail = detail;
+        builtRegion = region;
+    }
+
+    void build(const RecursionTree& tree, const Font& font, const FloatRect& region, TreeDetail detail) {
+        lines.clear();
+        quads.clear();
+        texts.clear();
+        if (tree.nodes.empty()) return;
+
+        float boxSize = 30;
+        float spacing = 5;
+
+        int textBudget = MAX_TEXT_BOXES;
+        stack.assign(1, tree.root);
+        while (!stack.empty()) {
+            int id = stack.back(); stack.pop_back();
+            const TreeNode& node = tree.nodes[id];
+            if (!node.subtree.findIntersection(region)) continue;
+
+            for (int child : {node.left, node.right}) {
+                if (child < 0) continue;
+                const TreeNode& c = tree.nodes[child];
+                Vertex line[2];
+                line[0].position = node.bounds.position + Vector2f(node.bounds.size.x / 2, node.bounds.size.y);
+                line[1].position = c.bounds.position + Vector2f(c.bounds.size.x / 2, 0);
+                lines.append(line[0]);
+                lines.append(line[1]);
+                stack.push_back(child);
+            }
+            if (!node.bounds.findIntersection(region)) continue;
+
+            Color edge = node.isActive ? Color::Blue : (node.isSorted ? Color::Green : Color(80, 80, 80));
+            appendFrame(quads, node.bounds, 2, Color(30, 30, 30), edge);
+
+            int count = node.hi - node.lo;
+            if (count <= 0) continue;
+            float totalWidth = count * (boxSize + spacing) - spacing;
+            float startX = node.bounds.position.x + (node.bounds.size.x - totalWidth) / 2;
+            float startY = node.bounds.position.y + (node.bounds.size.y - boxSize) / 2;
+            Color boxEdge = node.isSorted ? Color::Green : Color(200, 200, 200);
+
+            if (detail == DETAIL_BLOCKS) {
+                // Zoomed out: the whole row as one block
+                appendQuad(quads, startX, startY, startX + totalWidth, startY + boxSize, node.isSorted ? Color(40, 120, 40) : Color(50, 50, 150));
+                continue;
+            }
+
+            // Only the boxes in the region
+            float pitch = boxSize + spacing;
+            int first = std::max(0, (int)std::floor((region.position.x - startX) / pitch));
+            int last = std::min(count, (int)std::ceil((region.position.x + region.size.x - startX) / pitch) + 1);
+            for (int i = first; i < last; i++) {
+                FloatRect box({startX + i * pitch, startY}, {boxSize, boxSize});
+                appendFrame(quads, box, 1, highlightColor(tree.highlights.at(id, node, i), Color(50, 50, 150)), boxEdge);
+            }
+            if (detail != DETAIL_TEXT || first >= last || textBudget <= 0) continue;
+            textBudget -= last - first;
+
+            Text& titleText = texts.emplace_back(font, node.title);
+            titleText.setCharacterSize(12);
+            titleText.setFillColor(Color::White);
+            titleText.setPosition({node.bounds.position.x + 5, node.bounds.position.y + 5});
+
+            for (int i = first; i < last; i++) {
+                Text& valText = texts.emplace_back(font, to_string(tree.value(node, i)));
+                valText.setCharacterSize(16);
+                valText.setFillColor(Color::White);
+                FloatRect textBounds = valText.getLocalBounds();
+                valText.setPosition({
+                    startX + i * pitch + (boxSize - textBounds.size.x) / 2 - textBounds.position.x,
+                    startY + (boxSize - textBounds.size.y) / 2 - textBounds.position.y - 2
+                });
+            }
+        }
+    }
+};
+
+// ✅ NEW: The camera's view pans and zooms the whole tree
+void drawTree(RenderTarget& target, const Font& font, TreeRenderer& renderer, const RecursionTree& tree, const TreeCamera& camera) {
+    renderer.update(tree, font, camera.visible(), camera.zoom);
+
+    target.setView(camera.view());
+    target.draw(renderer.lines);
+    target.draw(renderer.quads);
+    for (const Text& text : renderer.texts) target.draw(text);
+    target.setView(target.getDefaultView());
+}
+
+// --- Merge Sort (Tree) ---
+// Runs on the worker. Node `node` shows arr[lo, hi); its children are split
+// off through the trace and the render thread builds and lays out the tree.
+void animateMergeSort(Tracer& t, vector<int>& arr, vector<int>& tmp, int node, int lo, int hi) {
+    if (hi - lo <= 1) {
+        t.sorted(node, true);
+        return;
+    }
+
+    // --- 1. Divide Step ---
+    t.active(node, true);
+    t.title(node, TITLE_SPLITTING);
+    t.step(2);
+
+    int m = (hi - lo) / 2;
+    int left = t.split(node, 0, 0, m);
+    int right = t.split(node, 1, m, hi - lo);
+    t.step(2);
+    
+    t.active(node, false);
+
+    // --- 2. Recurse Step ---
+    animateMergeSort(t, arr, tmp, left, lo, lo + m);
+    animateMergeSort(t, arr, tmp, right, lo + m, hi);
+
+    // --- 3. Merge Step ---
+    t.active(node, true);
+    t.title(node, TITLE_MERGING);
+    
+    copy(arr.begin() + lo, arr.begin() + hi, tmp.begin() + lo);
+    int mid = lo + m;
+    int i = lo, j = mid, k = 0;
+    
+    // Output slots before k stay green; only the newest one changes per step
+    while (i < mid && j < hi) {
+        t.active(left, true); t.active(right, true);
+        t.mark(i - lo, HL_COMPARE, left);
+        t.mark(j - mid, HL_COMPARE, right);
+        if (k > 0) t.mark(k - 1, HL_SORTED, node);
+        t.step();
+        t.clearMarks(left); t.clearMarks(right);
+
+        int v = tmp[i] <= tmp[j] ? tmp[i++] : tmp[j++];
+        arr[lo + k] = v;
+        t.compared(); t.swapped();
+        t.set(k, v, node);
+        k++;
+        
+        t.mark(k - 1, HL_SWAP, node);
+        t.step();
+
+        t.active(left, false); t.active(right, false);
+    }
+
+    while (i < mid || j < hi) {
+        int v = i < mid ? tmp[i++] : tmp[j++];
+        arr[lo + k] = v;
+        t.swapped();
+        t.set(k, v, node);
+        if (k > 0) t.mark(k - 1, HL_SORTED, node);
+        t.mark(k, HL_SWAP, node);
+        t.step();
+        k++;
+    }
+
+    t.clearMarks(node);
+    t.sorted(node, true);
+    t.active(node, false);
+    t.step();
+}
+
+// --- Quick Sort (Tree) ---
+// ✅ FIX: Proper "combine" animation
+void animateQuickSort(Tracer& t, vector<int>& arr, int node, int lo, int hi) {
+    int n = hi - lo;
+    if (n <= 1) {
+        t.sorted(node, true);
+        return;
+    }
+    
+    t.active(node, true);
+    t.title(node, TITLE_PARTITION);
+
+    int pivot = arr[hi - 1];
+    int i = -1; 
+
+    // --- 1. Partition Step ---
+    for (int j = 0; j < n - 1; j++) {
+        t.clearMarks(node);
+        t.mark(j, HL_COMPARE, node); 
+        t.mark(n - 1, HL_PIVOT, node); 
+        if (i >= 0) t.mark(i, HL_BOUNDARY, node); 
+        t.compared();
+        t.step();
+
+        if (arr[lo + j] < pivot) {
+            i++;
+            swap(arr[lo + i], arr[lo + j]);
+            t.swapped();
+            t.set(i, arr[lo + i], node);
+            t.set(j, arr[lo + j], node);
+            t.mark(i, HL_SWAP, node);
+            t.mark(j, HL_SWAP, node);
+            t.step();
+        }
+    }
+    
+    int pi = i + 1; 
+    swap(arr[lo + pi], arr[hi - 1]);
+    t.swapped();
+    t.set(pi, arr[lo + pi], node);
+    t.set(n - 1, arr[hi - 1], node);
+    
+    t.clearMarks(node);
+    t.mark(pi, HL_SWAP, node); 
+    t.step();
+    t.clearMarks(node);
+    t.active(node, false);
+    
+    // --- 2. Divide Step (Create Children) ---
+    int left = -1, right = -1;
+    if (pi > 0) left = t.split(node, 0, 0, pi);
+    if (pi + 1 < n) right = t.split(node, 1, pi + 1, n);
+    t.step(2);
+
+    // --- 3. Recurse Step ---
+    if (left >= 0) animateQuickSort(t, arr, left, lo, lo + pi);
+    if (right >= 0) animateQuickSort(t, arr, right, lo + pi + 1, hi);
+
+    // --- 4. Combine Step (The animated "merge") ---
+    // arr[lo, hi) is sorted in place by now; fill the node up one by one
+    t.sorted(node, true);
+    t.title(node, TITLE_COMBINING);
+    t.active(node, true);
+
+    for (int k = 0; k < n; ++k) {
+        t.set(k, arr[lo + k], node);
+
+        // Highlight the newly added element
+        if (k > 0) t.mark(k - 1, HL_SORTED, node); // Already sorted
+        t.mark(k, HL_SWAP, node); // Newly added
+        t.step();
+    }
+
+    // Final draw
+    t.clearMarks(node);
+    t.title(node, TITLE_COMBINED);
+    t.active(node, false);
+    t.step(2);
+}
+
+// Whole-array entry points for the buttons, the race and replay files
+void mergeSort_tree(Tracer& t, vector<int>& arr) {
+    vector<int> tmp(arr.size());
+    t.allocated(tmp.size() * sizeof(int));
+    animateMergeSort(t, arr, tmp, 0, 0, arr.size());
+    t.allocated(-(long long)(tmp.size() * sizeof(int)));
+}
+
+void quickSort_tree(Tracer& t, vector<int>& arr) { animateQuickSort(t, arr, 0, 0, arr.size()); }
+
+
+// ################################################################
+// --- MODE 3: SORTING NETWORKS (small-partition kernels) ---
+// ################################################################
+
+const int MAX_NETWORK_SIZE = 16;
+const int MAX_COMPARATORS = 64; // Batcher needs 63 comparators for 16 wires
+
+struct Comparator {
+    int lo = 0, hi = 0; // wires, lo < hi; the smaller value ends up on lo
+    int layer = 0;      // parallel step this comparator belongs to
+};
+
+struct SortingNetwork {
+    Comparator comparators[MAX_COMPARATORS] = {};
+    int size = 0;  // number of comparators
+    int depth = 0; // number of parallel layers
+};
+
+// Batcher's odd-even merge sort (Knuth's merge exchange). Comparators that would
+// touch a wire >= n are never emitted, which is the same as padding with +infinity.
+// Each comparator is then scheduled into the earliest layer its two wires allow.
+// For n <= 8 the comparator count is the proven optimum; up to 16 it stays
+// within three comparators of the best known networks.
+constexpr SortingNetwork buildSortingNetwork(int n) {
+    SortingNetwork net;
+    int wireLayer[MAX_NETWORK_SIZE] = {};
+    for (int p = 1; p < n; p *= 2) {
+        for (int k = p; k >= 1; k /= 2) {
+            for (int j = k % p; j <= n - 1 - k; j += 2 * k) {
+                for (int i = 0; i <= std::min(k - 1, n - j - k - 1); i++) {
+                    if ((i + j) / (p * 2) != (i + j + k) / (p * 2)) continue;
+                    Comparator c;
+                    c.lo = i + j;
+                    c.hi = i + j + k;
+                    c.layer = std::max(wireLayer[c.lo], wireLayer[c.hi]);
+                    wireLayer[c.lo] = wireLayer[c.hi] = c.layer + 1;
+                    net.depth = std::max(net.depth, c.layer + 1);
+                    net.comparators[net.size++] = c;
+                }
+            }
+        }
+    }
+    // Stable sort by layer; comparators in one layer never share a wire.
+    for (int a = 1; a < net.size; a++) {
+        Comparator c = net.comparators[a];
+        int b = a - 1;
+        while (b >= 0 && net.comparators[b].layer > c.layer) {
+            net.comparators[b + 1] = net.comparators[b];
+            b--;
+        }
+        net.comparators[b + 1] = c;
+    }
+    return net;
+}
+
+template <int N>
+constexpr SortingNetwork SORTING_NETWORK = buildSortingNetwork(N);
+
+// Branchless compare-exchange: compiles to min/max (cmov) instead of a jump.
+inline void compareExchange(int* a, int lo, int hi) {
+    int x = a[lo], y = a[hi];
+    a[lo] = x < y ? x : y;
+    a[hi] = x < y ? y : x;
+}
+
+// Fully unrolled at compile time: one compareExchange per comparator.
+template <int N, size_t... I>
+inline void runSortingNetwork(int* a, index_sequence<I...>) {
+    (compareExchange(a, SORTING_NETWORK<N>.comparators[I].lo, SORTING_NETWORK<N>.comparators[I].hi), ...);
+}
+
+template <int N>
+void networkSort(int* a) {
+    runSortingNetwork<N>(a, make_index_sequence<SORTING_NETWORK<N>.size>{});
+}
+
+template <size_t... N>
+constexpr array<void (*)(int*), sizeof...(N)> makeNetworkKernels(index_sequence<N...>) {
+    return {{&networkSort<(int)N>...}};
+}
+
+template <size_t... N>
+constexpr array<SortingNetwork, sizeof...(N)> makeNetworkTable(index_sequence<N...>) {
+    return {{SORTING_NETWORK<(int)N>...}};
+}
+
+const auto NETWORK_KERNELS = makeNetworkKernels(make_index_sequence<MAX_NETWORK_SIZE + 1>{});
+const auto NETWORK_TABLE = makeNetworkTable(make_index_sequence<MAX_NETWORK_SIZE + 1>{});
+
+// --- Vectorized bitonic networks (AVX2: 8 lanes, NEON: 4 lanes) ---
+// x86-64 builds compile the AVX2 kernels with a target attribute and pick
+// them at run time, so they need no extra flags. NEON is always there on arm64.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAS_SIMD_BITONIC 1
+#define SIMD_TARGET __attribute__((target("avx2")))
+const bool SIMD_SUPPORTED = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+struct SimdLanes {
+    using Reg = __m256i;
+    static const int LANES = 8;
+    SIMD_TARGET static Reg load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    SIMD_TARGET static void store(int* p, Reg v) { _mm256_storeu_si256((__m256i*)p, v); }
+    SIMD_TARGET static Reg vmin(Reg a, Reg b) { return _mm256_min_epi32(a, b); }
+    SIMD_TARGET static Reg vmax(Reg a, Reg b) { return _mm256_max_epi32(a, b); }
+    // Lane i receives lane i ^ j.
+    SIMD_TARGET static Reg partner(Reg v, int j) {
+        __m256i idx = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(j));
+        return _mm256_permutevar8x32_epi32(v, idx);
+    }
+    // Lane i comes from b when bit i of mask is set, else from a.
+    SIMD_TARGET static Reg select(Reg a, Reg b, int mask) {
+        __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bit), bit);
+        return _mm256_blendv_epi8(a, b, m);
+    }
+};
+#elif defined(__ARM_NEON)
+#define HAS_SIMD_BITONIC 1
+#define SIMD_TARGET
+const bool SIMD_SUPPORTED = true;
+struct SimdLanes {
+    using Reg = int32x4_t;
+    static const int LANES = 4;
+    static Reg load(const int* p) { return vld1q_s32(p); }
+    static void store(int* p, Reg v) { vst1q_s32(p, v); }
+    static Reg vmin(Reg a, Reg b) { return vminq_s32(a, b); }
+    static Reg vmax(Reg a, Reg b) { return vmaxq_s32(a, b); }
+    static Reg partner(Reg v, int j) { return j == 1 ? vrev64q_s32(v) : vextq_s32(v, v, 2); }
+    static Reg select(Reg a, Reg b, int mask) {
+        const int32_t bits[4] = {1, 2, 4, 8};
+        int32x4_t bit = vld1q_s32(bits);
+        return vbslq_s32(vtstq_s32(vdupq_n_s32(mask), bit), b, a);
+    }
+};
+#endif
+
+#ifdef HAS_SIMD_BITONIC
+// Bitonic sort of REGS * LANES values held in registers. Strides >= LANES
+// compare whole registers; smaller strides shuffle lanes inside a register.
+template <int REGS>
+SIMD_TARGET void bitonicSortSimd(int* a) {
+    using S = SimdLanes;
+    const int L = S::LANES;
+    const int n = REGS * L;
+    S::Reg r[REGS];
+    for (int x = 0; x < REGS; x++) r[x] = S::load(a + x * L);
+
+    for (int k = 2; k <= n; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+            if (j >= L) {
+                for (int x = 0; x < REGS; x++) {
+                    int y = x ^ (j / L);
+                    if (y < x) continue;
+                    S::Reg lo = S::vmin(r[x], r[y]);
+                    S::Reg hi = S::vmax(r[x], r[y]);
+                    bool ascending = ((x * L) & k) == 0;
+                    r[x] = ascending ? lo : hi;
+                    r[y] = ascending ? hi : lo;
+                }
+            } else {
+                for (int x = 0; x < REGS; x++) {
+                    S::Reg p = S::partner(r[x], j);
+                    S::Reg lo = S::vmin(r[x], p);
+                    S::Reg hi = S::vmax(r[x], p);
+                    int takeMax = 0;
+                    for (int lane = 0; lane < L; lane++) {
+                        int i = x * L + lane;
+                        bool ascending = (i & k) == 0;
+                        bool lower = (i & j) == 0;
+                        if (ascending != lower) takeMax |= 1 << lane;
+                    }
+                    r[x] = S::select(lo, hi, takeMax);
+                }
+            }
+        }
+    }
+    for (int x = 0; x < REGS; x++) S::store(a + x * L, r[x]);
+}
+#endif
+
+// Base case shared by the kernels below. Sorts up to MAX_NETWORK_SIZE values
+// without data-dependent branches.
+void sortSmall(int* a, int n) {
+    if (n <= 1) return;
+#ifdef HAS_SIMD_BITONIC
+    if (n > 4 && SIMD_SUPPORTED) {
+        int buf[MAX_NETWORK_SIZE];
+        int padded = n <= 8 ? 8 : 16;
+        for (int i = 0; i < padded; i++) buf[i] = i < n ? a[i] : INT_MAX;
+        if (padded == 8) bitonicSortSimd<8 / SimdLanes::LANES>(buf);
+        else bitonicSortSimd<16 / SimdLanes::LANES>(buf);
+        for (int i = 0; i < n; i++) a[i] = buf[i];
+        return;
+    }
+#endif
+    NETWORK_KERNELS[n](a);
+}
+
+// --- Keys and comparators ---
+// The headless kernels sort any random access range. Elements are ordered by
+// less(key(a), key(b)), so records can be sorted by one of their fields; the
+// defaults sort plain values ascending.
+struct Identity {
+    template <class T>
+    constexpr T&& operator()(T&& v) const { return std::forward<T>(v); }
+};
+
+template <class Key = Identity, class Less = std::less<>>
+struct KeyLess {
+    Key key;
+    Less less;
+
+    template <class A, class B>
+    bool operator()(const A& a, const B& b) const { return less(key(a), key(b)); }
+};
+
+using DefaultOrder = KeyLess<>;
+
+// Plain ints in ascending order can use the sorting networks and SIMD kernels
+template <class It, class Cmp>
+constexpr bool IS_PLAIN_INTS = is_same_v<It, int*> && is_same_v<Cmp, DefaultOrder>;
+
+// --- Headless kernels using the network as their base case ---
+template <class It, class Cmp = DefaultOrder>
+void insertionSortKernel(It a, int n, Cmp cmp = {}) {
+    for (int i = 1; i < n; i++) {
+        auto key = std::move(a[i]);
+        int j = i - 1;
+        while (j >= 0 && cmp(key, a[j])) { a[j + 1] = std::move(a[j]); j--; }
+        a[j + 1] = std::move(key);
+    }
+}
+
+// Base case of the kernels below: branchless networks for plain ints,
+// insertion sort for everything else
+template <class It, class Cmp>
+void smallSortKernel(It a, int n, Cmp cmp) {
+    if constexpr (IS_PLAIN_INTS<It, Cmp>) sortSmall(a, n);
+    else insertionSortKernel(a, n, cmp);
+}
+
+template <class It, class Cmp = DefaultOrder>
+void quickSortKernel(It a, int n, Cmp cmp = {}) {
+    while (n > MAX_NETWORK_SIZE) {
+        int mid = n / 2;
+        if (cmp(a[mid], a[0])) swap(a[mid], a[0]);
+        if (cmp(a[n - 1], a[0])) swap(a[n - 1], a[0]);
+        if (cmp(a[n - 1], a[mid])) swap(a[n - 1], a[mid]);
+        auto pivot = a[mid];
+
+        // Hoare partition: [0, j] <= pivot <= [j + 1, n)
+        int i = -1, j = n;
+        while (true) {
+            do i++; while (cmp(a[i], pivot));
+            do j--; while (cmp(pivot, a[j]));
+            if (i >= j) break;
+            swap(a[i], a[j]);
+        }
+        int leftSize = j + 1;
+        // Recurse into the smaller side so the stack stays O(log n)
+        if (leftSize < n - leftSize) {
+            quickSortKernel(a, leftSize, cmp);
+            a += leftSize; n -= leftSize;
+        } else {
+            quickSortKernel(a + leftSize, n - leftSize, cmp);
+            n = leftSize;
+        }
+    }
+    smallSortKernel(a, n, cmp);
+}
+
+// tmp: room for n elements
+template <class It, class Buf, class Cmp = DefaultOrder>
+void mergeSortKernel(It a, Buf tmp, int n, Cmp cmp = {}) {
+    if (n <= MAX_NETWORK_SIZE) { smallSortKernel(a, n, cmp); return; }
+    int m = n / 2;
+    mergeSortKernel(a, tmp, m, cmp);
+    mergeSortKernel(a + m, tmp + m, n - m, cmp);
+    if (!cmp(a[m], a[m - 1])) return; // Already in order
+    std::merge(std::make_move_iterator(a), std::make_move_iterator(a + m),
+               std::make_move_iterator(a + m), std::make_move_iterator(a + n), tmp, cmp);
+    std::move(tmp, tmp + n, a);
+}
+
+// MSD radix sort on bytes; the sign bit is flipped so negatives come first.
+inline unsigned radixDigit(int v, int shift) {
+    return (((unsigned)v ^ 0x80000000u) >> shift) & 0xFF;
+}
+
+void radixSortKernel(int* a, int* tmp, int n, int shift = 24) {
+    if (shift < 0) return; // All keys in this bucket are equal
+    if (n <= MAX_NETWORK_SIZE) { sortSmall(a, n); return; }
+    int count[257] = {};
+    for (int i = 0; i < n; i++) count[radixDigit(a[i], shift) + 1]++;
+    for (int d = 0; d < 256; d++) count[d + 1] += count[d];
+    int start[257];
+    std::copy(count, count + 257, start);
+    for (int i = 0; i < n; i++) tmp[count[radixDigit(a[i], shift)]++] = a[i];
+    std::copy(tmp, tmp + n, a);
+    for (int d = 0; d < 256; d++) {
+        int len = start[d + 1] - start[d];
+        if (len > 1) radixSortKernel(a + start[d], tmp + start[d], len, shift - 8);
+    }
+}
+
+// --- Radix path for other arithmetic keys ---
+// Maps a key to an unsigned integer with the same order: signed integers get
+// their sign bit flipped, negative floats all their bits. NaNs end up before
+// or after everything depending on their sign, and -0.0 before 0.0.
+template <class K>
+auto radixKey(K k) {
+    if constexpr (is_floating_point_v<K>) {
+        using U = conditional_t<sizeof(K) == 4, uint32_t, uint64_t>;
+        U bits;
+        memcpy(&bits, &k, sizeof(bits));
+        U sign = U(1) << (sizeof(U) * 8 - 1);
+        return bits & sign ? U(~bits) : U(bits | sign);
+    } else if constexpr (is_signed_v<K>) {
+        using U = make_unsigned_t<K>;
+        return U(U(k) ^ (U(1) << (sizeof(U) * 8 - 1)));
+    } else {
+        return k;
+    }
+}
+
+template <class K>
+constexpr bool IS_RADIX_KEY = is_integral_v<K> || is_same_v<K, float> || is_same_v<K, double>;
+
+// Stable LSD radix sort on the bytes of key(element). Passes over a byte that
+// all keys share are skipped, so small keys in wide types stay cheap.
+template <class It, class Key = Identity>
+void radixSortByKey(It first, It last, Key key = {}) {
+    using V = typename iterator_traits<It>::value_type;
+    using K = decay_t<decltype(key(*first))>;
+    static_assert(IS_RADIX_KEY<K>, "radixSortByKey needs an integer, float or double key");
+    size_t n = last - first;
+    if (n < 2) return;
+
+    // Histograms of every byte in one read of the input
+    const int BYTES = sizeof(K);
+    vector<array<size_t, 257>> count(BYTES);
+    for (It p = first; p != last; ++p) {
+        auto k = radixKey(key(*p));
+        for (int b = 0; b < BYTES; b++) count[b][((k >> (b * 8)) & 0xFF) + 1]++;
+    }
+
+    vector<V> from(std::make_move_iterator(first), std::make_move_iterator(last));
+    vector<V> to(n);
+    for (int b = 0; b < BYTES; b++) {
+        auto& c = count[b];
+        if (std::find(c.begin() + 1, c.end(), n) != c.end()) continue; // One bucket holds everything
+        for (int d = 0; d < 256; d++) c[d + 1] += c[d];
+        for (V& v : from) to[c[(radixKey(key(v)) >> (b * 8)) & 0xFF]++] = std::move(v);
+        from.swap(to);
+    }
+    std::move(from.begin(), from.end(), first);
+}
+
+// --- Wiring diagram ---
+// layersDone: how many layers the values have already passed through
+void drawNetworkState(RenderTarget& target, const Font& font, const vector<int>& arr,
+                      const string& title, int layersDone, const HighlightBuffer& highlights = NO_HIGHLIGHTS) {
+    target.clear(Color::Black);
+    int n = arr.size();
+
+    if (n > MAX_NETWORK_SIZE) {
+        Text msg(font, "Sorting networks are limited to " + to_string(MAX_NETWORK_SIZE) + " values");
+        msg.setCharacterSize(20);
+        msg.setFillColor(Color::White);
+        msg.setPosition({(WINDOW_WIDTH - msg.getLocalBounds().size.x) / 2, WINDOW_HEIGHT / 2.0f});
+        target.draw(msg);
+        return;
+    }
+
+    const SortingNetwork& net = NETWORK_TABLE[n];
+    string heading = title.empty() ? "Sorting Network" : title;
+    heading += "  (" + to_string(net.size) + " comparators, depth " + to_string(net.depth) + ")";
+    Text titleText(font, heading);
+    titleText.setCharacterSize(22);
+    titleText.setFillColor(Color::White);
+    titleText.setPosition({(WINDOW_WIDTH - titleText.getLocalBounds().size.x) / 2, 100});
+    target.draw(titleText);
+
+    float top = 160, bottom = WINDOW_HEIGHT - 50;
+    float left = 180, right = WINDOW_WIDTH - 60;
+    float wireGap = n > 1 ? (bottom - top) / (n - 1) : 0;
+    float layerWidth = net.depth > 0 ? (right - left) / net.depth : 0;
+
+    // Wires
+    for (int w = 0; w < n; w++) {
+        Vertex line[2];
+        line[0].position = {left - 20, top + w * wireGap};
+        line[1].position = {right, top + w * wireGap};
+        line[0].color = line[1].color = Color(120, 120, 120);
+        target.draw(line, 2, sf::PrimitiveType::Lines);
+    }
+
+    // Comparators, with overlapping ones in a layer pushed into separate columns
+    int c = 0;
+    for (int layer = 0; layer < net.depth; layer++) {
+        int first = c;
+        while (c < net.size && net.comparators[c].layer == layer) c++;
+
+        vector<int> column(c - first, 0);
+        int columns = 1;
+        for (int a = first; a < c; a++) {
+            int col = 0;
+            for (int b = first; b < a; b++) {
+                bool overlaps = net.comparators[a].lo <= net.comparators[b].hi && net.comparators[b].lo <= net.comparators[a].hi;
+                if (overlaps && column[b - first] >= col) col = column[b - first] + 1;
+            }
+            column[a - first] = col;
+            columns = std::max(columns, col + 1);
+        }
+
+        for (int a = first; a < c; a++) {
+            const Comparator& cmp = net.comparators[a];
+            float x = left + layer * layerWidth + (column[a - first] + 1) * layerWidth / (columns + 1);
+            Color color = highlightColor(highlights.at(a), Color(200, 200, 200));
+
+            Vertex line[2];
+            line[0].position = {x, top + cmp.lo * wireGap};
+            line[1].position = {x, top + cmp.hi * wireGap};
+            line[0].color = line[1].color = color;
+            target.draw(line, 2, sf::PrimitiveType::Lines);
+
+            for (int w : {cmp.lo, cmp.hi}) {
+                CircleShape dot(4);
+                dot.setPosition({x - 4, top + w * wireGap - 4});
+                dot.setFillColor(color);
+                target.draw(dot);
+            }
+        }
+    }
+
+    // Values travel along the wires, sitting just after the last finished layer
+    float boxW = 44, boxH = std::min(24.0f, std::max(wireGap - 4, 12.0f));
+    float valueX = left + layersDone * layerWidth - boxW - 10;
+    if (layersDone == 0) valueX = left - 20 - boxW - 10;
+    for (int w = 0; w < n; w++) {
+        RectangleShape box({boxW, boxH});
+        box.setPosition({valueX, top + w * wireGap - boxH / 2});
+        box.setFillColor(Color(50, 50, 150));
+        box.setOutlineColor(layersDone == net.depth ? Color::Green : Color(200, 200, 200));
+        box.setOutlineThickness(1);
+        target.draw(box);
+
+        Text valText(font, to_string(arr[w]));
+        valText.setCharacterSize(14);
+        valText.setFillColor(Color::White);
+        FloatRect textBounds = valText.getLocalBounds();
+        valText.setPosition({
+            valueX + (boxW - textBounds.size.x) / 2 - textBounds.position.x,
+            top + w * wireGap - textBounds.size.y / 2 - textBounds.position.y
+        });
+        target.draw(valText);
+    }
+
+}
+
+// Each step fires one whole layer at once, the way the hardware would.
+// Highlights are indexed by comparator. Only called for up to MAX_NETWORK_SIZE values.
+void networkSort_anim(Tracer& t, vector<int>& arr) {
+    const SortingNetwork& net = NETWORK_TABLE[arr.size()];
+
+    int c = 0;
+    for (int layer = 0; layer < net.depth; layer++) {
+        t.clearMarks();
+        int first = c;
+        while (c < net.size && net.comparators[c].layer == layer) t.mark(c++, HL_COMPARE);
+        t.layer(layer);
+        t.step();
+
+        for (int k = first; k < c; k++) {
+            const Comparator& cmp = net.comparators[k];
+            bool swaps = arr[cmp.lo] > arr[cmp.hi];
+            compareExchange(arr.data(), cmp.lo, cmp.hi);
+            t.compared();
+            if (swaps) { t.swapped(); t.set(cmp.lo, arr[cmp.lo]); t.set(cmp.hi, arr[cmp.hi]); }
+            t.mark(k, swaps ? HL_SWAP : HL_SORTED);
+        }
+        t.layer(layer + 1);
+        t.step();
+    }
+}
+
+
+// ################################################################
+// --- ADAPTIVE SORTS (TimSort, pdqsort) ---
+// ################################################################
+
+// These are written once and take a trace policy. NoTrace compiles down to
+// the plain kernels used by the benchmark, ArrayTrace turns the same code
+// into the bar animation.
+struct NoTrace {
+    void compared(int = 1) {}
+    template <class It> void swapped(It, It) {}
+    template <class It> void moved(It) {}
+    template <class It> void mark(It, Highlight) {}
+    void clearMarks() {}
+    void title(NodeTitle) {}
+    void step(int = 1) {}
+    void allocated(long long) {}
+};
+
+// project turns an element into its bar height, so any element type can be shown
+template <class It, class Proj = Identity>
+struct ArrayTrace {
+    Tracer& t;
+    It origin; // Positions are reported relative to this
+    Proj project;
+
+    int at(It p) const { return p - origin; }
+    int height(It p) const { return (int)project(*p); }
+    void compared(int n = 1) { t.compared(n); }
+    void swapped(It x, It y) { t.swapped(); t.set(at(x), height(x)); t.set(at(y), height(y)); }
+    void moved(It p) { t.swapped(); t.set(at(p), height(p)); }
+    void mark(It p, Highlight h) { t.mark(at(p), h); }
+    void clearMarks() { t.clearMarks(); }
+    void title(NodeTitle title) { t.title(0, title); }
+    void step(int cost = 1) { t.step(cost); }
+    void allocated(long long bytes) { t.allocated(bytes); }
+};
+
+template <class A, class B, class Cmp, class Trace>
+inline bool tracedLess(const A& x, const B& y, Cmp& cmp, Trace& tr) {
+    tr.compared();
+    return cmp(x, y);
+}
+
+template <class It, class Trace>
+inline void tracedSwap(It x, It y, Trace& tr) {
+    std::iter_swap(x, y);
+    tr.swapped(x, y);
+}
+
+// --- TimSort ---
+// Uses the runs already in the input: descending runs are reversed, short
+// ones are extended to minrun with binary insertion sort, and the runs are
+// merged from a stack whose lengths shrink at least like Fibonacci numbers.
+// A merge switches to galloping (exponential search, then block moves) once
+// one side keeps winning, so presorted data merges in O(log n) per block.
+// Stable.
+const int TIM_MIN_MERGE = 64;
+const int TIM_MIN_GALLOP = 7;
+
+struct TimRun { int start, length; };
+
+// Between 32 and 64, chosen so that n / minrun is a power of two or just below one
+int timMinRun(int n) {
+    int r = 0;
+    while (n >= TIM_MIN_MERGE) { r |= n & 1; n >>= 1; }
+    return n + r;
+}
+
+// First index in [lo, hi) whose element does not come before key. With
+// right, elements equal to key come before it (upper bound), else not.
+template <class It, class T, class Cmp, class Trace>
+int timSearch(It a, int lo, int hi, const T& key, bool right, Cmp& cmp, Trace& tr) {
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+        tr.compared();
+        if (right ? !cmp(key, a[m]) : cmp(a[m], key)) lo = m + 1;
+        else hi = m;
+    }
+    return lo;
+}
+
+// timSearch over [0, n), but probing 1, 2, 4, ... elements in first, so it
+// costs O(log k) when the answer is k
+template <class It, class T, class Cmp, class Trace>
+int timGallop(It a, int n, const T& key, bool right, Cmp& cmp, Trace& tr) {
+    int known = 0; // a[0, known) come before key
+    for (int stride = 1; known < n; stride = std::min(stride * 2, n)) {
+        int i = std::min(n - known, stride) + known - 1;
+        tr.compared();
+        if (!(right ? !cmp(key, a[i]) : cmp(a[i], key))) return timSearch(a, known, i, key, right, cmp, tr);
+        known = i + 1;
+    }
+    return n;
+}
+
+// Which neighboring runs to merge next, or -1 if the stack is in shape.
+// Checks the top three lengths and the one below them (the corrected rule).
+// At the end of the input everything is merged.
+int timMergeIndex(const vector<TimRun>& runs, bool all) {
+    int m = (int)runs.size() - 2;
+    if (m < 0) return -1;
+    auto len = [&](int i) { return runs[i].length; };
+    if (all || (m > 0 && len(m - 1) <= len(m) + len(m + 1)) || (m > 1 && len(m - 2) <= len(m - 1) + len(m))) {
+        return m > 0 && len(m - 1) < len(m + 1) ? m - 1 : m;
+    }
+    return len(m) <= len(m + 1) ? m : -1;
+}
+
+// Merges the runs a[0, n1) and a[n1, n1 + n2). Only the part of the left run
+// that actually moves is moved out to tmp.
+template <class It, class V, class Cmp, class Trace>
+void timMerge(It a, int n1, int n2, vector<V>& tmp, int& minGallop, Cmp& cmp, Trace& tr) {
+    tr.title(TITLE_MERGING);
+    tr.clearMarks();
+    tr.mark(a, HL_BOUNDARY); tr.mark(a + (n1 - 1), HL_BOUNDARY);
+    tr.mark(a + n1, HL_BOUNDARY); tr.mark(a + (n1 + n2 - 1), HL_BOUNDARY);
+    tr.step();
+
+    // Left elements no bigger than the right run's first, and right elements
+    // no smaller than the left run's last, are already in place
+    int skip = timGallop(a, n1, a[n1], true, cmp, tr);
+    a += skip; n1 -= skip;
+    if (n1 == 0) return;
+    n2 = timGallop(a + n1, n2, a[n1 - 1], false, cmp, tr);
+    if (n2 == 0) return;
+
+    size_t capacity = tmp.capacity();
+    tmp.assign(std::make_move_iterator(a), std::make_move_iterator(a + n1));
+    if (tmp.capacity() != capacity) tr.allocated((long long)(tmp.capacity() - capacity) * sizeof(V));
+    auto left = tmp.begin();
+    auto leftEnd = tmp.end();
+    It right = a + n1;
+    It rightEnd = right + n2;
+    It out = a; // Always behind right
+    auto takeLeft = [&]() { *out = std::move(*left++); tr.moved(out); ++out; };
+    auto takeRight = [&]() { *out = std::move(*right++); tr.moved(out); ++out; };
+
+    while (left < leftEnd && right < rightEnd) {
+        // One element at a time until one side has won minGallop times in a row
+        int leftWins = 0, rightWins = 0;
+        while (left < leftEnd && right < rightEnd && std::max(leftWins, rightWins) < minGallop) {
+            tr.clearMarks(); tr.mark(right, HL_COMPARE); tr.mark(out, HL_SWAP);
+            if (tracedLess(*right, *left, cmp, tr)) { takeRight(); rightWins++; leftWins = 0; }
+            else { takeLeft(); leftWins++; rightWins = 0; }
+            tr.step();
+        }
+        if (left == leftEnd || right == rightEnd) break;
+
+        // Galloping: find how far each side wins and move that block at once.
+        // Stays easier to enter while it keeps paying off.
+        tr.title(TITLE_GALLOPING);
+        while (true) {
+            tr.clearMarks();
+            int c = timGallop(left, leftEnd - left, *right, true, cmp, tr);
+            for (int k = 0; k < c; k++) { tr.mark(out, HL_PIVOT); takeLeft(); }
+            if (left == leftEnd) break;
+            tr.mark(out, HL_SWAP); takeRight();
+            if (right == rightEnd) break;
+            int d = timGallop(right, rightEnd - right, *left, false, cmp, tr);
+            for (int k = 0; k < d; k++) { tr.mark(out, HL_PIVOT); takeRight(); }
+            if (right == rightEnd) break;
+            tr.mark(out, HL_SWAP); takeLeft();
+            if (left == leftEnd) break;
+            tr.step();
+            if (c < TIM_MIN_GALLOP && d < TIM_MIN_GALLOP) { minGallop++; break; }
+            minGallop = std::max(1, minGallop - 1);
+        }
+        tr.title(TITLE_MERGING);
+    }
+    // Whatever is left of the right run is already where it belongs
+    while (left < leftEnd) takeLeft();
+    tr.clearMarks();
+    tr.step();
+}
+
+template <class It, class Cmp, class Trace>
+void timSort(It first, It last, Cmp cmp, Trace& tr) {
+    using V = typename iterator_traits<It>::value_type;
+    int n = last - first;
+    int minRun = timMinRun(n);
+    int minGallop = TIM_MIN_GALLOP;
+    vector<V> tmp;
+    vector<TimRun> runs;
+    auto mergeAt = [&](int i) {
+        timMerge(first + runs[i].start, runs[i].length, runs[i + 1].length, tmp, minGallop, cmp, tr);
+        runs[i].length += runs[i + 1].length;
+        runs.erase(runs.begin() + i + 1);
+    };
+
+    for (int lo = 0; lo < n; ) {
+        tr.title(TITLE_FINDING_RUNS);
+        It run = first + lo;
+        int len = std::min(2, n - lo);
+        if (len == 2 && tracedLess(run[1], run[0], cmp, tr)) {
+            // Strictly descending, so reversing it keeps equal elements in order
+            while (lo + len < n && tracedLess(run[len], run[len - 1], cmp, tr)) len++;
+            for (int i = 0, j = len - 1; i < j; i++, j--) tracedSwap(run + i, run + j, tr);
+        } else {
+            while (lo + len < n && !tracedLess(run[len], run[len - 1], cmp, tr)) len++;
+        }
+
+        if (len < minRun) {
+            int forced = std::min(minRun, n - lo);
+            tr.title(TITLE_EXTENDING_RUN);
+            for (int i = len; i < forced; i++) {
+                int pos = timSearch(run, 0, i, run[i], true, cmp, tr);
+                tr.clearMarks(); tr.mark(run + i, HL_COMPARE); tr.mark(run + pos, HL_PIVOT);
+                tr.step();
+                if (pos == i) continue;
+                V v = std::move(run[i]);
+                for (int k = i; k > pos; k--) { run[k] = std::move(run[k - 1]); tr.moved(run + k); }
+                run[pos] = std::move(v); tr.moved(run + pos);
+            }
+            len = forced;
+        }
+
+        tr.clearMarks();
+        for (int i = 0; i < len; i++) tr.mark(run + i, HL_BOUNDARY);
+        tr.step(2);
+        runs.push_back({lo, len});
+        lo += len;
+        for (int i; (i = timMergeIndex(runs, false)) >= 0; ) mergeAt(i);
+    }
+    for (int i; (i = timMergeIndex(runs, true)) >= 0; ) mergeAt(i);
+    tr.allocated(-(long long)(tmp.capacity() * sizeof(V)));
+}
+
+// --- Pattern-defeating quicksort (pdqsort) ---
+// A quick sort that adapts to its input:
+// - The pivot is a median of 3, or of three medians of 3 for big ranges.
+// - Partitioning is branchless. The offsets of misplaced elements are
+//   collected for a block of 64 per side and swapped afterwards, so the
+//   comparisons never turn into mispredicted branches.
+// - A partition that swapped nothing hints at sorted input, so both sides
+//   first get an insertion sort that gives up after a few moves.
+// - A pivot equal to the element before the range puts all its copies on
+//   the left, where they are done, so many duplicates cost O(n).
+// - A badly unbalanced partition swaps a few elements around to break the
+//   pattern; after log2(n) of those the range falls back to heapsort.
+const int PDQ_INSERTION_SORT = 24;
+const int PDQ_NINTHER = 128;
+const int PDQ_PARTIAL_INSERTION_LIMIT = 8;
+const int PDQ_BLOCK = 64;
+
+template <class It, class Cmp, class Trace>
+inline void pdqSort2(It x, It y, Cmp& cmp, Trace& tr) {
+    if (tracedLess(*y, *x, cmp, tr)) tracedSwap(x, y, tr);
+}
+
+template <class It, class Cmp, class Trace>
+inline void pdqSort3(It x, It y, It z, Cmp& cmp, Trace& tr) {
+    pdqSort2(x, y, cmp, tr);
+    pdqSort2(y, z, cmp, tr);
+    pdqSort2(x, y, cmp, tr);
+}
+
+// Unguarded when a[-1] is known to be no bigger than anything in a[0, n).
+// With limit, gives up once more than that many elements have moved.
+template <class It, class Cmp, class Trace>
+bool pdqInsertionSort(It a, int n, bool guarded, Cmp& cmp, Trace& tr, int limit = INT_MAX) {
+    int moves = 0;
+    for (int i = 1; i < n; i++) {
+        if (!tracedLess(a[i], a[i - 1], cmp, tr)) continue;
+        auto v = std::move(a[i]);
+        int j = i;
+        do { a[j] = std::move(a[j - 1]); tr.moved(a + j); j--; }
+        while ((!guarded || j > 0) && tracedLess(v, a[j - 1], cmp, tr));
+        a[j] = std::move(v); tr.moved(a + j);
+        tr.clearMarks(); tr.mark(a + j, HL_SWAP);
+        tr.step();
+        moves += i - j;
+        if (moves > limit) return false;
+    }
+    return true;
+}
+
+// Partitions around a[0] into [< pivot] pivot [>= pivot]. Returns the pivot's
+// position and whether the range was already partitioned.
+template <class It, class Cmp, class Trace>
+pair<int, bool> pdqPartitionRight(It a, int n, Cmp& cmp, Trace& tr) {
+    auto pivot = std::move(a[0]);
+    It first = a + 1;
+    It last = a + n;
+    tr.title(TITLE_PARTITION);
+    tr.clearMarks(); tr.mark(a, HL_PIVOT);
+    tr.step();
+
+    // The median of 3 left an element >= pivot at the end, so no bound is needed
+    while (tracedLess(*first, pivot, cmp, tr)) ++first;
+    if (first - 1 == a) while (first < last && !tracedLess(*--last, pivot, cmp, tr)) {}
+    else while (!tracedLess(*--last, pivot, cmp, tr)) {}
+
+    bool alreadyPartitioned = first >= last;
+    if (!alreadyPartitioned) { tracedSwap(first, last, tr); ++first; }
+
+    // Offsets of the elements on the wrong side, one block per side at a time
+    alignas(64) unsigned char offsetsL[PDQ_BLOCK];
+    alignas(64) unsigned char offsetsR[PDQ_BLOCK];
+    int numL = 0, numR = 0, startL = 0, startR = 0;
+    auto scanL = [&](int size) {
+        startL = 0;
+        for (int i = 0; i < size; i++) { offsetsL[numL] = i; numL += !cmp(first[i], pivot); }
+        tr.compared(size);
+    };
+    auto scanR = [&](int size) {
+        startR = 0;
+        for (int i = 1; i <= size; i++) { offsetsR[numR] = i; numR += cmp(last[-i], pivot); }
+        tr.compared(size);
+    };
+    auto swapOffsets = [&]() {
+        int num = std::min(numL, numR);
+        tr.clearMarks();
+        for (int i = 0; i < num; i++) {
+            It l = first + offsetsL[startL + i];
+            It r = last - offsetsR[startR + i];
+            tracedSwap(l, r, tr);
+            tr.mark(l, HL_SWAP); tr.mark(r, HL_SWAP);
+        }
+        tr.step();
+        numL -= num; numR -= num;
+        startL += num; startR += num;
+    };
+
+    while (last - first > 2 * PDQ_BLOCK) {
+        if (numL == 0) scanL(PDQ_BLOCK);
+        if (numR == 0) scanR(PDQ_BLOCK);
+        swapOffsets();
+        if (numL == 0) first += PDQ_BLOCK;
+        if (numR == 0) last -= PDQ_BLOCK;
+    }
+
+    // Less than two blocks plus the leftovers of an unfinished one remain
+    int unknown = (last - first) - (numL || numR ? PDQ_BLOCK : 0);
+    int sizeL, sizeR;
+    if (numR) { sizeL = unknown; sizeR = PDQ_BLOCK; }
+    else if (numL) { sizeL = PDQ_BLOCK; sizeR = unknown; }
+    else { sizeL = unknown / 2; sizeR = unknown - sizeL; }
+    if (unknown && !numL) scanL(sizeL);
+    if (unknown && !numR) scanR(sizeR);
+    swapOffsets();
+    if (!numL) first += sizeL;
+    if (!numR) last -= sizeR;
+
+    // Only one side can still have misplaced elements; move them to the boundary
+    if (numL) {
+        while (numL--) tracedSwap(first + offsetsL[startL + numL], --last, tr);
+        first = last;
+    }
+    if (numR) {
+        while (numR--) { tracedSwap(last - offsetsR[startR + numR], first, tr); ++first; }
+        last = first;
+    }
+
+    It pivotPos = first - 1;
+    a[0] = std::move(*pivotPos); tr.moved(a);
+    *pivotPos = std::move(pivot); tr.moved(pivotPos);
+    return {(int)(pivotPos - a), alreadyPartitioned};
+}
+
+// For a pivot equal to the element before the range: partitions into
+// [<= pivot] pivot [> pivot] and returns the pivot's position
+template <class It, class Cmp, class Trace>
+int pdqPartitionLeft(It a, int n, Cmp& cmp, Trace& tr) {
+    auto pivot = std::move(a[0]);
+    It first = a;
+    It last = a + n;
+    while (tracedLess(pivot, *--last, cmp, tr)) {}
+    if (last + 1 == a + n) while (first < last && !tracedLess(pivot, *++first, cmp, tr)) {}
+    else while (!tracedLess(pivot, *++first, cmp, tr)) {}
+
+    while (first < last) {
+        tracedSwap(first, last, tr);
+        tr.clearMarks(); tr.mark(first, HL_SWAP); tr.mark(last, HL_SWAP);
+        tr.step();
+        while (tracedLess(pivot, *--last, cmp, tr)) {}
+        while (!tracedLess(pivot, *++first, cmp, tr)) {}
+    }
+
+    a[0] = std::move(*last); tr.moved(a);
+    *last = std::move(pivot); tr.moved(last);
+    return last - a;
+}
+
+template <class It, class Cmp, class Trace>
+void pdqHeapSort(It a, int n, Cmp& cmp, Trace& tr) {
+    tr.title(TITLE_HEAPSORT);
+    auto siftDown = [&](int root, int size) {
+        while (true) {
+            int child = 2 * root + 1;
+            if (child >= size) return;
+            if (child + 1 < size && tracedLess(a[child], a[child + 1], cmp, tr)) child++;
+            if (!tracedLess(a[root], a[child], cmp, tr)) return;
+            tracedSwap(a + root, a + child, tr);
+            tr.clearMarks(); tr.mark(a + root, HL_SWAP); tr.mark(a + child, HL_SWAP);
+            tr.step();
+            root = child;
+        }
+    };
+    for (int i = n / 2 - 1; i >= 0; i--) siftDown(i, n);
+    for (int end = n - 1; end > 0; end--) {
+        tracedSwap(a, a + end, tr);
+        siftDown(0, end);
+    }
+}
+
+template <class It, class Cmp, class Trace>
+void pdqSortLoop(It a, int n, int badAllowed, bool leftmost, Cmp& cmp, Trace& tr) {
+    while (true) {
+        if (n < PDQ_INSERTION_SORT) {
+            pdqInsertionSort(a, n, leftmost, cmp, tr);
+            return;
+        }
+
+        // Pivot to a[0]
+        int half = n / 2;
+        if (n > PDQ_NINTHER) {
+            pdqSort3(a, a + half, a + (n - 1), cmp, tr);
+            pdqSort3(a + 1, a + (half - 1), a + (n - 2), cmp, tr);
+            pdqSort3(a + 2, a + (half + 1), a + (n - 3), cmp, tr);
+            pdqSort3(a + (half - 1), a + half, a + (half + 1), cmp, tr);
+            tracedSwap(a, a + half, tr);
+        } else {
+            pdqSort3(a + half, a, a + (n - 1), cmp, tr);
+        }
+
+        if (!leftmost && !tracedLess(a[-1], a[0], cmp, tr)) {
+            int p = pdqPartitionLeft(a, n, cmp, tr);
+            a += p + 1;
+            n -= p + 1;
+            continue;
+        }
+
+        pair<int, bool> part = pdqPartitionRight(a, n, cmp, tr);
+        int p = part.first;
+        int sizeL = p, sizeR = n - p - 1;
+        if (sizeL < n / 8 || sizeR < n / 8) {
+            tr.title(TITLE_BAD_PARTITION);
+            if (--badAllowed == 0) {
+                pdqHeapSort(a, n, cmp, tr);
+                return;
+            }
+            tr.clearMarks();
+            auto shuffle = [&](It x, It y) { tracedSwap(x, y, tr); tr.mark(x, HL_BOUNDARY); tr.mark(y, HL_BOUNDARY); };
+            It pivotPos = a + p;
+            It end = a + n;
+            if (sizeL >= PDQ_INSERTION_SORT) {
+                shuffle(a, a + sizeL / 4);
+                shuffle(pivotPos - 1, pivotPos - sizeL / 4);
+                if (sizeL > PDQ_NINTHER) {
+                    shuffle(a + 1, a + (sizeL / 4 + 1));
+                    shuffle(a + 2, a + (sizeL / 4 + 2));
+                    shuffle(pivotPos - 2, pivotPos - (sizeL / 4 + 1));
+                    shuffle(pivotPos - 3, pivotPos - (sizeL / 4 + 2));
+                }
+            }
+            if (sizeR >= PDQ_INSERTION_SORT) {
+                shuffle(pivotPos + 1, pivotPos + (1 + sizeR / 4));
+                shuffle(end - 1, end - sizeR / 4);
+                if (sizeR > PDQ_NINTHER) {
+                    shuffle(pivotPos + 2, pivotPos + (2 + sizeR / 4));
+                    shuffle(pivotPos + 3, pivotPos + (3 + sizeR / 4));
+                    shuffle(end - 2, end - (1 + sizeR / 4));
+                    shuffle(end - 3, end - (2 + sizeR / 4));
+                }
+            }
+            tr.step(2);
+        } else if (part.second) {
+            tr.title(TITLE_PARTIAL_INSERTION);
+            if (pdqInsertionSort(a, sizeL, true, cmp, tr, PDQ_PARTIAL_INSERTION_LIMIT) &&
+                pdqInsertionSort(a + (p + 1), sizeR, true, cmp, tr, PDQ_PARTIAL_INSERTION_LIMIT)) return;
+        }
+
+        // Recurse into the left side, loop on the right one
+        pdqSortLoop(a, sizeL, badAllowed, leftmost, cmp, tr);
+        a += p + 1;
+        n = sizeR;
+        leftmost = false;
+    }
+}
+
+template <class It, class Cmp, class Trace>
+void pdqSort(It first, It last, Cmp cmp, Trace& tr) {
+    int n = last - first;
+    if (n < 2) return;
+    int log2n = 0;
+    while ((n >> log2n) > 1) log2n++;
+    pdqSortLoop(first, n, log2n, true, cmp, tr);
+}
+
+template <class It, class Cmp = DefaultOrder>
+void timSortKernel(It first, It last, Cmp cmp = {}) {
+    NoTrace tr;
+    timSort(first, last, cmp, tr);
+}
+
+template <class It, class Cmp = DefaultOrder>
+void pdqSortKernel(It first, It last, Cmp cmp = {}) {
+    NoTrace tr;
+    pdqSort(first, last, cmp, tr);
+}
+
+// --- Engine dispatch ---
+// Picks an engine at compile time: plain ints go to the MSD radix sort with
+// its network/SIMD base case, other integer and floating point keys of up to
+// four bytes in ascending order to the LSD radix sort, everything else to
+// pdqsort. Eight byte keys need eight passes over the data, which measured
+// slower than pdqsort on random input.
+template <class It, class Key = Identity, class Less = std::less<>>
+void sortEngine(It first, It last, Key key = {}, Less less = {}) {
+    using V = typename iterator_traits<It>::value_type;
+    using K = decay_t<decltype(key(*first))>;
+    constexpr bool ascending = is_same_v<Less, std::less<>> || is_same_v<Less, std::less<K>>;
+    constexpr bool contiguous = is_pointer_v<It> || is_same_v<It, typename vector<V>::iterator>;
+    if constexpr (is_same_v<V, int> && is_same_v<Key, Identity> && ascending && contiguous) {
+        int n = last - first;
+        if (n < 2) return;
+        vector<int> tmp(n);
+        radixSortKernel(&*first, tmp.data(), n);
+    } else if constexpr (IS_RADIX_KEY<K> && sizeof(K) <= 4 && ascending) {
+        radixSortByKey(first, last, key);
+    } else {
+        pdqSortKernel(first, last, KeyLess<Key, Less>{key, less});
+    }
+}
+
+// Bar animations run the same code reporting through the tracer. project
+// gives an element's bar height, so records or floats can be shown as well.
+template <class T, class Proj = Identity, class Cmp = DefaultOrder>
+void timSortTraced(Tracer& t, vector<T>& values, Proj project = {}, Cmp cmp = {}) {
+    ArrayTrace<typename vector<T>::iterator, Proj> tr{t, values.begin(), project};
+    timSort(values.begin(), values.end(), cmp, tr);
+}
+
+template <class T, class Proj = Identity, class Cmp = DefaultOrder>
+void pdqSortTraced(Tracer& t, vector<T>& values, Proj project = {}, Cmp cmp = {}) {
+    ArrayTrace<typename vector<T>::iterator, Proj> tr{t, values.begin(), project};
+    pdqSort(values.begin(), values.end(), cmp, tr);
+}
+
+void timSort_bars(Tracer& t, vector<int>& arr) { timSortTraced(t, arr); }
+void pdqSort_bars(Tracer& t, vector<int>& arr) { pdqSortTraced(t, arr); }
+
+
+// ################################################################
+// --- MODE 4: EXTERNAL MERGE SORT (files larger than RAM) ---
+// ################################################################
+
+// Input and output are raw native-endian int32 files.
+const size_t EXTERNAL_MEMORY_BYTES = 512u << 20; // Shared by all run-sorting threads
+const size_t EXTERNAL_MIN_RUN_INTS = 1u << 20;
+const size_t EXTERNAL_IO_INTS = 256u << 10;      // 1 MB per read/write buffer
+const int EXTERNAL_FAN_IN = 64;                  // Runs merged by one loser tree
+
+enum class TaskState { PENDING, ACTIVE, DONE };
+
+// One node of the external sort plan: either a run sorted in memory
+// (inputs empty) or a k-way merge of earlier tasks.
+struct ExternalTask {
+    vector<int> inputs;
+    string path;
+    size_t offset = 0; // First input value (runs only)
+    size_t count = 0;
+    atomic<TaskState> state{TaskState::PENDING};
+    atomic<size_t> progress{0}; // Values written so far
+    int minValue = 0, maxValue = 0; // Valid once state is DONE
+};
+
+struct ExternalPlan {
+    vector<ExternalTask> tasks; // Runs first, then merges in execution order
+    int runCount = 0;
+    unsigned threads = 1;
+    size_t totalValues = 0;
+    string error;
+};
+
+// Runs are split so every thread can hold one in memory at once. Merges take up
+// to EXTERNAL_FAN_IN consecutive outputs of the previous pass; the last task
+// always writes the final output file.
+void makeExternalPlan(ExternalPlan& plan, size_t totalValues, const string& output) {
+    plan.totalValues = totalValues;
+    plan.threads = std::max(1u, thread::hardware_concurrency());
+    size_t runInts = std::max(EXTERNAL_MIN_RUN_INTS, EXTERNAL_MEMORY_BYTES / sizeof(int) / plan.threads);
+    plan.runCount = std::max<size_t>(1, (totalValues + runInts - 1) / runInts);
+
+    vector<int> level;
+    size_t taskCount = plan.runCount;
+    for (size_t n = plan.runCount; n > 1; n = (n + EXTERNAL_FAN_IN - 1) / EXTERNAL_FAN_IN) {
+        taskCount += n / EXTERNAL_FAN_IN + (n % EXTERNAL_FAN_IN > 1 ? 1 : 0);
+    }
+    plan.tasks = vector<ExternalTask>(taskCount);
+
+    for (int r = 0; r < plan.runCount; r++) {
+        ExternalTask& t = plan.tasks[r];
+        t.offset = r * runInts;
+        t.count = std::min(runInts, totalValues - t.offset);
+        t.path = output + ".run" + to_string(r);
+        level.push_back(r);
+    }
+
+    int next = plan.runCount;
+    while (level.size() > 1) {
+        vector<int> upper;
+        for (size_t g = 0; g < level.size(); g += EXTERNAL_FAN_IN) {
+            size_t end = std::min(level.size(), g + EXTERNAL_FAN_IN);
+            if (end - g == 1) { upper.push_back(level[g]); continue; } // Carried to the next pass
+            ExternalTask& t = plan.tasks[next];
+            t.inputs.assign(level.begin() + g, level.begin() + end);
+            for (int in : t.inputs) t.count += plan.tasks[in].count;
+            t.path = output + ".run" + to_string(next);
+            upper.push_back(next++);
+        }
+        level = upper;
+    }
+    plan.tasks.back().path = output;
+}
+
+// Double-buffered reader: while the merge consumes one buffer the next one is
+// already being filled by an async read.
+struct RunReader {
+    ifstream in;
+    size_t remaining = 0; // Values not yet requested from disk
+    vector<int> front, back;
+    size_t frontCount = 0, pos = 0;
+    future<size_t> pending;
+
+    bool open(const string& path, size_t count) {
+        in.open(path, ios::binary);
+        remaining = count;
+        front.resize(EXTERNAL_IO_INTS);
+        back.resize(EXTERNAL_IO_INTS);
+        requestNext();
+        return (bool)in;
+    }
+
+    void requestNext() {
+        if (remaining == 0) return;
+        size_t n = std::min(remaining, EXTERNAL_IO_INTS);
+        remaining -= n;
+        pending = async(launch::async, [this, n]() {
+            in.read((char*)back.data(), n * sizeof(int));
+            return (size_t)in.gcount() / sizeof(int);
+        });
+    }
+
+    bool next(int& value) {
+        if (pos == frontCount) {
+            if (!pending.valid()) return false;
+            frontCount = pending.get();
+            if (frontCount == 0) return false;
+            swap(front, back);
+            pos = 0;
+            requestNext();
+        }
+        value = front[pos++];
+        return true;
+    }
+};
+
+// Double-buffered writer: a full buffer is flushed asynchronously while the
+// other one keeps filling.
+struct RunWriter {
+    ofstream out;
+    vector<int> front, back;
+    size_t frontCount = 0;
+    future<bool> pending;
+
+    bool open(const string& path) {
+        out.open(path, ios::binary | ios::trunc);
+        front.resize(EXTERNAL_IO_INTS);
+        back.resize(EXTERNAL_IO_INTS);
+        return (bool)out;
+    }
+
+    bool flush() {
+        if (pending.valid() && !pending.get()) return false;
+        swap(front, back);
+        size_t n = frontCount;
+        frontCount = 0;
+        pending = async(launch::async, [this, n]() {
+            out.write((const char*)back.data(), n * sizeof(int));
+            return (bool)out;
+        });
+        return true;
+    }
+
+    bool push(int value) {
+        front[frontCount++] = value;
+        return frontCount < front.size() || flush();
+    }
+
+    bool close() {
+        bool ok = frontCount == 0 || flush();
+        if (pending.valid()) ok = pending.get() && ok;
+        out.close();
+        return ok && (bool)out;
+    }
+};
+
+// Loser tree over k sources. node[0] holds the current winner and node[1..k-1]
+// the loser of each match, so replacing the winner replays only log2(k) matches.
+struct LoserTree {
+    int k = 0;
+    vector<long long> head; // Current value of each source, EXHAUSTED when empty
+    vector<int> node;
+    static constexpr long long EXHAUSTED = LLONG_MAX;
+
+    bool beats(int a, int b) const { return head[a] < head[b] || (head[a] == head[b] && a < b); }
+
+    void replay(int source) {
+        int winner = source;
+        for (int p = (source + k) / 2; p > 0; p /= 2) {
+            if (node[p] == -1) { node[p] = winner; return; } // Only while building
+            if (beats(node[p], winner)) swap(node[p], winner);
+        }
+        node[0] = winner;
+    }
+
+    void build() {
+        node.assign(std::max(k, 1), -1);
+        for (int s = k - 1; s >= 0; s--) replay(s);
+    }
+};
+
+bool runExternalMerge(ExternalPlan& plan, ExternalTask& task, const atomic<bool>& cancel) {
+    int k = task.inputs.size();
+    vector<unique_ptr<RunReader>> readers;
+    LoserTree tree;
+    tree.k = k;
+    tree.head.assign(k, LoserTree::EXHAUSTED);
+    for (int s = 0; s < k; s++) {
+        const ExternalTask& in = plan.tasks[task.inputs[s]];
+        readers.push_back(make_unique<RunReader>());
+        if (!readers[s]->open(in.path, in.count)) { plan.error = "Cannot read " + in.path; return false; }
+        int v;
+        if (readers[s]->next(v)) tree.head[s] = v;
+    }
+    tree.build();
+
+    RunWriter writer;
+    if (!writer.open(task.path)) { plan.error = "Cannot write " + task.path; return false; }
+    size_t written = 0;
+    bool first = true;
+    while (tree.head[tree.node[0]] != LoserTree::EXHAUSTED) {
+        int w = tree.node[0];
+        int value = (int)tree.head[w];
+        if (first) { task.minValue = value; first = false; }
+        task.maxValue = value;
+        if (!writer.push(value)) { plan.error = "Write failed: " + task.path; return false; }
+        int v;
+        tree.head[w] = readers[w]->next(v) ? v : LoserTree::EXHAUSTED;
+        tree.replay(w);
+        if (++written % EXTERNAL_IO_INTS == 0) {
+            task.progress = written;
+            if (cancel) return false;
+        }
+    }
+    readers.clear();
+    if (!writer.close()) { plan.error = "Write failed: " + task.path; return false; }
+    task.progress = written;
+    for (int in : task.inputs) remove(plan.tasks[in].path.c_str());
+    return true;
+}
+
+// Runs the whole plan: parallel run generation, then the merge passes in order.
+void externalSort(ExternalPlan& plan, const string& input, const atomic<bool>& cancel) {
+    atomic<int> nextRun{0};
+    atomic<bool> failed{false};
+    auto sortRuns = [&]() {
+        ifstream in(input, ios::binary);
+        vector<int> buf;
+        int r;
+        while (!failed && !cancel && (r = nextRun++) < plan.runCount) {
+            ExternalTask& t = plan.tasks[r];
+            t.state = TaskState::ACTIVE;
+            buf.resize(t.count);
+            in.seekg((streamoff)(t.offset * sizeof(int)));
+            in.read((char*)buf.data(), t.count * sizeof(int));
+            if ((size_t)in.gcount() != t.count * sizeof(int)) {
+                if (!failed.exchange(true)) plan.error = "Short read from " + input;
+                return;
+            }
+            quickSortKernel(buf.data(), t.count);
+
+            // One large sequential write per run
+            ofstream out(t.path, ios::binary | ios::trunc);
+            out.write((const char*)buf.data(), t.count * sizeof(int));
+            if (!out) {
+                if (!failed.exchange(true)) plan.error = "Cannot write " + t.path;
+                return;
+            }
+            if (t.count) { t.minValue = buf.front(); t.maxValue = buf.back(); }
+            t.progress = t.count;
+            t.state = TaskState::DONE;
+        }
+    };
+    vector<thread> workers;
+    for (unsigned i = 0; i < plan.threads; i++) workers.emplace_back(sortRuns);
+    for (auto& w : workers) w.join();
+
+    for (size_t i = plan.runCount; i < plan.tasks.size() && !failed && !cancel; i++) {
+        ExternalTask& t = plan.tasks[i];
+        t.state = TaskState::ACTIVE;
+        if (!runExternalMerge(plan, t, cancel)) { failed = true; break; }
+        t.state = TaskState::DONE;
+    }
+
+    if (failed || cancel) {
+        for (const ExternalTask& t : plan.tasks) remove(t.path.c_str());
+    }
+}
+
+// Each merge is drawn as the binary tournament of its loser tree, so the whole
+// plan is one binary tree. Task i shows buffer slots [2i, 2i + 2) once it is
+// done: the smallest and largest value of its output.
+int buildTournament(RecursionTree& tree, const vector<int>& taskNodes, const vector<int>& inputs, int lo, int hi) {
+    if (hi - lo == 1) return taskNodes[inputs[lo]];
+    int mid = (lo + hi) / 2;
+    int node = tree.addNode(0, 0, 0);
+    tree.attach(node, 0, buildTournament(tree, taskNodes, inputs, lo, mid));
+    tree.attach(node, 1, buildTournament(tree, taskNodes, inputs, mid, hi));
+    return node;
+}
+
+void buildExternalTree(const ExternalPlan& plan, RecursionTree& tree, vector<int>& taskNodes, vector<vector<int>>& matchNodes) {
+    tree.reset(vector<int>(2 * plan.tasks.size(), 0));
+    taskNodes.assign(plan.tasks.size(), -1);
+    matchNodes.assign(plan.tasks.size(), {});
+    for (size_t i = 0; i < plan.tasks.size(); i++) {
+        const ExternalTask& t = plan.tasks[i];
+        if (t.inputs.empty()) {
+            taskNodes[i] = tree.addNode(2 * i, 2 * i, 0);
+            continue;
+        }
+        int k = t.inputs.size();
+        int root = buildTournament(tree, taskNodes, t.inputs, 0, k);
+        // The merge's own node is the root of its tournament
+        tree.nodes[root].lo = tree.nodes[root].hi = 2 * i;
+        taskNodes[i] = root;
+        // Remember the internal matches so they light up with their merge
+        vector<int> stack = {root};
+        while (!stack.empty()) {
+            int n = stack.back(); stack.pop_back();
+            bool isInput = false;
+            for (int in : t.inputs) isInput = isInput || taskNodes[in] == n;
+            if (isInput) continue;
+            matchNodes[i].push_back(n);
+            stack.push_back(tree.nodes[n].left);
+            stack.push_back(tree.nodes[n].right);
+        }
+    }
+    tree.root = taskNodes.back();
+    tree.layoutSubtree(tree.root);
+}
+
+string formatCount(size_t n) {
+    if (n >= 1000000) return to_string(n / 1000000) + "M";
+    if (n >= 1000) return to_string(n / 1000) + "K";
+    return to_string(n);
+}
+
+int runExternalSortMode(RenderWindow& window, const Font& font, const string& input, const string& output) {
+    ifstream probe(input, ios::binary | ios::ate);
+    if (!probe) { cerr << "Cannot open " << input << endl; return 1; }
+    size_t bytes = (size_t)probe.tellg();
+    probe.close();
+    if (bytes % sizeof(int) != 0) { cerr << input << " is not a file of 32-bit integers" << endl; return 1; }
+
+    ExternalPlan plan;
+    makeExternalPlan(plan, bytes / sizeof(int), output);
+
+    RecursionTree tree;
+    vector<int> taskNodes;
+    vector<vector<int>> matchNodes;
+    buildExternalTree(plan, tree, taskNodes, matchNodes);
+
+    atomic<bool> cancel{false};
+    atomic<bool> finished{false};
+    Clock clock;
+    thread sorter([&]() { externalSort(plan, input, cancel); finished = true; });
+
+    AnimationScheduler anim; // Speed has no effect here, the sorter runs flat out
+    TreeCamera camera;
+    TreeRenderer treeRenderer;
+    float elapsed = 0;
+
+    while (window.isOpen()) {
+        UIState state = pollEventsAndCheckUI(window, font, anim, camera);
+        if (state.shouldClose) break;
+
+        size_t done = 0;
+        for (size_t i = 0; i < plan.tasks.size(); i++) {
+            const ExternalTask& t = plan.tasks[i];
+            TreeNode& n = tree.nodes[taskNodes[i]];
+            TaskState s = t.state;
+            n.isActive = s == TaskState::ACTIVE;
+            n.isSorted = s == TaskState::DONE;
+            if (s == TaskState::DONE && t.count && n.hi == n.lo) {
+                // Range of the run
+                tree.buffers[0][n.lo] = t.minValue;
+                tree.buffers[0][n.lo + 1] = t.maxValue;
+                n.hi = n.lo + 2;
+                tree.place(taskNodes[i]);
+            }
+            size_t progress = t.progress;
+            if (i + 1 == plan.tasks.size()) done = progress;
+            if (t.inputs.empty()) {
+                n.title = "Run " + to_string(i) + " " + formatCount(t.count);
+            } else {
+                int percent = t.count ? (int)(100 * progress / t.count) : 100;
+                n.title = "Merge " + to_string(percent) + "%";
+            }
+            for (int m : matchNodes[i]) { tree.nodes[m].isActive = n.isActive; tree.nodes[m].isSorted = n.isSorted; }
+        }
+        tree.changed(); // Titles show progress, so something changes every frame
+        if (!finished) elapsed = clock.getElapsedTime().asSeconds();
+        camera.bounds = tree.bounds();
+        camera.update();
+
+        window.clear(Color::Black);
+        drawTree(window, font, treeRenderer, tree, camera);
+
+        int runsDone = 0;
+        for (int r = 0; r < plan.runCount; r++) runsDone += plan.tasks[r].state == TaskState::DONE;
+        string status;
+        if (finished && !plan.error.empty()) status = "Error: " + plan.error;
+        else if (runsDone < plan.runCount) status = "Sorting runs: " + to_string(runsDone) + "/" + to_string(plan.runCount) + " on " + to_string(plan.threads) + " threads";
+        else if (!finished) status = "Merging: " + formatCount(done) + "/" + formatCount(plan.totalValues);
+        else status = "Sorted " + formatCount(plan.totalValues) + " values into " + output;
+        double mbps = elapsed > 0 ? plan.totalValues * sizeof(int) / 1e6 / elapsed : 0;
+        Text statusText(font, status + "   (" + to_string((int)elapsed) + "s, " + to_string((int)mbps) + " MB/s)");
+        statusText.setCharacterSize(18);
+        statusText.setFillColor(Color::White);
+        statusText.setPosition({10, 20});
+        window.draw(statusText);
+        window.display();
+    }
+
+    cancel = true;
+    sorter.join();
+    return plan.error.empty() ? 0 : 1;
+}
+
+
+// ################################################################
+// --- TRACE PLAYBACK (render thread) ---
+// ################################################################
+
+// What the window shows of the sort in flight, rebuilt from its trace
+struct SortScene {
+    string title;
+    string status;              // What a bar sort is doing right now (TITLE events)
+    HighlightBuffer highlights; // Bars, or comparators in the network mode
+    int layersDone = 0;
+    RecursionTree tree;         // Empty outside of the tree mode
+    bool pingPong = false;      // Merge sort children show the other buffer
+    vector<int> nodeStart{0};   // Where each node's range begins when a tree sort is shown as bars
+    long long compares = 0, swaps = 0;
+    long long writes = 0;                    // Array elements written (SET events)
+    long long auxBytes = 0, peakAuxBytes = 0; // Scratch memory held, now and at most
+
+    string caption() const { return status.empty() ? title : title + ": " + status; }
+};
+
+// Which view a sort is shown in
+enum class SceneKind : uint8_t { BARS, TREE, NETWORK };
+
+// What the performance HUD measures a sort against (see PERFORMANCE HUD)
+struct SortProfile;
+
+// Everything needed to start a sort again, live or for a replay file
+struct SortRecipe {
+    string title;
+    SceneKind kind = SceneKind::BARS;
+    bool pingPong = false; // Merge sort's tree alternates buffers
+    function<void(Tracer&, vector<int>&)> sort;
+    const SortProfile* profile = nullptr;
+};
+
+// Puts scene and arr where a sort of this kind on input starts from
+void startScene(SortScene& scene, vector<int>& arr, SceneKind kind, const vector<int>& input, const string& title,
+                bool pingPong) {
+    scene = SortScene();
+    scene.title = title;
+    arr = input;
+    if (kind == SceneKind::BARS) {
+        scene.highlights = HighlightBuffer(input.size());
+    } else if (kind == SceneKind::NETWORK) {
+        if (input.size() <= MAX_NETWORK_SIZE) scene.highlights = HighlightBuffer(NETWORK_TABLE[input.size()].size);
+    } else {
+        scene.tree.reset(input);
+        int root = scene.tree.addNode(0, input.size(), 0);
+        scene.tree.nodes[root].title = "Root";
+        scene.tree.layoutSubtree(root);
+        scene.pingPong = pingPong;
+    }
+}
+
+void applyTraceEvent(const TraceEvent& e, SortScene& scene, vector<int>& arr, BarRenderer& bars) {
+    if (e.op == TraceOp::STEP || e.op == TraceOp::DONE) {
+        scene.compares += e.index;
+        scene.swaps += e.value;
+    } else if (e.op == TraceOp::SET) {
+        scene.writes++;
+    } else if (e.op == TraceOp::ALLOC) {
+        scene.auxBytes += e.value;
+        scene.peakAuxBytes = max(scene.peakAuxBytes, scene.auxBytes);
+        return;
+    }
+
+    RecursionTree& tree = scene.tree;
+    if (tree.nodes.empty()) {
+        int start = scene.nodeStart[e.node];
+        switch (e.op) {
+            case TraceOp::SET: arr[start + e.index] = e.value; bars.touch(start + e.index); break;
+            case TraceOp::MARK: scene.highlights.set(start + e.index, e.arg); break;
+            case TraceOp::CLEAR_MARKS: scene.highlights.clear(); break;
+            case TraceOp::LAYER: scene.layersDone = e.value; break;
+            case TraceOp::SPLIT: scene.nodeStart.push_back(start + e.index); break;
+            case TraceOp::TITLE: scene.status = NODE_TITLES[e.arg]; break;
+            default: break;
+        }
+        return;
+    }
+
+    TreeNode& node = tree.nodes[e.node];
+    switch (e.op) {
+        case TraceOp::SET: tree.buffers[node.buffer][node.lo + e.index] = e.value; break;
+        case TraceOp::MARK: tree.highlights.set(e.node, node, e.index, e.arg); break;
+        case TraceOp::CLEAR_MARKS: tree.highlights.clear(e.node); break;
+        case TraceOp::ACTIVE: node.isActive = e.arg; break;
+        case TraceOp::SORTED: node.isSorted = e.arg; break;
+        case TraceOp::TITLE: node.title = NODE_TITLES[e.arg]; break;
+        case TraceOp::SPLIT: tree.split(e.node, e.arg, e.index, e.value, scene.pingPong); break;
+        default: return; // STEP and DONE are handled by playTrace
+    }
+    tree.changed();
+}
+
+// Replays the trace until the next step is due, the worker falls behind or
+// this replay's share of the frame is used up. Returns true once the sort has
+// finished.
+bool playTrace(SortRun& run, AnimationScheduler& anim, SortScene& scene, vector<int>& arr, BarRenderer& bars,
+               float frameShare = 0.5f) {
+    anim.beginFrame();
+    for (unsigned n = 1; ; n++) {
+        if (n % 4096 == 0 && anim.frameClock.getElapsedTime().asSeconds() > FRAME_SECONDS * frameShare) return false;
+        const TraceEvent* e = run.ring.front();
+        if (!e) return false;
+        if (e->op == TraceOp::DONE) {
+            applyTraceEvent(*e, scene, arr, bars);
+            run.stop();
+            scene.highlights.clear();
+            return true;
+        }
+        if (e->op == TraceOp::STEP && !anim.pay(e->arg)) return false;
+        applyTraceEvent(*e, scene, arr, bars);
+        run.ring.pop();
+    }
+}
+
+
+// ################################################################
+// --- MODE 5: RACE (several sorts side by side) ---
+// ################################################################
+
+// Every pane sorts its own copy of the same input on its own worker and
+// replays its own trace at the shared speed, so the panes finish in the order
+// their algorithms would. All bars and frames go into one vertex array and
+// are drawn with a single draw call.
+struct RaceEntry {
+    const char* name;
+    function<void(Tracer&, vector<int>&)> sort;
+};
+
+const RaceEntry RACE_ENTRIES[] = {
+    {"Bubble", bubbleSort_bars},
+    {"Insertion", insertionSort_bars},
+    {"Selection", selectionSort_bars},
+    {"Quick", quickSort_tree},
+    {"Merge", mergeSort_tree},
+    {"TimSort", timSort_bars},
+    {"pdqsort", pdqSort_bars},
+};
+
+const float RACE_TOP = 110;       // Below the buttons
+const float RACE_HEADER = 50;     // Name and counters above the bars
+
+struct RacePane {
+    string name;
+    SortRun run;
+    AnimationScheduler anim; // Own budget, speed copied from the window's
+    SortScene scene;
+    vector<int> arr;
+    BarRenderer bars;
+    Clock clock;
+    float seconds = 0;       // Replay time, frozen once the sort is done
+    int place = 0;           // Finishing position, 0 while running
+};
+
+struct SortRace {
+    vector<unique_ptr<RacePane>> panes; // SortRun can't move
+    VertexArray batch{sf::PrimitiveType::Triangles};
+    int finished = 0;
+
+    bool running() const { return finished < (int)panes.size(); }
+
+    void start(const vector<int>& input) {
+        stop();
+        int count = sizeof(RACE_ENTRIES) / sizeof(RACE_ENTRIES[0]);
+        int cols = (int)std::ceil(std::sqrt((float)count));
+        int rows = (count + cols - 1) / cols;
+        float w = (float)WINDOW_WIDTH / cols, h = (WINDOW_HEIGHT - RACE_TOP) / rows;
+        for (int i = 0; i < count; i++) {
+            auto pane = make_unique<RacePane>();
+            pane->name = RACE_ENTRIES[i].name;
+            pane->arr = input;
+            pane->scene.highlights = HighlightBuffer(input.size());
+            pane->bars.area = FloatRect({(i % cols) * w + 5, RACE_TOP + (i / cols) * h + 5}, {w - 10, h - 10});
+            pane->bars.headroom = RACE_HEADER;
+            pane->bars.reset(pane->arr);
+            pane->run.start([data = input, sort = RACE_ENTRIES[i].sort](Tracer& t) mutable { sort(t, data); });
+            panes.push_back(std::move(pane));
+        }
+        // Same starting line for everyone, however long the setup took
+        for (auto& pane : panes) {
+            pane->anim.start();
+            pane->clock.restart();
+        }
+    }
+
+    void stop() {
+        panes.clear();
+        finished = 0;
+    }
+
+    // Once per frame; the panes split the replay time between them
+    void update(const AnimationScheduler& anim) {
+        for (auto& pane : panes) {
+            if (pane->place) continue;
+            pane->anim.stepsPerSecond = anim.stepsPerSecond;
+            bool done = playTrace(pane->run, pane->anim, pane->scene, pane->arr, pane->bars, 0.5f / panes.size());
+            pane->seconds = pane->clock.getElapsedTime().asSeconds();
+            if (done) pane->place = ++finished;
+        }
+    }
+
+    void draw(RenderWindow& window, const Font& font) {
+        batch.clear();
+        for (auto& pane : panes) {
+            Color edge = pane->place == 1 ? Color::Green : Color(80, 80, 80);
+            appendFrame(batch, pane->bars.area, 1, Color(20, 20, 20), edge);
+        }
+        for (auto& pane : panes) {
+            pane->bars.update(pane->arr, pane->scene.highlights);
+            for (size_t v = 0; v < pane->bars.vertices.getVertexCount(); v++) batch.append(pane->bars.vertices[v]);
+        }
+        window.draw(batch);
+
+        for (auto& pane : panes) {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%s   %.1fs\nCompares %lld   Swaps %lld", pane->name.c_str(), pane->seconds,
+                     pane->scene.compares, pane->scene.swaps);
+            string label = buf;
+            if (pane->place) label = "#" + to_string(pane->place) + " " + label;
+            Text text(font, label);
+            text.setCharacterSize(14);
+            text.setFillColor(Color::White);
+            text.setPosition(pane->bars.area.position + Vector2f(8, 6));
+            window.draw(text);
+        }
+    }
+};
+
+// ################################################################
+// --- INPUT (files, clipboard, generators) ---
+// ################################################################
+
+// --- Memory-mapped files ---
+// Read-only view of a whole file. Falls back to reading it into memory where
+// mmap isn't available.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    vector<char> contents;
+#endif
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& path, string& error) {
+#ifdef _WIN32
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in) { error = "Cannot open " + path; return false; }
+        contents.resize((size_t)in.tellg());
+        in.seekg(0);
+        in.read(contents.data(), contents.size());
+        if (!in) { error = "Cannot read " + path; return false; }
+        data = contents.data();
+        size = contents.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { error = "Cannot open " + path; return false; }
+        struct stat info;
+        if (fstat(fd, &info) != 0) { ::close(fd); error = "Cannot read " + path; return false; }
+        size = (size_t)info.st_size;
+        if (size > 0) {
+            void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) { ::close(fd); size = 0; error = "Cannot map " + path; return false; }
+            madvise(map, size, MADV_SEQUENTIAL);
+            data = (const char*)map;
+        }
+        ::close(fd); // The mapping stays valid
+        return true;
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data) munmap((void*)data, size);
+#endif
+    }
+};
+
+// --- Text parsing ---
+// Numbers separated by whitespace, commas or semicolons. Big inputs are cut
+// into one slice per thread at separators and parsed with from_chars.
+const size_t PARSE_MIN_SLICE = 1 << 20;
+
+inline bool isInputSeparator(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',' || c == ';';
+}
+
+// Parses [p, end) onto out. Returns the offset of the first bad character, or -1.
+long long parseSlice(const char* p, const char* end, vector<int>& out) {
+    const char* begin = p;
+    while (true) {
+        while (p < end && isInputSeparator(*p)) p++;
+        if (p == end) return -1;
+        int value;
+        auto [next, ec] = from_chars(p, end, value);
+        if (ec != errc() || (next < end && !isInputSeparator(*next))) return p - begin;
+        out.push_back(value);
+        p = next;
+    }
+}
+
+bool parseValues(const char* text, size_t size, vector<int>& out, string& error) {
+    unsigned threads = std::max<size_t>(1, std::min<size_t>(thread::hardware_concurrency(), size / PARSE_MIN_SLICE));
+    vector<size_t> cut(threads + 1, size);
+    cut[0] = 0;
+    for (unsigned t = 1; t < threads; t++) {
+        size_t c = std::max(cut[t - 1], size * t / threads);
+        while (c < size && !isInputSeparator(text[c])) c++;
+        cut[t] = c;
+    }
+
+    vector<vector<int>> parts(threads);
+    vector<long long> bad(threads, -1);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            parts[t].reserve((cut[t + 1] - cut[t]) / 4);
+            bad[t] = parseSlice(text + cut[t], text + cut[t + 1], parts[t]);
+        });
+    }
+    for (thread& w : workers) w.join();
+
+    for (unsigned t = 0; t < threads; t++) {
+        if (bad[t] < 0) continue;
+        size_t at = cut[t] + bad[t];
+        size_t len = 0;
+        while (at + len < size && len < 20 && !isInputSeparator(text[at + len])) len++;
+        error = "Not a number: \"" + string(text + at, len) + "\"";
+        return false;
+    }
+
+    size_t total = 0;
+    for (auto& part : parts) total += part.size();
+    out.clear();
+    out.reserve(total);
+    for (auto& part : parts) out.insert(out.end(), part.begin(), part.end());
+    return true;
+}
+
+// Files ending in .bin hold raw 32-bit integers, like --external takes;
+// anything else is parsed as text
+bool loadValuesFromFile(const string& path, vector<int>& out, string& error) {
+    MappedFile file;
+    if (!file.open(path, error)) return false;
+    bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+    if (!binary) return parseValues(file.data, file.size, out, error);
+
+    if (file.size % sizeof(int) != 0) { error = path + " is not a whole number of 32-bit values"; return false; }
+    out.resize(file.size / sizeof(int));
+    if (file.size) memcpy(out.data(), file.data, file.size);
+    return true;
+}
+
+// --- Generators ---
+// The first six double as the benchmark's input patterns
+enum InputGenerator {
+    GEN_RANDOM, GEN_SORTED, GEN_REVERSED, GEN_FEW_UNIQUE, GEN_SAWTOOTH, GEN_NEARLY_SORTED,
+    GEN_NORMAL, GEN_EXPONENTIAL, GEN_COUNT
+};
+
+const char* const GENERATOR_NAMES[GEN_COUNT] = {
+    "random", "sorted", "reversed", "few unique", "sawtooth", "nearly sorted", "normal", "exponential"
+};
+
+const size_t GENERATOR_CHUNK = 1 << 20;
+
+// n values in [0, maxValue]. Chunks are filled in parallel, each from its own
+// seed, so the result only depends on seed and not on the thread count.
+vector<int> generateValues(int kind, size_t n, uint32_t seed, int maxValue) {
+    vector<int> v(n);
+    double range = maxValue;
+    size_t period = std::clamp<size_t>(n / 8, 2, 1000);
+    auto fill = [&](size_t begin, size_t end, mt19937& rng) {
+        normal_distribution<double> normal(range / 2, range / 8);
+        exponential_distribution<double> exponential(8 / std::max(range, 1.0));
+        for (size_t i = begin; i < end; i++) {
+            switch (kind) {
+                case GEN_RANDOM: v[i] = (int)(rng() % ((uint64_t)maxValue + 1)); break;
+                case GEN_REVERSED: v[i] = (int)(n - i); break;
+                case GEN_FEW_UNIQUE: v[i] = (int)(rng() % 16) * (maxValue / 16); break;
+                case GEN_SAWTOOTH: v[i] = (int)(i % period); break;
+                case GEN_NORMAL: v[i] = (int)std::clamp(std::round(normal(rng)), 0.0, range); break;
+                case GEN_EXPONENTIAL: v[i] = (int)std::min(std::round(exponential(rng)), range); break;
+                default: v[i] = (int)i; break; // Sorted and nearly sorted
+            }
+        }
+    };
+
+    size_t chunks = (n + GENERATOR_CHUNK - 1) / GENERATOR_CHUNK;
+    atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t c; (c = next++) < chunks; ) {
+            mt19937 rng(seed + (uint32_t)c * 0x9E3779B9u);
+            fill(c * GENERATOR_CHUNK, std::min(n, (c + 1) * GENERATOR_CHUNK), rng);
+        }
+    };
+    vector<thread> workers;
+    unsigned threads = std::max<size_t>(1, std::min<size_t>(thread::hardware_concurrency(), chunks));
+    for (unsigned t = 1; t < threads; t++) workers.emplace_back(worker);
+    worker();
+    for (thread& w : workers) w.join();
+
+    if (kind == GEN_NEARLY_SORTED && n > 1) {
+        mt19937 rng(seed);
+        for (size_t k = 0; k < std::max<size_t>(1, n / 100); k++) swap(v[rng() % n], v[rng() % n]);
+    }
+    return v;
+}
+
+// --- Input prompt ---
+// What the prompt accepts besides a list of numbers:
+//   <generator> <count>   e.g. "normal 1000000"
+//   load <path>           a text file, or raw 32-bit ints if it ends in .bin
+const size_t PROMPT_MAX_GENERATED = 1000000000;
+
+struct LoadedInput {
+    vector<int> values;
+    string error;
+};
+
+LoadedInput readPromptInput(const string& line) {
+    LoadedInput in;
+    size_t start = line.find_first_not_of(' ');
+    string command = start == string::npos ? "" : line.substr(start);
+
+    if (command.compare(0, 5, "load ") == 0) {
+        string path = command.substr(5);
+        while (!path.empty() && path.back() == ' ') path.pop_back();
+        loadValuesFromFile(path, in.values, in.error);
+        return in;
+    }
+    for (int kind = 0; kind < GEN_COUNT; kind++) {
+        string name = GENERATOR_NAMES[kind];
+        if (command.compare(0, name.size(), name) != 0 || command.size() == name.size() || command[name.size()] != ' ') continue;
+        unsigned long long n = 0;
+        const char* p = command.c_str() + name.size() + 1;
+        const char* end = command.c_str() + command.size();
+        auto [next, ec] = from_chars(p, end, n);
+        if (ec != errc() || next != end || n == 0 || n > PROMPT_MAX_GENERATED) {
+            in.error = "Usage: " + name + " <count>, up to " + to_string(PROMPT_MAX_GENERATED);
+            return in;
+        }
+        int maxValue = (int)std::clamp<unsigned long long>(n, 100, INT_MAX);
+        in.values = generateValues(kind, n, (uint32_t)chrono::steady_clock::now().time_since_epoch().count(), maxValue);
+        return in;
+    }
+    parseValues(command.data(), command.size(), in.values, in.error);
+    return in;
+}
+
+LoadedInput readClipboardInput() {
+    LoadedInput in;
+    string text = Clipboard::getString().toAnsiString();
+    if (parseValues(text.data(), text.size(), in.values, in.error) && in.values.empty()) in.error = "The clipboard holds no numbers";
+    return in;
+}
+
+
+// ################################################################
+// --- REPLAY FILES (record, seek, export) ---
+// ################################################################
+
+// A replay file holds a sort's input and its whole trace, so the run can be
+// watched again at any speed, scrubbed and exported without sorting again.
+// All integers are LEB128 varints, signed ones zigzag encoded:
+//   "SVTRACE2", scene kind, pingPong, title, the input as deltas
+//   events: a tag byte (op | 0x10 arg | 0x20 node | 0x40 index | 0x80 value)
+//           and the fields whose bit is set. node is stored as a delta from
+//           the previous event, index and value from the previous event with
+//           the same op, and a field that did not change is left out.
+//   keyframes between steps: TRACE_TAG_KEYFRAME, length, the whole scene.
+//           They restart the deltas, so decoding can begin at any of them.
+//   TRACE_TAG_END, step count, keyframe index (step and offset deltas)
+//   footer: offset of the index as 8 bytes and "SVTINDEX"
+const char TRACE_FILE_MAGIC[8] = {'S', 'V', 'T', 'R', 'A', 'C', 'E', '2'};
+const char TRACE_INDEX_MAGIC[8] = {'S', 'V', 'T', 'I', 'N', 'D', 'E', 'X'};
+const uint8_t TRACE_TAG_END = 0x0E;
+const uint8_t TRACE_TAG_KEYFRAME = 0x0F;
+const int TRACE_OPS = (int)TraceOp::DONE + 1;
+const size_t TRACE_KEYFRAME_EVENTS = 1 << 14; // Fewer for small scenes than this between keyframes
+const size_t TRACE_FLUSH_BYTES = 1 << 20;
+const int REPLAY_EXPORT_FRAMES = 300;
+const int REPLAY_QUADRATIC_LIMIT = 2000;        // Bubble sort of this many values writes ~40 MB
+const uint64_t REPLAY_MAX_BYTES = 256ull << 20; // Recording stops past this
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+void putVarint(string& out, uint64_t v) {
+    while (v >= 0x80) { out += (char)(v | 0x80); v >>= 7; }
+    out += (char)v;
+}
+
+void putSigned(string& out, int64_t v) { putVarint(out, zigzag(v)); }
+
+void putString(string& out, const string& s) {
+    putVarint(out, s.size());
+    out += s;
+}
+
+void putValues(string& out, const vector<int>& values) {
+    putVarint(out, values.size());
+    int prev = 0;
+    for (int v : values) { putSigned(out, (int64_t)v - prev); prev = v; }
+}
+
+// Reads from a mapped file. Running past the end or an absurd length clears
+// ok instead of reading out of bounds.
+struct ByteReader {
+    const uint8_t* p = nullptr;
+    const uint8_t* end = nullptr;
+    bool ok = true;
+
+    size_t left() const { return end - p; }
+
+    uint8_t byte() {
+        if (p >= end) { ok = false; return 0; }
+        return *p++;
+    }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t svarint() { return unzigzag(varint()); }
+
+    string str() {
+        uint64_t len = varint();
+        if (len > left()) { ok = false; return ""; }
+        string s((const char*)p, len);
+        p += len;
+        return s;
+    }
+
+    // Every value takes at least one byte, which bounds the count
+    void values(vector<int>& out) {
+        uint64_t n = varint();
+        if (n > left()) { ok = false; return; }
+        out.resize(n);
+        int64_t prev = 0;
+        for (int& v : out) { prev += svarint(); v = (int)prev; }
+    }
+};
+
+// What the deltas of the next event are taken from
+struct TraceDeltas {
+    int node = 0;
+    int index[TRACE_OPS] = {};
+    int value[TRACE_OPS] = {};
+};
+
+void encodeTraceEvent(string& out, const TraceEvent& e, TraceDeltas& d) {
+    int op = (int)e.op;
+    uint8_t tag = op;
+    if (e.arg) tag |= 0x10;
+    if (e.node != d.node) tag |= 0x20;
+    if (e.index != d.index[op]) tag |= 0x40;
+    if (e.value != d.value[op]) tag |= 0x80;
+    out += (char)tag;
+    if (tag & 0x10) out += (char)e.arg;
+    if (tag & 0x20) putSigned(out, (int64_t)e.node - d.node);
+    if (tag & 0x40) putSigned(out, (int64_t)e.index - d.index[op]);
+    if (tag & 0x80) putSigned(out, (int64_t)e.value - d.value[op]);
+    d.node = e.node;
+    d.index[op] = e.index;
+    d.value[op] = e.value;
+}
+
+bool decodeTraceEvent(ByteReader& in, uint8_t tag, TraceEvent& e, TraceDeltas& d) {
+    int op = tag & 0x0F;
+    if (op >= TRACE_OPS) return false;
+    e.op = (TraceOp)op;
+    e.arg = tag & 0x10 ? in.byte() : 0;
+    e.node = tag & 0x20 ? (int)(d.node + in.svarint()) : d.node;
+    e.index = tag & 0x40 ? (int)(d.index[op] + in.svarint()) : d.index[op];
+    e.value = tag & 0x80 ? (int)(d.value[op] + in.svarint()) : d.value[op];
+    d.node = e.node;
+    d.index[op] = e.index;
+    d.value[op] = e.value;
+    return in.ok;
+}
+
+// A file can't be trusted, so every event is checked against the scene
+// before it is applied
+bool traceEventFits(const TraceEvent& e, const SortScene& scene, const vector<int>& arr) {
+    const RecursionTree& tree = scene.tree;
+    if (e.op == TraceOp::TITLE && e.arg >= sizeof(NODE_TITLES) / sizeof(NODE_TITLES[0])) return false;
+    if (tree.nodes.empty()) {
+        if (e.node < 0 || e.node >= (int)scene.nodeStart.size()) return false;
+        long long at = (long long)scene.nodeStart[e.node] + e.index;
+        if (e.op == TraceOp::SET) return at >= 0 && at < (long long)arr.size();
+        if (e.op == TraceOp::SPLIT) return at >= 0 && at <= (long long)arr.size();
+        return true;
+    }
+    if (e.node < 0 || e.node >= (int)tree.nodes.size()) return false;
+    int size = tree.nodes[e.node].hi - tree.nodes[e.node].lo;
+    if (e.op == TraceOp::SET || e.op == TraceOp::MARK) return e.index >= 0 && e.index < size;
+    if (e.op == TraceOp::SPLIT) return e.index >= 0 && e.index <= e.value && e.value <= size;
+    return true;
+}
+
+// --- Keyframes ---
+void putScene(string& out, const SortScene& scene, const vector<int>& arr, long long step) {
+    putVarint(out, step);
+    putVarint(out, scene.compares);
+    putVarint(out, scene.swaps);
+    putVarint(out, scene.writes);
+    putSigned(out, scene.auxBytes);
+    putVarint(out, scene.peakAuxBytes);
+    putVarint(out, scene.layersDone);
+    putString(out, scene.status);
+    putValues(out, scene.nodeStart);
+    putValues(out, arr);
+
+    const RecursionTree& tree = scene.tree;
+    putVarint(out, tree.nodes.size());
+    if (tree.nodes.empty()) return;
+    putValues(out, tree.buffers[0]);
+    putValues(out, tree.buffers[1]);
+    for (const TreeNode& node : tree.nodes) {
+        putVarint(out, node.lo);
+        putVarint(out, node.hi);
+        out += (char)node.buffer;
+        putSigned(out, node.left);
+        putSigned(out, node.right);
+        putSigned(out, node.parent);
+        out += (char)(node.isSorted | node.isActive << 1);
+        putString(out, node.title);
+    }
+}
+
+// scene must already be set up by startScene; highlights start out empty
+bool readScene(ByteReader& in, SortScene& scene, vector<int>& arr, long long& step) {
+    step = in.varint();
+    scene.compares = in.varint();
+    scene.swaps = in.varint();
+    scene.writes = in.varint();
+    scene.auxBytes = in.svarint();
+    scene.peakAuxBytes = in.varint();
+    scene.layersDone = (int)in.varint();
+    scene.status = in.str();
+    in.values(scene.nodeStart);
+    in.values(arr);
+    for (int start : scene.nodeStart) if (start < 0 || start > (int)arr.size()) return false;
+
+    uint64_t count = in.varint();
+    if (!in.ok || count > in.left()) return false;
+    if (count == 0) return scene.tree.nodes.empty() && !scene.nodeStart.empty();
+    if (scene.tree.nodes.empty()) return false;
+
+    RecursionTree& tree = scene.tree;
+    vector<int> buffer0, buffer1;
+    in.values(buffer0);
+    in.values(buffer1);
+    if (buffer0.size() != buffer1.size()) return false;
+    tree.reset(buffer0);
+    tree.buffers[1] = std::move(buffer1);
+    tree.nodes.resize(count);
+    for (int id = 0; id < (int)count; id++) {
+        TreeNode& node = tree.nodes[id];
+        node.lo = (int)in.varint();
+        node.hi = (int)in.varint();
+        node.buffer = in.byte();
+        node.left = (int)in.svarint();
+        node.right = (int)in.svarint();
+        node.parent = (int)in.svarint();
+        uint8_t flags = in.byte();
+        node.isSorted = flags & 1;
+        node.isActive = flags & 2;
+        node.title = in.str();
+        // Children are always added after their parent, which rules out cycles
+        auto child = [&](int c) { return c == -1 || (c > id && c < (int)count); };
+        if (!in.ok || node.lo < 0 || node.lo > node.hi || node.hi > (int)buffer0.size() || node.buffer > 1 ||
+            !child(node.left) || !child(node.right) || (id == 0) != (node.parent == -1) || node.parent >= id) return false;
+    }
+    tree.layoutSubtree(0);
+    return in.ok;
+}
+
+// --- Recording ---
+// Mirrors what a viewer would see, so keyframes can be written as it goes
+struct TraceRecorder {
+    ofstream out;
+    string buffer;
+    uint64_t flushed = 0;
+    TraceDeltas deltas;
+    SortScene scene;
+    vector<int> arr;
+    BarRenderer bars; // Never drawn
+    long long steps = 0;
+    size_t sinceKeyframe = 0;
+    size_t keyframeEvents = TRACE_KEYFRAME_EVENTS;
+    vector<pair<long long, uint64_t>> keyframes; // Step and file offset
+
+    uint64_t offset() const { return flushed + buffer.size(); }
+
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        flushed += buffer.size();
+        buffer.clear();
+    }
+
+    void keyframe() {
+        string body;
+        putScene(body, scene, arr, steps);
+        keyframes.push_back({steps, offset()});
+        buffer += (char)TRACE_TAG_KEYFRAME;
+        putVarint(buffer, body.size());
+        buffer += body;
+        deltas = TraceDeltas();
+        sinceKeyframe = 0;
+    }
+};
+
+struct ReplayTooLarge {};
+
+void recordTraceEvent(TraceRecorder& r, const TraceEvent& e) {
+    encodeTraceEvent(r.buffer, e, r.deltas);
+    applyTraceEvent(e, r.scene, r.arr, r.bars);
+    r.sinceKeyframe++;
+    if (e.op == TraceOp::STEP) {
+        r.steps++;
+        if (r.sinceKeyframe >= r.keyframeEvents) r.keyframe();
+    }
+    if (r.buffer.size() >= TRACE_FLUSH_BYTES) {
+        r.flush();
+        if (r.flushed > REPLAY_MAX_BYTES) throw ReplayTooLarge();
+    }
+}
+
+// Runs the sort again on the calling thread and writes its trace to path.
+// The sorts are deterministic, so this is the same run that was on screen.
+// Setting cancel stops it within one step; nothing is left at path then.
+bool recordReplay(const string& path, const SortRecipe& recipe, const vector<int>& input,
+                  const atomic<bool>& cancel, string& error) {
+    TraceRecorder r;
+    r.out.open(path, ios::binary | ios::trunc);
+    if (!r.out) { error = "Cannot write " + path; return false; }
+    startScene(r.scene, r.arr, recipe.kind, input, recipe.title, recipe.pingPong);
+    // A keyframe costs about as much as the scene, so they are spaced to keep
+    // them a small part of the file
+    size_t sceneSize = input.size() * (recipe.kind == SceneKind::TREE ? 4 : 1);
+    r.keyframeEvents = std::max(TRACE_KEYFRAME_EVENTS, 8 * sceneSize);
+
+    r.buffer.append(TRACE_FILE_MAGIC, 8);
+    r.buffer += (char)recipe.kind;
+    r.buffer += (char)recipe.pingPong;
+    putString(r.buffer, recipe.title);
+    putValues(r.buffer, input);
+    r.keyframe();
+
+    Tracer tracer{nullptr, cancel};
+    tracer.recorder = &r;
+    vector<int> data = input;
+    try {
+        recipe.sort(tracer, data);
+        tracer.done();
+    } catch (const SortCancelled&) {
+        error = "Replay not saved";
+    } catch (const ReplayTooLarge&) {
+        error = "Replay too large to save";
+    }
+    if (!error.empty()) {
+        r.out.close();
+        remove(path.c_str());
+        return false;
+    }
+
+    r.buffer += (char)TRACE_TAG_END;
+    uint64_t indexOffset = r.offset();
+    putVarint(r.buffer, r.steps);
+    putVarint(r.buffer, r.keyframes.size());
+    pair<long long, uint64_t> prev{0, 0};
+    for (auto& k : r.keyframes) {
+        putVarint(r.buffer, k.first - prev.first);
+        putVarint(r.buffer, k.second - prev.second);
+        prev = k;
+    }
+    for (int b = 0; b < 8; b++) r.buffer += (char)(indexOffset >> (8 * b));
+    r.buffer.append(TRACE_INDEX_MAGIC, 8);
+    r.flush();
+    r.out.close();
+    if (!r.out) { error = "Write failed: " + path; return false; }
+    return true;
+}
+
+// Records the sort on screen on a worker, so the window stays responsive
+struct ReplaySaver {
+    atomic<bool> cancel{false};
+    future<string> saving;
+
+    bool busy() const { return saving.valid(); }
+
+    void start(const string& path, const SortRecipe& recipe, const vector<int>& input) {
+        stop();
+        saving = async(launch::async, [this, path, recipe, input]() {
+            string error;
+            return recordReplay(path, recipe, input, cancel, error) ? "Saved replay to " + path : error;
+        });
+    }
+
+    // Picks up the outcome once the recording is done
+    bool finished(string& message) {
+        if (!saving.valid() || saving.wait_for(chrono::seconds(0)) != future_status::ready) return false;
+        message = saving.get();
+        return true;
+    }
+
+    // Abandons the recording in progress and removes its file
+    void stop() {
+        cancel = true;
+        if (saving.valid()) saving.wait();
+        saving = future<string>();
+        cancel = false;
+    }
+
+    ~ReplaySaver() { stop(); }
+};
+
+// --- Playback ---
+struct ReplayFile {
+    MappedFile file;
+    SceneKind kind = SceneKind::BARS;
+    bool pingPong = false;
+    string title;
+    vector<int> input;
+    long long steps = 0;
+    vector<pair<long long, size_t>> keyframes; // Step and file offset
+    size_t eventsEnd = 0;                      // Where the index begins
+
+    ByteReader at(size_t offset) const {
+        const uint8_t* base = (const uint8_t*)file.data;
+        return ByteReader{base + offset, base + eventsEnd};
+    }
+
+    bool open(const string& path, string& error) {
+        if (!file.open(path, error)) return false;
+        error = path + " is not a replay file";
+        const uint8_t* base = (const uint8_t*)file.data;
+        if (file.size < 32 || memcmp(base, TRACE_FILE_MAGIC, 8) != 0 ||
+            memcmp(base + file.size - 8, TRACE_INDEX_MAGIC, 8) != 0) return false;
+        uint64_t indexOffset = 0;
+        for (int b = 0; b < 8; b++) indexOffset |= (uint64_t)base[file.size - 16 + b] << (8 * b);
+        if (indexOffset < 9 || indexOffset > file.size - 16) return false;
+        eventsEnd = indexOffset;
+
+        ByteReader header = at(8);
+        uint8_t k = header.byte();
+        if (k > (uint8_t)SceneKind::NETWORK) return false;
+        kind = (SceneKind)k;
+        pingPong = header.byte();
+        title = header.str();
+        header.values(input);
+        if (!header.ok) return false;
+
+        ByteReader index{base + indexOffset, base + file.size - 16};
+        steps = index.varint();
+        uint64_t count = index.varint();
+        if (!index.ok || count == 0 || count > index.left()) return false;
+        long long step = 0;
+        size_t offset = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            step += index.varint();
+            offset += index.varint();
+            if (offset >= eventsEnd || step > steps) return false;
+            keyframes.push_back({step, offset});
+        }
+        if (!index.ok || keyframes[0].first != 0) return false;
+        error.clear();
+        return true;
+    }
+};
+
+// The scene of a replay at one position. step counts the STEP events applied;
+// like live playback, the events leading up to the next STEP are applied too,
+// so a paused replay shows the same picture a paused sort would.
+struct ReplayPlayer {
+    const ReplayFile& file;
+    SortScene scene;
+    vector<int> arr;
+    ByteReader in;
+    TraceDeltas deltas;
+    long long step = 0;
+    bool finished = false;
+    bool damaged = false;
+    bool hasPending = false;
+    TraceEvent pending{};
 
-        // ✅ NEW: Handle Mouse Panning (Horizontal)
-        if (auto mbp = event->getIf<Event::MouseButtonPressed>()) {
-            if (mbp->button == Mouse::Button::Left) {
-                isPanning = true;
-                lastPanMousePos = Mouse::getPosition(window);
-            }
-        }
-        if (auto mbr = event->getIf<Event::MouseButtonReleased>()) {
-            if (mbr->button == Mouse::Button::Left) {
-                isPanning = false;
-            }
-        }
-        if (event->is<Event::MouseMoved>()) {
-            if (isPanning) {
-                Vector2i currentMousePos = Mouse::getPosition(window);
-                Vector2i delta = currentMousePos - lastPanMousePos;
-                
-                // Panning logic
-                viewOffsetX -= delta.x;
-                lastPanMousePos = currentMousePos;
+    explicit ReplayPlayer(const ReplayFile& f) : file(f) {}
 
-                // Clamp the horizontal view
-                float minPan = minTreeX - 50; // Allow 50px of overpan
-                float maxPan = maxTreeX - WINDOW_WIDTH + 50;
-                viewOffsetX = std::clamp(viewOffsetX, std::min(minPan, maxPan), std::max(minPan, maxPan));
+    // Decodes the next event into pending. False at the end of the trace.
+    bool peek() {
+        if (hasPending) return true;
+        if (finished || damaged) return false;
+        while (in.ok && in.left()) {
+            uint8_t tag = in.byte();
+            if (tag == TRACE_TAG_END) break;
+            if (tag == TRACE_TAG_KEYFRAME) {
+                uint64_t len = in.varint();
+                if (len > in.left()) in.ok = false;
+                else { in.p += len; deltas = TraceDeltas(); }
+                continue;
+            }
+            if (decodeTraceEvent(in, tag, pending, deltas) && traceEventFits(pending, scene, arr)) {
+                hasPending = true;
+                return true;
             }
+            in.ok = false;
         }
+        if (!in.ok) damaged = true;
+        return false;
     }
 
-    // --- Check UI Buttons (this part is unchanged) ---
-    Vector2i mouse = Mouse::getPosition(window);
-    bool mousePressed = Mouse::isButtonPressed(Mouse::Button::Left);
+    void apply(BarRenderer& bars) {
+        applyTraceEvent(pending, scene, arr, bars);
+        hasPending = false;
+        if (pending.op == TraceOp::STEP) step++;
+        if (pending.op == TraceOp::DONE) { finished = true; scene.highlights.clear(); }
+    }
 
-    RectangleShape r_reset({120, 40}); r_reset.setPosition({850, 10});
-    RectangleShape r_new({120, 40}); r_new.setPosition({980, 10});
-    RectangleShape r_speedDown({80, 30}); r_speedDown.setPosition({850, 60});
-    RectangleShape r_speedUp({80, 30}); r_speedUp.setPosition({940, 60});
+    // Applies everything up to the next STEP, or through DONE
+    void settle(BarRenderer& bars) {
+        while (peek() && pending.op != TraceOp::STEP) apply(bars);
+    }
 
-    if (mousePressed && r_reset.getGlobalBounds().contains(Vector2f(mouse))) state.resetPressed = true;
-    if (mousePressed && r_new.getGlobalBounds().contains(Vector2f(mouse))) state.newArrayPressed = true;
-    if (mousePressed && r_speedDown.getGlobalBounds().contains(Vector2f(mouse))) speedDownPressed = true;
-    if (mousePressed && r_speedUp.getGlobalBounds().contains(Vector2f(mouse))) speedUpPressed = true;
+    void restore(size_t k, BarRenderer& bars) {
+        startScene(scene, arr, file.kind, file.input, file.title, file.pingPong);
+        in = file.at(file.keyframes[k].second);
+        deltas = TraceDeltas();
+        finished = damaged = hasPending = false;
+        if (in.byte() != TRACE_TAG_KEYFRAME) in.ok = false;
+        uint64_t len = in.varint();
+        ByteReader body{in.p, in.p + std::min<uint64_t>(len, in.left())};
+        if (!in.ok || len > in.left() || !readScene(body, scene, arr, step)) {
+            damaged = true;
+        } else {
+            in.p += len;
+        }
+        bars.reset(arr);
+    }
 
-    if (speedDownPressed) { 
-        animationDelay = min(1000, animationDelay + 50);
-        sleep(milliseconds(100)); 
+    // Jumps to a step: from the last keyframe before it, or from here if that is closer
+    void seek(long long target, BarRenderer& bars) {
+        target = std::clamp(target, 0LL, file.steps);
+        auto k = std::upper_bound(file.keyframes.begin(), file.keyframes.end(), make_pair(target, SIZE_MAX)) - 1;
+        if (!in.p || target < step || k->first > step || damaged) restore(k - file.keyframes.begin(), bars);
+        while (step < target && peek()) apply(bars);
+        settle(bars);
     }
-    if (speedUpPressed) { 
-        animationDelay = max(0, animationDelay - 50);
-        sleep(milliseconds(100)); 
+};
+
+// Like playTrace, with the events coming from the file. Returns true once the
+// replay has reached the end.
+bool playReplay(ReplayPlayer& player, AnimationScheduler& anim, BarRenderer& bars) {
+    anim.beginFrame();
+    for (unsigned n = 1; ; n++) {
+        if (n % 4096 == 0 && anim.frameClock.getElapsedTime().asSeconds() > FRAME_SECONDS * 0.5f) return false;
+        if (!player.peek()) return true;
+        if (player.pending.op == TraceOp::STEP && !anim.pay(player.pending.arg)) return false;
+        player.apply(bars);
     }
-    
-    return state;
 }
 
+void drawReplayScene(RenderTarget& target, const Font& font, ReplayPlayer& player, BarRenderer& bars,
+                     TreeRenderer& treeRenderer, const TreeCamera& camera) {
+    const SortScene& scene = player.scene;
+    if (player.file.kind == SceneKind::BARS) {
+        drawSortState_bars(target, font, bars, player.arr, scene.caption(), scene.highlights);
+    } else if (player.file.kind == SceneKind::NETWORK) {
+        drawNetworkState(target, font, player.arr, "", scene.layersDone, scene.highlights);
+    } else {
+        target.clear(Color::Black);
+        drawTree(target, font, treeRenderer, scene.tree, camera);
+    }
+}
 
-// ##################################################################
-// --- MODE 1: BAR VISUALIZATION (Bubble, Insertion, Selection) ---
-// ##################################################################
+// sort_visualizer --replay <file>, or "replay <file>" at the prompt.
+// Space pauses, the arrow keys step, Page Up/Down skip a twentieth, Home and
+// End jump to either end and the timeline can be clicked or dragged. Returns
+// when the window closes or New Array is clicked.
+const FloatRect REPLAY_TIMELINE({10, 20}, {820, 14});
 
-// Note: This whole section is unchanged, but pollEventsAndCheckUI now needs dummy view params
-void drawSortState_bars(RenderWindow& window, const Font& font, const vector<int>& arr,
-                        int& animationDelay, const string& title,
-                        const map<int, Color>& highlights = {}) {
-    window.clear(Color::Black);
+void runReplayMode(RenderWindow& window, const Font& font, const ReplayFile& file) {
+    ReplayPlayer player(file);
+    BarRenderer bars;
+    TreeCamera camera;
+    TreeRenderer treeRenderer;
+    AnimationScheduler anim;
+    bool paused = false, scrubbing = false;
 
-    if (!title.empty()) {
-        Text titleText(font, title);
-        titleText.setCharacterSize(24);
-        titleText.setFillColor(Color::White);
-        titleText.setPosition({(WINDOW_WIDTH - titleText.getLocalBounds().size.x) / 2, 100});
-        window.draw(titleText);
-    }
-    
-    float barWidth = (float)WINDOW_WIDTH / arr.size();
-    for (size_t i = 0; i < arr.size(); i++) {
-        RectangleShape bar({barWidth - 2, (float)arr[i]});
-        bar.setPosition({i * barWidth, (float)(WINDOW_HEIGHT - arr[i])});
+    auto seekTo = [&](long long target) {
+        player.seek(target, bars);
+        anim.start();
+    };
+    auto seekToMouse = [&](int x) {
+        float f = std::clamp((x - REPLAY_TIMELINE.position.x) / REPLAY_TIMELINE.size.x, 0.0f, 1.0f);
+        seekTo(std::llround(f * file.steps));
+    };
+    seekTo(0);
 
-        if (highlights.count(i)) {
-            bar.setFillColor(highlights.at(i));
-        } else {
-            bar.setFillColor(Color::Green);
+    while (window.isOpen()) {
+        while (auto event = window.pollEvent()) {
+            if (event->is<Event::Closed>()) { window.close(); return; }
+            if (auto click = event->getIf<Event::MouseButtonPressed>()) {
+                if (click->button == Mouse::Button::Left) {
+                    Vector2f p(click->position);
+                    if (handleSpeedClick(anim, click->position)) continue;
+                    if (FloatRect({850, 10}, {120, 40}).contains(p)) { seekTo(0); continue; }
+                    if (FloatRect({980, 10}, {120, 40}).contains(p)) return;
+                    if (FloatRect(REPLAY_TIMELINE.position - Vector2f(0, 6), REPLAY_TIMELINE.size + Vector2f(0, 12)).contains(p)) {
+                        scrubbing = true;
+                        seekToMouse(click->position.x);
+                        continue;
+                    }
+                }
+            }
+            if (auto release = event->getIf<Event::MouseButtonReleased>()) {
+                if (release->button == Mouse::Button::Left && scrubbing) { scrubbing = false; continue; }
+            }
+            if (auto move = event->getIf<Event::MouseMoved>()) {
+                if (scrubbing) { seekToMouse(move->position.x); continue; }
+            }
+            if (auto key = event->getIf<Event::KeyPressed>()) {
+                long long skip = std::max(1LL, file.steps / 20);
+                switch (key->code) {
+                    case Keyboard::Key::Space: paused = !paused; anim.start(); break;
+                    case Keyboard::Key::Right: seekTo(player.step + 1); paused = true; break;
+                    case Keyboard::Key::Left: seekTo(player.step - 1); paused = true; break;
+                    case Keyboard::Key::PageDown: seekTo(player.step + skip); break;
+                    case Keyboard::Key::PageUp: seekTo(player.step - skip); break;
+                    case Keyboard::Key::Home: seekTo(0); break;
+                    case Keyboard::Key::End: seekTo(file.steps); break;
+                    default: break;
+                }
+            }
+            if (file.kind == SceneKind::TREE) camera.handleEvent(*event);
         }
-        window.draw(bar);
 
-        if (barWidth > 20) { 
-            Text valText(font, to_string(arr[i]));
-            valText.setCharacterSize(14);
-            valText.setFillColor(Color::White);
-            FloatRect textBounds = valText.getLocalBounds();
-            valText.setPosition({
-                (i * barWidth + (barWidth / 2)) - (textBounds.size.x / 2) - textBounds.position.x,
-                (float)(WINDOW_HEIGHT - arr[i] - 20)
-            });
-            window.draw(valText);
+        if (!paused && !scrubbing) playReplay(player, anim, bars);
+
+        if (file.kind == SceneKind::TREE) {
+            camera.bounds = player.scene.tree.bounds();
+            camera.update();
         }
-    }
-    
-    drawGlobalUI(window, font, animationDelay);
-}
+        drawReplayScene(window, font, player, bars, treeRenderer, camera);
+        drawGlobalUI(window, font, anim);
 
-// Bar sort functions just need to pass dummy view variables to pollEvents
-bool bubbleSort_bars(RenderWindow& window, const Font& font, vector<int>& arr, int& animationDelay) {
-    string title = "Bubble Sort";
-    float dummyViewX=0, dummyMinX=0, dummyMaxX=0, dummyViewY=0, dummyMaxY=0;
-    bool dummyPan = false; Vector2i dummyMouse;
-    for (size_t i = 0; i < arr.size(); i++) {
-        for (size_t j = 0; j < arr.size() - i - 1; j++) {
-            UIState state = pollEventsAndCheckUI(window, font, animationDelay, dummyViewX, dummyMinX, dummyMaxX, dummyViewY, dummyMaxY, dummyPan, dummyMouse);
-            if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false; 
-            
-            drawSortState_bars(window, font, arr, animationDelay, title, {{j, Color::Yellow}, {j + 1, Color::Yellow}});
-            window.display();
-            sleep(milliseconds(animationDelay));
+        RectangleShape track(REPLAY_TIMELINE.size);
+        track.setPosition(REPLAY_TIMELINE.position);
+        track.setFillColor(Color(60, 60, 60));
+        window.draw(track);
+        float done = file.steps ? (float)player.step / file.steps : 1;
+        RectangleShape progress({REPLAY_TIMELINE.size.x * done, REPLAY_TIMELINE.size.y});
+        progress.setPosition(REPLAY_TIMELINE.position);
+        progress.setFillColor(player.damaged ? Color::Red : Color(0, 150, 255));
+        window.draw(progress);
 
-            if (arr[j] > arr[j + 1]) {
-                swap(arr[j], arr[j + 1]);
-                drawSortState_bars(window, font, arr, animationDelay, title, {{j, Color::Red}, {j + 1, Color::Red}});
-                window.display();
-                sleep(milliseconds(animationDelay));
-            }
-        }
+        char buf[160];
+        snprintf(buf, sizeof(buf), "Step %lld / %lld   Compares %lld   Swaps %lld%s", player.step, file.steps,
+                 player.scene.compares, player.scene.swaps,
+                 player.damaged ? "   (the rest of the file is damaged)" : paused ? "   (paused)" : "");
+        Text status(font, buf);
+        status.setCharacterSize(14);
+        status.setFillColor(Color::White);
+        status.setPosition({10, 40});
+        window.draw(status);
+        window.display();
     }
-    return true; 
 }
 
-bool insertionSort_bars(RenderWindow& window, const Font& font, vector<int>& arr, int& animationDelay) {
-    string title = "Insertion Sort";
-    float dummyViewX=0, dummyMinX=0, dummyMaxX=0, dummyViewY=0, dummyMaxY=0;
-    bool dummyPan = false; Vector2i dummyMouse;
-    for (size_t i = 1; i < arr.size(); i++) {
-        int key = arr[i];
-        int j = i - 1;
-        while (j >= 0 && arr[j] > key) {
-            UIState state = pollEventsAndCheckUI(window, font, animationDelay, dummyViewX, dummyMinX, dummyMaxX, dummyViewY, dummyMaxY, dummyPan, dummyMouse);
-            if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-            drawSortState_bars(window, font, arr, animationDelay, title, {{j, Color::Yellow}, {j + 1, Color::Yellow}});
-            window.display();
-            sleep(milliseconds(animationDelay));
-            arr[j + 1] = arr[j];
-            j = j - 1;
-            drawSortState_bars(window, font, arr, animationDelay, title, {{j + 1, Color::Red}, {j + 2, Color::Red}});
-            window.display();
-            sleep(milliseconds(animationDelay));
+// sort_visualizer --export <file> <directory> [frames]: renders frames evenly
+// spaced over the replay offscreen and writes them as frame_00000.png, ...,
+// ready for a video encoder. Tree replays are shown fitted to the window.
+int exportReplayFrames(const Font& font, const string& path, const string& directory, int frames) {
+    ReplayFile file;
+    string error;
+    if (!file.open(path, error)) { cerr << error << endl; return 1; }
+    error_code ec;
+    filesystem::create_directories(directory, ec);
+    if (ec) { cerr << "Cannot create " << directory << ": " << ec.message() << endl; return 1; }
+
+    RenderTexture texture;
+    if (!texture.resize({WINDOW_WIDTH, WINDOW_HEIGHT})) { cerr << "Cannot create an offscreen render target" << endl; return 1; }
+    ReplayPlayer player(file);
+    BarRenderer bars;
+    TreeCamera camera;
+    TreeRenderer treeRenderer;
+
+    for (int f = 0; f < frames; f++) {
+        player.seek(frames > 1 ? file.steps * f / (frames - 1) : file.steps, bars);
+        if (player.damaged) { cerr << path << " is damaged after step " << player.step << endl; return 1; }
+        if (file.kind == SceneKind::TREE) {
+            camera.bounds = player.scene.tree.bounds();
+            camera.fit();
+            camera.zoom = camera.targetZoom;
+            camera.center = camera.fitCenter;
         }
-        arr[j + 1] = key;
-    }
-    return true;
-}
+        drawReplayScene(texture, font, player, bars, treeRenderer, camera);
+        texture.display();
 
-bool selectionSort_bars(RenderWindow& window, const Font& font, vector<int>& arr, int& animationDelay) {
-    string title = "Selection Sort";
-    float dummyViewX=0, dummyMinX=0, dummyMaxX=0, dummyViewY=0, dummyMaxY=0;
-    bool dummyPan = false; Vector2i dummyMouse;
-    for (size_t i = 0; i < arr.size() - 1; i++) {
-        int min_idx = i;
-        for (size_t j = i + 1; j < arr.size(); j++) {
-            UIState state = pollEventsAndCheckUI(window, font, animationDelay, dummyViewX, dummyMinX, dummyMaxX, dummyViewY, dummyMaxY, dummyPan, dummyMouse);
-            if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-            drawSortState_bars(window, font, arr, animationDelay, title, {{min_idx, Color::Yellow}, {j, Color::Yellow}});
-            window.display();
-            sleep(milliseconds(animationDelay));
-            if (arr[j] < arr[min_idx]) {
-                min_idx = j;
-            }
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%05d.png", f);
+        if (!texture.getTexture().copyToImage().saveToFile(directory + name)) {
+            cerr << "Cannot write " << directory + name << endl;
+            return 1;
         }
-        swap(arr[min_idx], arr[i]);
-        drawSortState_bars(window, font, arr, animationDelay, title, {{min_idx, Color::Red}, {i, Color::Red}});
-        window.display();
-        sleep(milliseconds(animationDelay));
+        printf("\rExported %d/%d frames", f + 1, frames);
+        fflush(stdout);
     }
-    return true;
+    printf("\n");
+    return 0;
 }
 
 
 // ################################################################
-// --- MODE 2: TREE VISUALIZATION (Quick, Merge) ---
+// --- BENCHMARK (--bench) ---
 // ################################################################
 
-struct Node {
-    vector<int> data;
-    string title;
-    FloatRect bounds; 
-    bool isSorted = false;
-    bool isActive = false;
-    Node *left = nullptr, *right = nullptr, *parent = nullptr;
-    ~Node() { delete left; delete right; }
-};
-
-Vector2f getNodeSize(const vector<int>& data) {
-    float boxSize = 30;
-    float spacing = 5;
-    float totalWidth = data.size() * (boxSize + spacing) - spacing;
-    return {totalWidth + 40, 80}; 
+// Plain versions of the textbook sorts, for timing only
+template <class It, class Cmp = DefaultOrder>
+void bubbleSortKernel(It a, int n, Cmp cmp = {}) {
+    for (int i = 0; i + 1 < n; i++)
+        for (int j = 0; j + 1 < n - i; j++)
+            if (cmp(a[j + 1], a[j])) swap(a[j], a[j + 1]);
 }
 
-// ✅ NEW: Added minTreeX and maxTreeX to track horizontal bounds
-void calculateTreeLayout(Node* node, int x, int y, int h_spacing, int v_spacing, 
-                         float& minTreeX, float& maxTreeX, float& maxTreeY) {
-    if (!node) return;
-    Vector2f size = getNodeSize(node->data);
-    node->bounds.position = {x - size.x / 2, (float)y};
-    node->bounds.size = size;
-    
-    maxTreeY = std::max(maxTreeY, (float)y + node->bounds.size.y);
-    minTreeX = std::min(minTreeX, node->bounds.position.x);
-    maxTreeX = std::max(maxTreeX, node->bounds.position.x + node->bounds.size.x);
-
-    if (node->left) {
-        node->left->parent = node;
-        calculateTreeLayout(node->left, x - h_spacing, y + v_spacing, h_spacing / 2, v_spacing, minTreeX, maxTreeX, maxTreeY);
-    }
-    if (node->right) {
-        node->right->parent = node;
-        calculateTreeLayout(node->right, x + h_spacing, y + v_spacing, h_spacing / 2, v_spacing, minTreeX, maxTreeX, maxTreeY);
+template <class It, class Cmp = DefaultOrder>
+void selectionSortKernel(It a, int n, Cmp cmp = {}) {
+    for (int i = 0; i + 1 < n; i++) {
+        int minIdx = i;
+        for (int j = i + 1; j < n; j++) if (cmp(a[j], a[minIdx])) minIdx = j;
+        swap(a[i], a[minIdx]);
     }
 }
 
-// ✅ NEW: Added viewOffsetX for panning
-void drawNodeBoxes(RenderWindow& window, const Font& font, const Node* node, 
-                   float viewOffsetX, float viewOffsetY, const map<int, Color>& highlights = {}) {
-    if (node->data.empty()) return;
+const int BENCH_DEFAULT_SIZE = 1000000;
+const int BENCH_QUADRATIC_LIMIT = 50000; // Beyond this the O(n^2) sorts take minutes
 
-    float boxSize = 30; 
-    float spacing = 5;
-    float totalWidth = node->data.size() * (boxSize + spacing) - spacing;
-    
-    // Apply horizontal pan offset
-    float startX = node->bounds.position.x + (node->bounds.size.x - totalWidth) / 2 - viewOffsetX;
-    float startY = node->bounds.position.y + (node->bounds.size.y - boxSize) / 2 - viewOffsetY; 
+struct BenchEntry {
+    const char* name;
+    bool quadratic;
+    function<void(int*, int*, int)> sort; // Values, scratch space of the same size, count
+};
 
-    for (size_t i = 0; i < node->data.size(); i++) {
-        RectangleShape box({boxSize, boxSize});
-        box.setPosition({startX + i * (boxSize + spacing), startY});
-        
-        if (highlights.count(i)) { box.setFillColor(highlights.at(i)); }
-        else { box.setFillColor(Color(50, 50, 150)); }
-        box.setOutlineColor(node->isSorted ? Color::Green : Color(200, 200, 200));
-        box.setOutlineThickness(1);
-        window.draw(box);
+const BenchEntry BENCH_ENTRIES[] = {
+    {"Bubble", true, [](int* a, int*, int n) { bubbleSortKernel(a, n); }},
+    {"Insertion", true, [](int* a, int*, int n) { insertionSortKernel(a, n); }},
+    {"Selection", true, [](int* a, int*, int n) { selectionSortKernel(a, n); }},
+    {"Quick", false, [](int* a, int*, int n) { quickSortKernel(a, n); }},
+    {"Merge", false, [](int* a, int* tmp, int n) { mergeSortKernel(a, tmp, n); }},
+    {"TimSort", false, [](int* a, int*, int n) { timSortKernel(a, a + n); }},
+    {"pdqsort", false, [](int* a, int*, int n) { pdqSortKernel(a, a + n); }},
+    {"Engine", false, [](int* a, int*, int n) { sortEngine(a, a + n); }},
+    {"std::sort", false, [](int* a, int*, int n) { std::sort(a, a + n); }},
+};
 
-        Text valText(font, to_string(node->data[i]));
-        valText.setCharacterSize(16);
-        valText.setFillColor(Color::White);
-        FloatRect textBounds = valText.getLocalBounds();
-        
-        valText.setPosition({
-            box.getPosition().x + (boxSize - textBounds.size.x) / 2 - textBounds.position.x,
-            box.getPosition().y + (boxSize - textBounds.size.y) / 2 - textBounds.position.y - 2
-        });
-        window.draw(valText);
-    }
-}
+const int BENCH_PATTERNS = GEN_NEARLY_SORTED + 1; // The generators that are orderings, not distributions
 
-// ✅ NEW: Added viewOffsetX for panning
-void drawTree(RenderWindow& window, const Font& font, Node* node, float viewOffsetX, float viewOffsetY) {
-    if (!node) return;
+// Sorted by key, the payload only makes it bigger to move
+struct BenchRecord {
+    uint64_t key;
+    uint32_t payload[2];
+};
 
-    // Apply scroll and pan offsets to all coordinates
-    if (node->left) {
-        Vertex line[2];
-        line[0].position = node->bounds.position + Vector2f(node->bounds.size.x / 2, node->bounds.size.y);
-        line[0].position.x -= viewOffsetX; line[0].position.y -= viewOffsetY;
-        line[0].color = Color::White;
-        line[1].position = node->left->bounds.position + Vector2f(node->left->bounds.size.x / 2, 0);
-        line[1].position.x -= viewOffsetX; line[1].position.y -= viewOffsetY;
-        line[1].color = Color::White;
-        window.draw(line, 2, sf::PrimitiveType::Lines);
-    }
-    if (node->right) {
-        Vertex line[2];
-        line[0].position = node->bounds.position + Vector2f(node->bounds.size.x / 2, node->bounds.size.y);
-        line[0].position.x -= viewOffsetX; line[0].position.y -= viewOffsetY;
-        line[0].color = Color::White;
-        line[1].position = node->right->bounds.position + Vector2f(node->right->bounds.size.x / 2, 0);
-        line[1].position.x -= viewOffsetX; line[1].position.y -= viewOffsetY;
-        line[1].color = Color::White;
-        window.draw(line, 2, sf::PrimitiveType::Lines);
-    }
-
-    RectangleShape rect(node->bounds.size);
-    rect.setPosition({node->bounds.position.x - viewOffsetX, node->bounds.position.y - viewOffsetY});
-    rect.setFillColor(Color(30, 30, 30));
-    rect.setOutlineThickness(2);
-    rect.setOutlineColor(node->isActive ? Color::Blue : (node->isSorted ? Color::Green : Color(80, 80, 80)));
-    window.draw(rect);
+// One row of the element type table. The sorts only have to agree on the
+// keys, as pdqsort and std::sort may order equal keys differently.
+template <class T, class Gen, class Key, class Same>
+bool benchType(const char* label, int n, Gen gen, Key key, Same sameKeys) {
+    vector<T> input(n);
+    for (T& v : input) v = gen();
+    vector<T> expected = input;
+    auto less = KeyLess<Key>{key, {}};
+    std::stable_sort(expected.begin(), expected.end(), less);
 
-    Text titleText(font, node->title);
-    titleText.setCharacterSize(12);
-    titleText.setFillColor(Color::White);
-    titleText.setPosition({node->bounds.position.x + 5 - viewOffsetX, node->bounds.position.y + 5 - viewOffsetY});
-    window.draw(titleText);
-    
-    drawNodeBoxes(window, font, node, viewOffsetX, viewOffsetY);
-    
-    drawTree(window, font, node->left, viewOffsetX, viewOffsetY);
-    drawTree(window, font, node->right, viewOffsetX, viewOffsetY);
+    bool ok = true;
+    printf("%-14s", label);
+    auto time = [&](auto sort) {
+        vector<T> work = input;
+        auto start = chrono::steady_clock::now();
+        sort(work);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!sameKeys(work, expected, key)) { printf("%11s", "WRONG"); ok = false; }
+        else printf("%11.2f", ms);
+        fflush(stdout);
+    };
+    time([&](vector<T>& w) { timSortKernel(w.begin(), w.end(), less); });
+    time([&](vector<T>& w) { pdqSortKernel(w.begin(), w.end(), less); });
+    time([&](vector<T>& w) { sortEngine(w.begin(), w.end(), key); });
+    time([&](vector<T>& w) { std::sort(w.begin(), w.end(), less); });
+    printf("\n");
+    return ok;
 }
 
-// ✅ NEW: Added viewOffsetX for panning
-void drawTreeState(RenderWindow& window, const Font& font, Node* root, Node* activeNode,
-                   int& animationDelay, float viewOffsetX, float viewOffsetY, const map<int, Color>& highlights = {}) {
-    window.clear(Color::Black);
-    
-    drawTree(window, font, root, viewOffsetX, viewOffsetY);
-    
-    if (activeNode) {
-        float boxSize = 30;
-        RectangleShape clearer({activeNode->bounds.size.x - 10, boxSize + 10}); 
-        clearer.setPosition({
-            activeNode->bounds.position.x + 5 - viewOffsetX, 
-            activeNode->bounds.position.y + (activeNode->bounds.size.y - boxSize) / 2 - 5 - viewOffsetY
-        });
-        clearer.setFillColor(Color(30, 30, 30));
-        window.draw(clearer);
-        
-        drawNodeBoxes(window, font, activeNode, viewOffsetX, viewOffsetY, highlights);
+// sort_visualizer --bench [n]: times every sort on the same inputs, checks
+// the results against std::sort and prints milliseconds per sort
+int runBenchmark(int n) {
+    mt19937 rng(42);
+    bool failed = false;
+
+    printf("%d values, milliseconds\n%-14s", n, "");
+    for (const BenchEntry& entry : BENCH_ENTRIES) printf("%11s", entry.name);
+    printf("\n");
+
+    vector<int> work(n), tmp(n);
+    for (int pattern = 0; pattern < BENCH_PATTERNS; pattern++) {
+        vector<int> input = generateValues(pattern, n, 42 + pattern, INT_MAX);
+        vector<int> expected = input;
+        std::sort(expected.begin(), expected.end());
+
+        printf("%-14s", GENERATOR_NAMES[pattern]);
+        for (const BenchEntry& entry : BENCH_ENTRIES) {
+            if (entry.quadratic && n > BENCH_QUADRATIC_LIMIT) { printf("%11s", "-"); continue; }
+            work = input;
+            auto start = chrono::steady_clock::now();
+            entry.sort(work.data(), tmp.data(), n);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (work != expected) {
+                printf("%11s", "WRONG");
+                failed = true;
+            } else {
+                printf("%11.2f", ms);
+            }
+            fflush(stdout);
+        }
+        printf("\n");
     }
 
-    drawGlobalUI(window, font, animationDelay);
-    window.display();
+    printf("\nOther element types, random\n%-14s", "");
+    for (const char* name : {"TimSort", "pdqsort", "Engine", "std::sort"}) printf("%11s", name);
+    printf("\n");
+    auto sameKeys = [](const auto& x, const auto& y, auto key) {
+        return equal(x.begin(), x.end(), y.begin(), [&](const auto& p, const auto& q) { return key(p) == key(q); });
+    };
+    failed |= !benchType<int64_t>("int64", n, [&]() { return (int64_t)((uint64_t)rng() << 32 | rng()); }, Identity(), sameKeys);
+    failed |= !benchType<float>("float", n, [&]() { return (float)((int)rng()) / 1000.0f; }, Identity(), sameKeys);
+    auto recordKey = [](const BenchRecord& r) { return r.key; };
+    failed |= !benchType<BenchRecord>("record", n, [&]() { return BenchRecord{(uint64_t)rng() << 32 | rng(), {(uint32_t)rng(), (uint32_t)rng()}}; },
+                                      recordKey, sameKeys);
+
+    if (failed) cerr << "Some sorts produced wrong results!" << endl;
+    return failed ? 1 : 0;
 }
 
-// --- Merge Sort (Tree) ---
-// ✅ NEW: This function is completely rewritten for real-time division
-bool animateMergeSort(
-    RenderWindow& window, const Font& font, Node* node, int& animationDelay, Node* root, 
-    float& viewOffsetX, float& minTreeX, float& maxTreeX,
-    float& viewOffsetY, float& maxTreeY,
-    bool& isPanning, Vector2i& lastPanMousePos
-) {
-    if (!node || node->data.size() <= 1) {
-        if(node) node->isSorted = true;
-        return true;
-    }
+// ################################################################
+// --- PERFORMANCE HUD (H) ---
+// ################################################################
 
-    // --- 1. Divide Step ---
-    node->isActive = true;
-    node->title = "Splitting";
-    
-    UIState state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-    if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-    drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, {});
-    sleep(milliseconds(animationDelay * 2 + 50)); // Pause to show split
-
-    int m = node->data.size() / 2;
-    node->left = new Node();
-    node->left->data = vector<int>(node->data.begin(), node->data.begin() + m);
-    node->right = new Node();
-    node->right->data = vector<int>(node->data.begin() + m, node->data.end());
-
-    // Recalculate layout with new children
-    minTreeX = FLT_MAX; maxTreeX = -FLT_MAX; maxTreeY = 0;
-    calculateTreeLayout(root, WINDOW_WIDTH / 2, 100, WINDOW_WIDTH / 4, 120, minTreeX, maxTreeX, maxTreeY);
-    
-    state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-    if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-    drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, {});
-    sleep(milliseconds(animationDelay * 2 + 50));
-    
-    node->isActive = false;
+// The counts come from the trace of the animated run. The timing and the
+// hardware counters come from re-running the untraced kernel of the same
+// algorithm on the same input on a worker, since the animated run spends
+// nearly all its time on the trace and the screen.
+struct SortProfile {
+    const char* formula;               // Expected comparisons, as shown
+    double (*expectedCompares)(double n);
+    bool quadratic;                    // Not re-run beyond HUD_QUADRATIC_LIMIT values
+    function<void(int*, int*, int)> kernel; // Values, scratch space of the same size, count
+};
 
-    // --- 2. Recurse Step ---
-    if (!animateMergeSort(window, font, node->left, animationDelay, root, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos)) return false;
-    if (!animateMergeSort(window, font, node->right, animationDelay, root, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos)) return false;
+// Average case for quick sort (2 n ln n), upper bounds for the merges
+const SortProfile PROFILE_BUBBLE{"n(n-1)/2", [](double n) { return n * (n - 1) / 2; }, true,
+                                 [](int* a, int*, int n) { bubbleSortKernel(a, n); }};
+const SortProfile PROFILE_INSERTION{"n^2/4", [](double n) { return n * n / 4; }, true,
+                                    [](int* a, int*, int n) { insertionSortKernel(a, n); }};
+const SortProfile PROFILE_SELECTION{"n(n-1)/2", [](double n) { return n * (n - 1) / 2; }, true,
+                                    [](int* a, int*, int n) { selectionSortKernel(a, n); }};
+const SortProfile PROFILE_QUICK{"1.39 n log2 n", [](double n) { return n > 1 ? 1.386 * n * log2(n) : 0; }, false,
+                                [](int* a, int*, int n) { quickSortKernel(a, n); }};
+const SortProfile PROFILE_MERGE{"n log2 n", [](double n) { return n > 1 ? n * log2(n) : 0; }, false,
+                                [](int* a, int* tmp, int n) { mergeSortKernel(a, tmp, n); }};
+const SortProfile PROFILE_TIMSORT{"n log2 n", [](double n) { return n > 1 ? n * log2(n) : 0; }, false,
+                                  [](int* a, int*, int n) { timSortKernel(a, a + n); }};
+const SortProfile PROFILE_PDQSORT{"n log2 n", [](double n) { return n > 1 ? n * log2(n) : 0; }, false,
+                                  [](int* a, int*, int n) { pdqSortKernel(a, a + n); }};
+const SortProfile PROFILE_NETWORK{"comparators", [](double n) { return n <= MAX_NETWORK_SIZE ? (double)NETWORK_TABLE[(int)n].size : 0; },
+                                  false, [](int* a, int*, int n) { sortSmall(a, n); }};
 
-    // --- 3. Merge Step ---
-    node->isActive = true;
-    node->title = "Merging";
-    
-    vector<int> L = node->left->data;
-    vector<int> R = node->right->data;
-    int n1 = L.size(); int n2 = R.size();
-    int i = 0, j = 0, k = 0;
-    
-    while (i < n1 && j < n2) {
-        state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-        if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
+const double HUD_MEASURE_SECONDS = 0.05; // Re-runs are repeated until they add up to this
+const int HUD_MAX_RUNS = 1000;
+const int HUD_QUADRATIC_LIMIT = 10000;   // Stopping waits for the re-run in progress, ~0.1 s at this size
+const size_t HUD_MAX_VALUES = 10000000;
 
-        node->left->isActive = true; node->right->isActive = true;
-        drawTreeState(window, font, root, node->left, animationDelay, viewOffsetX, viewOffsetY, {{i, Color::Yellow}});
-        drawTreeState(window, font, root, node->right, animationDelay, viewOffsetX, viewOffsetY, {{j, Color::Yellow}});
-        
-        map<int, Color> mergeHighlights;
-        for(int m=0; m < k; m++) mergeHighlights[m] = Color::Green; 
-        
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, mergeHighlights);
-        sleep(milliseconds(animationDelay));
+// Per run; NAN where a counter is not available
+struct HardwareCounters {
+    string error; // Why there are no counters at all
+    int runs = 0;
+    double seconds = 0;
+    double cycles = NAN, instructions = NAN, branches = NAN, branchMisses = NAN, llcMisses = NAN;
+};
 
-        if (L[i] <= R[j]) { node->data[k] = L[i]; i++; }
-        else { node->data[k] = R[j]; j++; }
-        k++;
-        
-        mergeHighlights[k-1] = Color::Red;
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, mergeHighlights);
-        sleep(milliseconds(animationDelay));
-
-        node->left->isActive = false; node->right->isActive = false;
-    }
-
-    while (i < n1) {
-        state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-        if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-        node->data[k] = L[i]; 
-        map<int, Color> mergeHighlights;
-        for(int m=0; m < k; m++) mergeHighlights[m] = Color::Green;
-        mergeHighlights[k] = Color::Red;
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, mergeHighlights);
-        sleep(milliseconds(animationDelay));
-        i++; k++;
-    }
-    while (j < n2) {
-        state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-        if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-        node->data[k] = R[j]; 
-        map<int, Color> mergeHighlights;
-        for(int m=0; m < k; m++) mergeHighlights[m] = Color::Green;
-        mergeHighlights[k] = Color::Red;
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, mergeHighlights);
-        sleep(milliseconds(animationDelay));
-        j++; k++;
-    }
-
-    node->isSorted = true;
-    node->isActive = false;
-    drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, {});
-    sleep(milliseconds(animationDelay));
-    
-    return true;
-}
+#ifdef __linux__
+// One counter of this thread, user space only
+struct PerfCounter {
+    int fd = -1;
 
-// --- Quick Sort (Tree) ---
-// ✅ NEW: Added all pan/scroll parameters to signature
-// --- Quick Sort (Tree) ---
-// ✅ FIX: Added all pan/scroll parameters and proper "combine" animation
-bool animateQuickSort(
-    RenderWindow& window, const Font& font, Node* node, int& animationDelay, Node* root, 
-    float& viewOffsetX, float& minTreeX, float& maxTreeX,
-    float& viewOffsetY, float& maxTreeY,
-    bool& isPanning, Vector2i& lastPanMousePos
-) {
-    if (!node || node->data.size() <= 1) {
-        if (node) node->isSorted = true;
-        return true;
+    bool open(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        return fd >= 0;
     }
-    
-    node->isActive = true;
-    node->title = "Partition";
 
-    int pivot = node->data.back();
-    int i = -1; 
+    void enable() { if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+    void disable() { if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); }
 
-    // --- 1. Partition Step ---
-    for (int j = 0; j < node->data.size() - 1; j++) {
-        UIState state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-        if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
-        map<int, Color> highlights;
-        highlights[j] = Color::Yellow; 
-        highlights[node->data.size() - 1] = Color::Magenta; 
-        if (i >= 0) highlights[i] = Color::Blue; 
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, highlights);
-        sleep(milliseconds(animationDelay));
-
-        if (node->data[j] < pivot) {
-            i++;
-            swap(node->data[i], node->data[j]);
-            highlights[i] = Color::Red;
-            highlights[j] = Color::Red;
-            drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, highlights);
-            sleep(milliseconds(animationDelay));
-        }
+    // Scaled up for the time the kernel had it multiplexed out
+    double read() const {
+        uint64_t v[3];
+        if (fd < 0 || ::read(fd, v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0) return NAN;
+        return (double)v[0] * ((double)v[1] / v[2]);
     }
-    
-    swap(node->data[i + 1], node->data[node->data.size() - 1]);
-    int pi = i + 1; 
-    int pivotValue = node->data[pi];
-    
-    map<int, Color> highlights;
-    highlights[pi] = Color::Red; 
-    drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, highlights);
-    sleep(milliseconds(animationDelay));
-    node->isActive = false;
-    
-    // --- 2. Divide Step (Create Children) ---
-    if (pi > 0) {
-        node->left = new Node();
-        node->left->data = vector<int>(node->data.begin(), node->data.begin() + pi);
+
+    ~PerfCounter() { if (fd >= 0) close(fd); }
+};
+#endif
+
+// Sorts copies of input with kernel until the runs add up to
+// HUD_MEASURE_SECONDS, with the hardware counters on around the sorts only
+HardwareCounters measureKernel(const function<void(int*, int*, int)>& kernel, const vector<int>& input,
+                               const atomic<bool>& cancel) {
+    HardwareCounters hc;
+    int n = input.size();
+    vector<int> work(n), tmp(n);
+#ifdef __linux__
+    const uint64_t llcReadMiss = PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                 PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    PerfCounter counters[5];
+    bool any = counters[0].open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    int failure = errno;
+    any |= counters[1].open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    any |= counters[2].open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS);
+    any |= counters[3].open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    any |= counters[4].open(PERF_TYPE_HW_CACHE, llcReadMiss);
+    if (!any) {
+        hc.error = string("perf_event_open: ") + strerror(failure);
+        if (failure == EACCES || failure == EPERM) hc.error += " (see /proc/sys/kernel/perf_event_paranoid)";
+        if (failure == ENOENT || failure == EOPNOTSUPP) hc.error = "No hardware counters on this machine";
     }
-    if (pi + 1 < node->data.size()) {
-        node->right = new Node();
-        node->right->data = vector<int>(node->data.begin() + pi + 1, node->data.end());
+#else
+    hc.error = "Hardware counters need Linux";
+#endif
+
+    double total = 0;
+    while (hc.runs < HUD_MAX_RUNS && total < HUD_MEASURE_SECONDS && !cancel.load(memory_order_relaxed)) {
+        copy(input.begin(), input.end(), work.begin());
+#ifdef __linux__
+        for (PerfCounter& c : counters) c.enable();
+#endif
+        auto start = chrono::steady_clock::now();
+        kernel(work.data(), tmp.data(), n);
+        total += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+#ifdef __linux__
+        for (PerfCounter& c : counters) c.disable();
+#endif
+        hc.runs++;
     }
+    if (hc.runs == 0) return hc;
+    hc.seconds = total / hc.runs;
+#ifdef __linux__
+    double* fields[5] = {&hc.cycles, &hc.instructions, &hc.branches, &hc.branchMisses, &hc.llcMisses};
+    for (int i = 0; i < 5; i++) *fields[i] = counters[i].read() / hc.runs;
+#endif
+    return hc;
+}
 
-    // Recalculate layout
-    minTreeX = FLT_MAX; maxTreeX = -FLT_MAX; maxTreeY = 0;
-    calculateTreeLayout(root, WINDOW_WIDTH / 2, 100, WINDOW_WIDTH / 4, 120, minTreeX, maxTreeX, maxTreeY);
-    drawTreeState(window, font, root, nullptr, animationDelay, viewOffsetX, viewOffsetY, {}); 
-    sleep(milliseconds(500)); 
+string formatMetric(double v) {
+    char buf[32];
+    if (std::isnan(v)) return "n/a";
+    if (v >= 1e9) snprintf(buf, sizeof(buf), "%.2fG", v / 1e9);
+    else if (v >= 1e6) snprintf(buf, sizeof(buf), "%.2fM", v / 1e6);
+    else if (v >= 1e4) snprintf(buf, sizeof(buf), "%.1fK", v / 1e3);
+    else snprintf(buf, sizeof(buf), "%.0f", v);
+    return buf;
+}
 
-    // --- 3. Recurse Step ---
-    if (!animateQuickSort(window, font, node->left, animationDelay, root, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos)) return false;
-    if (!animateQuickSort(window, font, node->right, animationDelay, root, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos)) return false;
+string formatBytes(long long bytes) {
+    char buf[32];
+    if (bytes >= 1 << 20) snprintf(buf, sizeof(buf), "%.1f MB", bytes / 1048576.0);
+    else if (bytes >= 1 << 10) snprintf(buf, sizeof(buf), "%.1f KB", bytes / 1024.0);
+    else snprintf(buf, sizeof(buf), "%lld B", bytes);
+    return buf;
+}
 
-    // --- 4. Combine Step (The animated "merge") ---
-    node->isSorted = true;
-    node->title = "Combining";
-    node->isActive = true;
+struct PerfHud {
+    bool visible = true;
+    const SortProfile* profile = nullptr;
+    double n = 0;
+    atomic<bool> cancel{false};
+    future<HardwareCounters> measuring;
+    HardwareCounters counters;
+    bool measured = false;
 
-    // 1. Build the final sorted data from children
-    vector<int> sortedData;
-    if (node->left) {
-        sortedData.insert(sortedData.end(), node->left->data.begin(), node->left->data.end());
+    // Starts measuring a sort of input in the background
+    void start(const SortProfile* p, const vector<int>& input) {
+        stop();
+        profile = p;
+        n = input.size();
+        if (!profile) return;
+        if (input.size() > HUD_MAX_VALUES || (profile->quadratic && input.size() > (size_t)HUD_QUADRATIC_LIMIT)) {
+            counters.error = "Too many values to re-run";
+            measured = true;
+            return;
+        }
+        measuring = async(launch::async, [this, kernel = profile->kernel, input]() {
+            return measureKernel(kernel, input, cancel);
+        });
     }
-    sortedData.push_back(pivotValue); // Add the pivot back
-    if (node->right) {
-        sortedData.insert(sortedData.end(), node->right->data.begin(), node->right->data.end());
+
+    // Waits for at most one more re-run
+    void stop() {
+        cancel = true;
+        if (measuring.valid()) measuring.wait();
+        measuring = future<HardwareCounters>();
+        cancel = false;
+        profile = nullptr;
+        counters = HardwareCounters();
+        measured = false;
     }
 
-    // 2. Animate the parent node filling up one-by-one
-    for (size_t k = 0; k < sortedData.size(); ++k) {
-        // Check for exit
-        UIState state = pollEventsAndCheckUI(window, font, animationDelay, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-        if (state.shouldClose || state.resetPressed || state.newArrayPressed) return false;
+    void update() {
+        if (measuring.valid() && measuring.wait_for(chrono::seconds(0)) == future_status::ready) {
+            counters = measuring.get();
+            measured = true;
+        }
+    }
 
-        // Update the node's data one element at a time
-        node->data[k] = sortedData[k];
+    void draw(RenderWindow& window, const Font& font, const SortScene& scene) const {
+        if (!visible || !profile) return;
+        double expected = profile->expectedCompares(n);
+        string lines = "Comparisons " + formatMetric(scene.compares) + "  (" + profile->formula + " = " +
+                       formatMetric(expected) + ")";
+        if (expected > 0) {
+            char ratio[32];
+            snprintf(ratio, sizeof(ratio), "  %.2fx", scene.compares / expected);
+            lines += ratio;
+        }
+        lines += "\nSwaps " + formatMetric(scene.swaps) + "   Writes " + formatMetric(scene.writes) +
+                 "   Scratch " + formatBytes(scene.auxBytes) + " (peak " + formatBytes(scene.peakAuxBytes) + ")";
 
-        // Highlight the newly added element
-        map<int, Color> combineHighlights;
-        for(size_t j = 0; j <= k; ++j) {
-            combineHighlights[j] = Color::Green; // Already sorted
+        const HardwareCounters& hc = counters;
+        if (!measured) {
+            lines += "\nUntraced re-run: measuring...";
+        } else {
+            if (hc.runs > 0) {
+                char timing[64];
+                snprintf(timing, sizeof(timing), "\nUntraced re-run: %.3f ms (%d runs)", hc.seconds * 1000, hc.runs);
+                lines += timing;
+            }
+            if (!hc.error.empty()) {
+                lines += "\n" + hc.error;
+            } else {
+                char ipc[32] = "n/a", missRate[32] = "";
+                if (!std::isnan(hc.instructions) && hc.cycles > 0) snprintf(ipc, sizeof(ipc), "%.2f", hc.instructions / hc.cycles);
+                if (!std::isnan(hc.branchMisses) && hc.branches > 0)
+                    snprintf(missRate, sizeof(missRate), " (%.2f%%)", 100 * hc.branchMisses / hc.branches);
+                lines += "\nIPC " + string(ipc) + "   Branch misses " + formatMetric(hc.branchMisses) + missRate +
+                         "   LLC misses " + formatMetric(hc.llcMisses);
+            }
         }
-        combineHighlights[k] = Color::Red; // Newly added
-        
-        drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, combineHighlights);
-        sleep(milliseconds(animationDelay));
+
+        Text text(font, lines);
+        text.setCharacterSize(14);
+        text.setFillColor(Color(220, 220, 220));
+        text.setPosition({18, 143});
+        FloatRect bounds = text.getGlobalBounds();
+        RectangleShape panel({bounds.size.x + 16, bounds.size.y + 16});
+        panel.setPosition({10, 135});
+        panel.setFillColor(Color(0, 0, 0, 170));
+        window.draw(panel);
+        window.draw(text);
     }
 
-    // Final draw
-    node->title = "Combined";
-    node->isActive = false;
-    drawTreeState(window, font, root, node, animationDelay, viewOffsetX, viewOffsetY, {});
-    sleep(milliseconds(animationDelay * 2 + 50)); 
-    
-    return true;
-}
+    ~PerfHud() { stop(); }
+};
 
 
 // ################################################################
 // --- MAIN FUNCTION ---
 // ################################################################
 
-int main() {
-    RenderWindow window(VideoMode({WINDOW_WIDTH, WINDOW_HEIGHT}), "Sorting Visualizer");
-    window.setFramerateLimit(60);
+int main(int argc, char** argv) {
+    // sort_visualizer --bench [n] runs without a window
+    if (argc >= 2 && string(argv[1]) == "--bench") {
+        int n = argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_SIZE;
+        if (n <= 0) {
+            cerr << "Usage: sort_visualizer --bench [count]" << endl;
+            return 1;
+        }
+        return runBenchmark(n);
+    }
+
     Font font;
 
     if (!font.openFromFile("/System/Library/Fonts/Supplemental/Arial.ttf")) {
@@ -652,100 +4147,172 @@ int main() {
         }
     }
 
-    int animationDelay = 50; 
+    // sort_visualizer --export <replay.svt> <directory> [frames] renders offscreen, without a window
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "--export") {
+        int frames = argc == 5 ? atoi(argv[4]) : REPLAY_EXPORT_FRAMES;
+        if (frames <= 0) {
+            cerr << "Usage: sort_visualizer --export <replay.svt> <directory> [frames]" << endl;
+            return 1;
+        }
+        return exportReplayFrames(font, argv[2], argv[3], frames);
+    }
+
+    RenderWindow window(VideoMode({WINDOW_WIDTH, WINDOW_HEIGHT}), "Sorting Visualizer");
+    window.setFramerateLimit(60);
+
+    // sort_visualizer --external <input.bin> <output.bin>
+    if (argc == 4 && string(argv[1]) == "--external") {
+        return runExternalSortMode(window, font, argv[2], argv[3]);
+    }
+
+    // sort_visualizer --replay <replay.svt>; New Array goes on to the input prompt
+    if (argc == 3 && string(argv[1]) == "--replay") {
+        ReplayFile replay;
+        string error;
+        if (!replay.open(argv[2], error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        runReplayMode(window, font, replay);
+        if (!window.isOpen()) return 0;
+    }
+
     string userInput;
     vector<int> arr;
     vector<int> originalArr;
     bool enteringInput = true;
     bool sorted = false;
 
-    enum class VizMode { BARS, TREE };
+    // Files, clipboard and generators can take a while for big inputs, so
+    // they are read on a worker while the prompt keeps redrawing
+    future<LoadedInput> loading;
+    string inputError;
+
+    // sort_visualizer --input <file> starts with that file loaded
+    if (argc == 3 && string(argv[1]) == "--input") {
+        loading = async(launch::async, readPromptInput, "load " + string(argv[2]));
+    }
+
+    enum class VizMode { BARS, TREE, NETWORK, RACE };
     VizMode currentMode = VizMode::BARS;
-    Node* sortTreeRoot = nullptr;
+    BarRenderer bars;
     
-    // ✅ NEW: View state variables for panning and scrolling
-    float viewOffsetX = 0.0f;
-    float viewOffsetY = 0.0f;
-    float maxTreeY = 0.0f;
-    float minTreeX = FLT_MAX;
-    float maxTreeX = -FLT_MAX;
-    bool isPanning = false;
-    Vector2i lastPanMousePos;
+    // ✅ NEW: Camera for panning, scrolling and zooming the tree
+    TreeCamera camera;
+    TreeRenderer treeRenderer;
+
+    // Sorts run on a worker; this loop keeps handling input and replays
+    // their trace at the speed the scheduler allows
+    AnimationScheduler anim;
+    SortRun run;
+    SortScene scene;
+    SortRace race;
+    PerfHud hud; // ✅ NEW: H toggles it
+
+    // ✅ NEW: S saves the sort on screen as a replay file, recorded on a worker
+    SortRecipe lastSort;
+    ReplaySaver saver;
+    string saveMessage;
+    Clock saveMessageClock;
     
     bool bubbleSortPressed = false, insertionSortPressed = false, selectionSortPressed = false;
     bool quickSortPressed = false, mergeSortPressed = false, resetPressed = false;
-    bool newArrayPressed = false; 
+    bool newArrayPressed = false, networkSortPressed = false, racePressed = false;
+    bool timSortPressed = false, pdqSortPressed = false;
 
     while (window.isOpen()) {
         
         bubbleSortPressed = false; insertionSortPressed = false; selectionSortPressed = false;
         quickSortPressed = false; mergeSortPressed = false; resetPressed = false;
-        newArrayPressed = false;
-        bool speedUpPressed = false, speedDownPressed = false;
+        newArrayPressed = false; networkSortPressed = false; racePressed = false;
+        timSortPressed = false; pdqSortPressed = false;
 
         // --- 1. Event Polling (for main menu) ---
         while (auto event = window.pollEvent()) {
             if (event->is<Event::Closed>()) {
+                saver.stop();
                 window.close();
             }
 
-            // Handle scrolling in the main menu
-            if (currentMode == VizMode::TREE) {
-                if (auto scrollEvent = event->getIf<Event::MouseWheelScrolled>()) {
-                    if (scrollEvent->wheel == Mouse::Wheel::Vertical) {
-                        float delta = scrollEvent->delta; 
-                        viewOffsetY = std::clamp(viewOffsetY - delta * 20.0f, 0.0f, std::max(0.0f, maxTreeY - WINDOW_HEIGHT + 100.0f));
-                    }
-                }
-                // ✅ NEW: Handle Panning in the main menu
-                if (auto mbp = event->getIf<Event::MouseButtonPressed>()) {
-                    if (mbp->button == Mouse::Button::Left) {
-                        isPanning = true;
-                        lastPanMousePos = Mouse::getPosition(window);
-                    }
+            if (!enteringInput) {
+                if (auto click = event->getIf<Event::MouseButtonPressed>()) {
+                    if (click->button == Mouse::Button::Left && handleSpeedClick(anim, click->position)) continue;
                 }
-                if (auto mbr = event->getIf<Event::MouseButtonReleased>()) {
-                    if (mbr->button == Mouse::Button::Left) {
-                        isPanning = false;
-                    }
+            }
+
+            // ✅ NEW: Pan, scroll and zoom the tree
+            if (currentMode == VizMode::TREE) camera.handleEvent(*event);
+
+            if (!enteringInput) {
+                if (auto key = event->getIf<Event::KeyPressed>()) {
+                    if (key->code == Keyboard::Key::H) hud.visible = !hud.visible;
                 }
-                if (event->is<Event::MouseMoved>()) {
-                    if (isPanning) {
-                        Vector2i currentMousePos = Mouse::getPosition(window);
-                        Vector2i delta = currentMousePos - lastPanMousePos;
-                        viewOffsetX -= delta.x;
-                        lastPanMousePos = currentMousePos;
-                        // Clamp
-                        float minPan = minTreeX - 50;
-                        float maxPan = maxTreeX - WINDOW_WIDTH + 50;
-                        viewOffsetX = std::clamp(viewOffsetX, std::min(minPan, maxPan), std::max(minPan, maxPan));
+            }
+
+            if (!enteringInput && lastSort.sort && !saver.busy()) {
+                if (auto key = event->getIf<Event::KeyPressed>()) {
+                    if (key->code == Keyboard::Key::S) {
+                        string path;
+                        for (char c : lastSort.title) path += c == ' ' ? '-' : (char)tolower((unsigned char)c);
+                        path += ".svt";
+                        if (lastSort.profile->quadratic && originalArr.size() > (size_t)REPLAY_QUADRATIC_LIMIT) {
+                            saveMessage = "Too many values to save as a replay";
+                            saveMessageClock.restart();
+                        } else {
+                            saver.start(path, lastSort, originalArr);
+                        }
                     }
                 }
             }
 
-            if (enteringInput) {
+            if (enteringInput && !loading.valid()) {
+                if (auto key = event->getIf<Event::KeyPressed>()) {
+                    if (key->code == Keyboard::Key::V && (key->control || key->system)) {
+                        loading = async(launch::async, readClipboardInput);
+                        continue;
+                    }
+                }
                 if (auto textEntered = event->getIf<Event::TextEntered>()) {
                     auto unicode = textEntered->unicode;
                     if (unicode == 8 && !userInput.empty()) userInput.pop_back(); 
                     else if (unicode == 13 || unicode == 10) { 
-                        stringstream ss(userInput);
-                        int num;
-                        arr.clear();
-                        while (ss >> num) arr.push_back(num);
-                        originalArr = arr;
-                        enteringInput = false;
-                        sorted = false;
-                        currentMode = VizMode::BARS;
-                        delete sortTreeRoot; sortTreeRoot = nullptr;
-                        viewOffsetX = 0; viewOffsetY = 0; maxTreeY = 0; minTreeX = FLT_MAX; maxTreeX = -FLT_MAX;
+                        if (userInput.compare(0, 7, "replay ") == 0) {
+                            // Plays in its own loop and comes back to the prompt
+                            ReplayFile replay;
+                            if (replay.open(userInput.substr(7), inputError)) {
+                                inputError.clear();
+                                runReplayMode(window, font, replay);
+                            }
+                        } else {
+                            loading = async(launch::async, readPromptInput, userInput);
+                        }
                     } 
-                    else if (isdigit((char)unicode) || unicode == ' ') {
+                    else if (unicode >= 32 && unicode < 127) {
                         userInput += (char)unicode;
                     }
                 }
             }
         }
 
+        if (saver.finished(saveMessage)) saveMessageClock.restart();
+
+        // ✅ NEW: Pick up finished loads
+        if (loading.valid() && loading.wait_for(chrono::seconds(0)) == future_status::ready) {
+            LoadedInput in = loading.get();
+            inputError = in.error;
+            if (inputError.empty()) {
+                originalArr = std::move(in.values);
+                arr = originalArr;
+                bars.reset(arr);
+                enteringInput = false;
+                sorted = false;
+                currentMode = VizMode::BARS;
+                scene = SortScene();
+                hud.stop();
+                camera = TreeCamera();
+            }
+        }
+
         if (!enteringInput) {
             Vector2i mouse = Mouse::getPosition(window);
             bool mousePressed = Mouse::isButtonPressed(Mouse::Button::Left);
@@ -755,20 +4322,33 @@ int main() {
             RectangleShape r_s({120, 40}); r_s.setPosition({270, 10});
             RectangleShape r_q({120, 40}); r_q.setPosition({400, 10});
             RectangleShape r_m({120, 40}); r_m.setPosition({530, 10});
+            RectangleShape r_n({120, 40}); r_n.setPosition({660, 10});
+            RectangleShape r_tim({120, 40}); r_tim.setPosition({400, 60});
+            RectangleShape r_pdq({120, 40}); r_pdq.setPosition({530, 60});
+            RectangleShape r_race({120, 40}); r_race.setPosition({660, 60});
             RectangleShape r_reset({120, 40}); r_reset.setPosition({850, 10});
             RectangleShape r_new({120, 40}); r_new.setPosition({980, 10});
-            RectangleShape r_speedDown({80, 30}); r_speedDown.setPosition({850, 60});
-            RectangleShape r_speedUp({80, 30}); r_speedUp.setPosition({940, 60});
-
-            if (!sorted && mousePressed && r_b.getGlobalBounds().contains(Vector2f(mouse))) bubbleSortPressed = true;
-            if (!sorted && mousePressed && r_i.getGlobalBounds().contains(Vector2f(mouse))) insertionSortPressed = true;
-            if (!sorted && mousePressed && r_s.getGlobalBounds().contains(Vector2f(mouse))) selectionSortPressed = true;
-            if (!sorted && mousePressed && r_q.getGlobalBounds().contains(Vector2f(mouse))) quickSortPressed = true;
-            if (!sorted && mousePressed && r_m.getGlobalBounds().contains(Vector2f(mouse))) mergeSortPressed = true;
+
+            bool idle = !sorted && !run.running() && !race.running();
+            if (idle && mousePressed && r_b.getGlobalBounds().contains(Vector2f(mouse))) bubbleSortPressed = true;
+            if (idle && mousePressed && r_i.getGlobalBounds().contains(Vector2f(mouse))) insertionSortPressed = true;
+            if (idle && mousePressed && r_s.getGlobalBounds().contains(Vector2f(mouse))) selectionSortPressed = true;
+            if (idle && mousePressed && r_q.getGlobalBounds().contains(Vector2f(mouse))) quickSortPressed = true;
+            if (idle && mousePressed && r_m.getGlobalBounds().contains(Vector2f(mouse))) mergeSortPressed = true;
+            if (idle && mousePressed && r_n.getGlobalBounds().contains(Vector2f(mouse))) networkSortPressed = true;
+            if (idle && mousePressed && r_tim.getGlobalBounds().contains(Vector2f(mouse))) timSortPressed = true;
+            if (idle && mousePressed && r_pdq.getGlobalBounds().contains(Vector2f(mouse))) pdqSortPressed = true;
+            if (idle && mousePressed && r_race.getGlobalBounds().contains(Vector2f(mouse))) racePressed = true;
             if (mousePressed && r_reset.getGlobalBounds().contains(Vector2f(mouse))) resetPressed = true;
             if (mousePressed && r_new.getGlobalBounds().contains(Vector2f(mouse))) newArrayPressed = true;
-            if (mousePressed && r_speedDown.getGlobalBounds().contains(Vector2f(mouse))) speedDownPressed = true;
-            if (mousePressed && r_speedUp.getGlobalBounds().contains(Vector2f(mouse))) speedUpPressed = true;
+        }
+
+        // --- 2. Replay the sort in flight ---
+        hud.update();
+        if (run.running() && playTrace(run, anim, scene, arr, bars)) sorted = true;
+        if (race.running()) {
+            race.update(anim);
+            if (!race.running()) sorted = true;
         }
 
         window.clear(Color::Black);
@@ -779,90 +4359,123 @@ int main() {
             prompt.setFillColor(Color::White);
             prompt.setPosition({30, 250});
             window.draw(prompt);
+
+            string generators;
+            for (const char* name : GENERATOR_NAMES) generators += string(generators.empty() ? "" : ", ") + name;
+            Text help(font, "Or type a generator and a count (" + generators + "), e.g. \"normal 100000\",\n"
+                            "or \"load <file>\" (text, or raw 32-bit ints if it ends in .bin). Ctrl+V pastes numbers.\n"
+                            "\"replay <file.svt>\" plays a run saved with S.");
+            help.setCharacterSize(16);
+            help.setFillColor(Color(160, 160, 160));
+            help.setPosition({30, 290});
+            window.draw(help);
+
+            Text status(font, loading.valid() ? "Loading..." : inputError);
+            status.setCharacterSize(18);
+            status.setFillColor(loading.valid() ? Color::Yellow : Color::Red);
+            status.setPosition({30, 370});
+            window.draw(status);
         } 
         else {
             if (currentMode == VizMode::BARS) {
-                drawSortState_bars(window, font, arr, animationDelay, "", {});
-            } else if (sortTreeRoot) {
-                drawTree(window, font, sortTreeRoot, viewOffsetX, viewOffsetY);
-                drawGlobalUI(window, font, animationDelay);
+                drawSortState_bars(window, font, bars, arr, run.running() ? scene.caption() : "", scene.highlights);
+                drawGlobalUI(window, font, anim);
+            } else if (currentMode == VizMode::NETWORK) {
+                drawNetworkState(window, font, arr, "", scene.layersDone, scene.highlights);
+                drawGlobalUI(window, font, anim);
+            } else if (currentMode == VizMode::RACE) {
+                race.draw(window, font);
+                drawGlobalUI(window, font, anim);
+            } else {
+                camera.bounds = scene.tree.bounds();
+                camera.update();
+                drawTree(window, font, treeRenderer, scene.tree, camera);
+                drawGlobalUI(window, font, anim);
             }
+            if (currentMode != VizMode::RACE) hud.draw(window, font, scene);
             
             drawButton(window, font, "Bubble", {10, 10});
             drawButton(window, font, "Insertion", {140, 10});
             drawButton(window, font, "Selection", {270, 10});
             drawButton(window, font, "Quick", {400, 10});
             drawButton(window, font, "Merge", {530, 10});
-            
-            if (speedDownPressed) animationDelay = min(1000, animationDelay - 50);
-            if (speedUpPressed) animationDelay = max(0, animationDelay + 50);
+            drawButton(window, font, "Network", {660, 10});
+            drawButton(window, font, "TimSort", {400, 60});
+            drawButton(window, font, "pdqsort", {530, 60});
+            drawButton(window, font, "Race", {660, 60});
+
+            string saveHint = saver.busy() ? "Saving replay..."
+                            : !saveMessage.empty() && saveMessageClock.getElapsedTime().asSeconds() < 4 ? saveMessage
+                            : lastSort.sort ? "S: save as replay   H: performance HUD" : "";
+            Text saveText(font, saveHint);
+            saveText.setCharacterSize(14);
+            saveText.setFillColor(Color(180, 180, 180));
+            saveText.setPosition({10, 70});
+            window.draw(saveText);
             
             auto resetView = [&]() {
+                run.stop();
+                race.stop();
+                hud.stop();
+                lastSort = SortRecipe();
+                scene = SortScene();
                 arr = originalArr; 
+                bars.reset(arr);
                 sorted = false; 
                 currentMode = VizMode::BARS; 
-                delete sortTreeRoot; sortTreeRoot = nullptr;
-                viewOffsetX = 0; viewOffsetY = 0; maxTreeY = 0; minTreeX = FLT_MAX; maxTreeX = -FLT_MAX;
+                camera = TreeCamera();
             };
 
-            if (resetPressed) { resetView(); }
+            if (resetPressed) {
+                saver.stop();
+                resetView();
+            }
             if (newArrayPressed) {
+                saver.stop();
+                run.stop();
+                race.stop();
+                hud.stop();
+                lastSort = SortRecipe();
+                scene = SortScene();
                 enteringInput = true; 
                 sorted = false;
-                delete sortTreeRoot; sortTreeRoot = nullptr;
-                viewOffsetX = 0; viewOffsetY = 0; maxTreeY = 0; minTreeX = FLT_MAX; maxTreeX = -FLT_MAX;
+                camera = TreeCamera();
             }
 
+            // Each sort gets its own copy of the input; arr is only changed by replay
+            auto startSort = [&](const SortRecipe& recipe) {
+                resetView();
+                currentMode = recipe.kind == SceneKind::TREE ? VizMode::TREE
+                            : recipe.kind == SceneKind::NETWORK ? VizMode::NETWORK : VizMode::BARS;
+                if (recipe.kind == SceneKind::NETWORK && arr.size() > MAX_NETWORK_SIZE) return;
+                startScene(scene, arr, recipe.kind, originalArr, recipe.title, recipe.pingPong);
+                lastSort = recipe;
+                hud.start(recipe.profile, originalArr);
+                anim.start();
+                run.start([sort = recipe.sort, data = originalArr](Tracer& t) mutable { sort(t, data); });
+            };
+
             // --- Start Bar Sorts ---
-            if (bubbleSortPressed) { 
-                currentMode = VizMode::BARS;
-                delete sortTreeRoot; sortTreeRoot = nullptr;
-                viewOffsetX = 0; viewOffsetY = 0;
-                arr = originalArr;
-                sorted = bubbleSort_bars(window, font, arr, animationDelay); 
-            }
-            if (insertionSortPressed) { 
-                currentMode = VizMode::BARS; 
-                delete sortTreeRoot; sortTreeRoot = nullptr;
-                viewOffsetX = 0; viewOffsetY = 0;
-                arr = originalArr;
-                sorted = insertionSort_bars(window, font, arr, animationDelay); 
-            }
-            if (selectionSortPressed) { 
-                currentMode = VizMode::BARS; 
-                delete sortTreeRoot; sortTreeRoot = nullptr;
-                viewOffsetX = 0; viewOffsetY = 0;
-                arr = originalArr;
-                sorted = selectionSort_bars(window, font, arr, animationDelay); 
+            if (bubbleSortPressed) startSort({"Bubble Sort", SceneKind::BARS, false, bubbleSort_bars, &PROFILE_BUBBLE});
+            if (insertionSortPressed) startSort({"Insertion Sort", SceneKind::BARS, false, insertionSort_bars, &PROFILE_INSERTION});
+            if (selectionSortPressed) startSort({"Selection Sort", SceneKind::BARS, false, selectionSort_bars, &PROFILE_SELECTION});
+            if (timSortPressed) startSort({"TimSort", SceneKind::BARS, false, timSort_bars, &PROFILE_TIMSORT});
+            if (pdqSortPressed) startSort({"Pattern-Defeating Quicksort", SceneKind::BARS, false, pdqSort_bars, &PROFILE_PDQSORT});
+            if (networkSortPressed) startSort({"Sorting Network", SceneKind::NETWORK, false, networkSort_anim, &PROFILE_NETWORK});
+            
+            if (racePressed && !originalArr.empty()) {
+                resetView();
+                currentMode = VizMode::RACE;
+                race.start(originalArr);
             }
             
             // --- Start Tree Sorts ---
-            if (mergeSortPressed) {
-                currentMode = VizMode::TREE;
-                arr = originalArr;
-                viewOffsetX = 0; viewOffsetY = 0; maxTreeY = 0; minTreeX = FLT_MAX; maxTreeX = -FLT_MAX;
-                delete sortTreeRoot;
-                sortTreeRoot = new Node{originalArr, "Root"}; // ✅ NEW: Start with root
-                calculateTreeLayout(sortTreeRoot, WINDOW_WIDTH / 2, 100, WINDOW_WIDTH / 4, 120, minTreeX, maxTreeX, maxTreeY);
-                // ✅ NEW: Call the new recursive function
-                sorted = animateMergeSort(window, font, sortTreeRoot, animationDelay, sortTreeRoot, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-                if (!sorted) { resetView(); }
-            }
-            if (quickSortPressed) {
-                currentMode = VizMode::TREE;
-                arr = originalArr;
-                viewOffsetX = 0; viewOffsetY = 0; maxTreeY = 0; minTreeX = FLT_MAX; maxTreeX = -FLT_MAX;
-                delete sortTreeRoot;
-                sortTreeRoot = new Node{originalArr, "Root"}; 
-                calculateTreeLayout(sortTreeRoot, WINDOW_WIDTH / 2, 100, WINDOW_WIDTH / 4, 120, minTreeX, maxTreeX, maxTreeY);
-                sorted = animateQuickSort(window, font, sortTreeRoot, animationDelay, sortTreeRoot, viewOffsetX, minTreeX, maxTreeX, viewOffsetY, maxTreeY, isPanning, lastPanMousePos);
-                if (!sorted) { resetView(); }
-            }
+            if (mergeSortPressed) startSort({"Merge Sort", SceneKind::TREE, true, mergeSort_tree, &PROFILE_MERGE});
+            if (quickSortPressed) startSort({"Quick Sort", SceneKind::TREE, false, quickSort_tree, &PROFILE_QUICK});
         }
 
         window.display();
     }
     
-    delete sortTreeRoot; 
     return 0;
 }
\ No newline at end of file